@@ -4,6 +4,7 @@ import org.jetbrains.annotations.Nullable;
 
 import java.io.IOException;
 import java.io.InputStream;
+import java.lang.ref.Cleaner;
 import java.net.URL;
 import java.nio.file.Files;
 import java.nio.file.Path;
@@ -15,6 +16,9 @@ import java.util.stream.Collectors;
 import java.util.stream.Stream;
 
 final public class CompatLibrary {
+    // Shared by every native handle of this package, so they are released by one thread instead of one per class.
+    static final Cleaner cleaner = Cleaner.create();
+
     @Nullable
     private static Path overrideExtractPath = null;
 
@@ -0,0 +1,178 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+import org.jetbrains.annotations.Nullable;
+
+import java.io.Closeable;
+import java.io.IOException;
+import java.lang.ref.Cleaner;
+import java.nio.ByteBuffer;
+import java.nio.file.Path;
+import java.time.Duration;
+
+public final class ControllerCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    /**
+     * Keeps a controller endpoint of the core open on a native thread and decodes its JSON into packed
+     * records, see {@link ControllerStream}. Broken connections are reported as error records and reopened,
+     * so the stream can be opened before the core listens. Linux only.
+     *
+     * @param socket the unix socket the core serves its external controller on.
+     * @param stream {@link ControllerStream#STREAM_TRAFFIC} or {@link ControllerStream#STREAM_CONNECTIONS}.
+     * @param secret the controller secret, or null.
+     * @param interval between connection snapshots, and between reconnects.
+     * @param capacity bytes of records held until the next {@link ControllerStream#drain}.
+     */
+    @NotNull
+    public static ControllerStream openControllerStream(
+            @NotNull final Path socket,
+            final int stream,
+            @Nullable final String secret,
+            @NotNull final Duration interval,
+            final int capacity
+    ) throws IOException {
+        if (stream != ControllerStream.STREAM_TRAFFIC && stream != ControllerStream.STREAM_CONNECTIONS) {
+            throw new IllegalArgumentException("Unknown stream " + stream);
+        }
+
+        final long reader = nativeOpenControllerStream(
+                socket.toAbsolutePath().toString(),
+                stream,
+                secret,
+                interval.toMillis(),
+                capacity
+        );
+
+        return new ControllerStream(reader);
+    }
+
+    private native static long nativeOpenControllerStream(
+            @NotNull final String socket,
+            int stream,
+            @Nullable final String secret,
+            long intervalMillis,
+            int capacity
+    ) throws IOException;
+
+    private native static int nativeDrainControllerStream(
+            long reader,
+            @NotNull final ByteBuffer buffer,
+            int position,
+            int limit,
+            @NotNull final long[] dropped
+    );
+
+    private native static void nativeReleaseControllerStream(long reader);
+
+    /**
+     * Records decoded from a controller endpoint, native endian. Every record starts with a 16 byte header;
+     * strings are UTF-8 referenced by a u32 offset from the record start and a u16 length.
+     * <ul>
+     *     <li>{@link #KIND_TRAFFIC}: bytes per second up and down.</li>
+     *     <li>{@link #KIND_CONNECTIONS}: totals, then {@code count} entries of {@link #CONNECTION_SIZE} bytes
+     *     starting at {@link #CONNECTIONS_FIRST}, then their strings.</li>
+     *     <li>{@link #KIND_ERROR}: the connection broke with an HTTP status or a negative errno and is reopened.</li>
+     * </ul>
+     * Records that arrive while the batch is full are dropped and counted.
+     */
+    public static final class ControllerStream implements AutoCloseable, Closeable {
+        public static final int STREAM_TRAFFIC = 1;
+        public static final int STREAM_CONNECTIONS = 2;
+
+        public static final int KIND_ERROR = 0;
+        public static final int KIND_TRAFFIC = 1;
+        public static final int KIND_CONNECTIONS = 2;
+
+        public static final int RECORD_SIZE = 0;       // u32, whole record padded to 8 bytes
+        public static final int RECORD_KIND = 4;       // u16, one of KIND_*
+        public static final int RECORD_TIME = 8;       // i64 epoch nanos of receipt
+        public static final int RECORD_HEADER_SIZE = 16;
+
+        public static final int ERROR_CODE = 16;       // i64
+
+        public static final int TRAFFIC_UP = 16;       // i64
+        public static final int TRAFFIC_DOWN = 24;     // i64
+
+        public static final int CONNECTIONS_UPLOAD_TOTAL = 16;   // i64
+        public static final int CONNECTIONS_DOWNLOAD_TOTAL = 24; // i64
+        public static final int CONNECTIONS_MEMORY = 32;         // i64, -1 if absent
+        public static final int CONNECTIONS_COUNT = 40;          // u32
+        public static final int CONNECTIONS_FIRST = 48;
+
+        public static final int CONNECTION_UPLOAD = 0;            // i64
+        public static final int CONNECTION_DOWNLOAD = 8;          // i64
+        public static final int CONNECTION_START = 16;            // i64 epoch nanos, Long.MIN_VALUE if absent
+        public static final int CONNECTION_DESTINATION_PORT = 24; // u16
+        public static final int CONNECTION_NETWORK = 26;          // u8, one of NETWORK_*
+        public static final int CONNECTION_ID = 32;               // string
+        public static final int CONNECTION_HOST = 40;             // string
+        public static final int CONNECTION_DESTINATION_IP = 48;   // string
+        public static final int CONNECTION_RULE = 56;             // string
+        public static final int CONNECTION_CHAIN = 64;            // string, the outbound finally used
+        public static final int CONNECTION_SIZE = 72;
+
+        public static final int STRING_OFFSET = 0;  // u32
+        public static final int STRING_LENGTH = 4;  // u16
+
+        public static final int NETWORK_UNKNOWN = 0;
+        public static final int NETWORK_TCP = 1;
+        public static final int NETWORK_UDP = 2;
+
+        private final long reader;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+        private final long[] dropped = new long[1];
+
+        private long totalDropped = 0;
+        private boolean closed = false;
+
+        private ControllerStream(final long reader) {
+            this.reader = reader;
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> nativeReleaseControllerStream(reader));
+        }
+
+        /**
+         * Moves as many whole records as fit into {@code dst}, which must be a direct buffer.
+         * A buffer as large as the capacity always fits at least one record.
+         *
+         * @return bytes written starting at the position of {@code dst}, which is advanced past them.
+         */
+        public synchronized int drain(@NotNull final ByteBuffer dst) {
+            ensureOpen();
+
+            if (!dst.isDirect()) {
+                throw new IllegalArgumentException("Direct buffer required");
+            }
+
+            final int length = nativeDrainControllerStream(reader, dst, dst.position(), dst.limit(), dropped);
+
+            totalDropped += dropped[0];
+            dst.position(dst.position() + length);
+
+            return length;
+        }
+
+        /**
+         * @return records dropped so far because the batch was full.
+         */
+        public synchronized long getDropped() {
+            return totalDropped;
+        }
+
+        @Override
+        public synchronized void close() {
+            closed = true;
+
+            cleanable.clean();
+        }
+
+        private void ensureOpen() {
+            if (closed) {
+                throw new IllegalStateException("Controller stream closed");
+            }
+        }
+    }
+}
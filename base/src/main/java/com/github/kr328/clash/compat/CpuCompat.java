@@ -0,0 +1,111 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+
+import java.io.IOException;
+import java.nio.file.Path;
+import java.util.List;
+import java.util.Objects;
+
+public final class CpuCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    /**
+     * Probes the CPU natively, through cpuid and the extensions the OS has enabled, or the hwcaps the kernel reports.
+     */
+    @NotNull
+    public static CpuFeatures getCpuFeatures() {
+        final long[] values = new long[2];
+
+        nativeProbeCpuFeatures(values);
+
+        return new CpuFeatures((int) values[0], values[1]);
+    }
+
+    /**
+     * Picks the build requiring the highest {@link CpuFeatures} level this CPU supports, e.g. a v3 build on
+     * an AVX2 machine and the baseline build elsewhere. Missing or non-executable candidates are skipped, so
+     * optional builds can simply be left out of a package.
+     *
+     * @throws IOException if no candidate can run here.
+     */
+    @NotNull
+    public static Path selectExecutable(@NotNull final List<ExecutableCandidate> candidates) throws IOException {
+        final String[] paths = new String[candidates.size()];
+        final int[] levels = new int[candidates.size()];
+        for (int i = 0; i < candidates.size(); i++) {
+            paths[i] = candidates.get(i).path.toAbsolutePath().toString();
+            levels[i] = candidates.get(i).level;
+        }
+
+        return candidates.get(nativeSelectExecutable(paths, levels)).path;
+    }
+
+    private native static void nativeProbeCpuFeatures(@NotNull final long[] values);
+
+    private native static int nativeSelectExecutable(@NotNull final String[] paths, @NotNull final int[] levels) throws IOException;
+
+    public static final class CpuFeatures {
+        /**
+         * x86-64 microarchitecture levels, as in {@code GOAMD64}. Other architectures are always baseline.
+         */
+        public static final int LEVEL_BASELINE = 1;
+        public static final int LEVEL_V2 = 2;
+        public static final int LEVEL_V3 = 3;
+        public static final int LEVEL_V4 = 4;
+
+        public static final long FEATURE_AES = 1L << 0;
+        public static final long FEATURE_CLMUL = 1L << 1;
+        public static final long FEATURE_SHA = 1L << 2;
+        public static final long FEATURE_AVX2 = 1L << 3;
+        public static final long FEATURE_AVX512 = 1L << 4;
+        public static final long FEATURE_VAES = 1L << 5;
+        public static final long FEATURE_ATOMICS = 1L << 6;
+        public static final long FEATURE_CRC32 = 1L << 7;
+
+        private final int level;
+        private final long features;
+
+        private CpuFeatures(final int level, final long features) {
+            this.level = level;
+            this.features = features;
+        }
+
+        public int getLevel() {
+            return level;
+        }
+
+        public long getFeatures() {
+            return features;
+        }
+
+        public boolean hasFeatures(final long features) {
+            return (this.features & features) == features;
+        }
+    }
+
+    public static final class ExecutableCandidate {
+        @NotNull
+        private final Path path;
+        private final int level;
+
+        /**
+         * @param level the {@link CpuFeatures} level the build was compiled for, e.g. {@code GOAMD64=v3}.
+         */
+        public ExecutableCandidate(@NotNull final Path path, final int level) {
+            this.path = Objects.requireNonNull(path);
+            this.level = level;
+        }
+
+        @NotNull
+        public Path getPath() {
+            return path;
+        }
+
+        public int getLevel() {
+            return level;
+        }
+    }
+}
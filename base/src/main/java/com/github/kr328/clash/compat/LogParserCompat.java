@@ -0,0 +1,137 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+
+import java.io.Closeable;
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.lang.ref.Cleaner;
+import java.nio.ByteBuffer;
+
+public final class LogParserCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    private native static long nativeCreateLogParser(int capacity);
+
+    private native static void nativeAttachLogParser(long parser, @NotNull final FileDescriptor[] sources) throws IOException;
+
+    private native static int nativeDrainLogParser(
+            long parser,
+            @NotNull final ByteBuffer buffer,
+            int position,
+            int limit,
+            @NotNull final long[] dropped
+    );
+
+    private native static void nativeReleaseLogParser(long parser);
+
+    /**
+     * Parses logfmt lines of one or more children into packed records, filled without Java threads.
+     * Records are native endian: a 32 byte header, {@code fieldCount} 16 byte fields and the raw line.
+     * Offsets are relative to the raw line, quoted values exclude their quotes.
+     * Lines that arrive while the batch is full are dropped and counted.
+     */
+    public static final class LogParser extends ProcessCompat.LogTarget implements AutoCloseable, Closeable {
+        public static final int RECORD_SIZE = 0;         // u32, whole record padded to 8 bytes
+        public static final int RECORD_TEXT_LENGTH = 4;  // u32
+        public static final int RECORD_TIME = 8;         // i64 epoch nanos, Long.MIN_VALUE if absent
+        public static final int RECORD_LEVEL = 16;       // u8, one of LEVEL_*
+        public static final int RECORD_FLAGS = 17;       // u8, FLAG_ESCAPED for the message
+        public static final int RECORD_FIELD_COUNT = 18; // u16
+        public static final int RECORD_MESSAGE_OFFSET = 20;
+        public static final int RECORD_MESSAGE_LENGTH = 24;
+        public static final int RECORD_HEADER_SIZE = 32;
+
+        public static final int FIELD_KEY_OFFSET = 0;    // u32
+        public static final int FIELD_KEY_LENGTH = 4;    // u16
+        public static final int FIELD_FLAGS = 6;         // u16
+        public static final int FIELD_VALUE_OFFSET = 8;  // u32
+        public static final int FIELD_VALUE_LENGTH = 12; // u32
+        public static final int FIELD_SIZE = 16;
+
+        public static final int MAX_LINE_LENGTH = 16 * 1024;
+        public static final int MAX_FIELDS = 32;
+        public static final int MAX_RECORD_SIZE = RECORD_HEADER_SIZE + MAX_FIELDS * FIELD_SIZE + MAX_LINE_LENGTH;
+
+        public static final int FLAG_ESCAPED = 1;
+
+        public static final int LEVEL_UNKNOWN = 0;
+        public static final int LEVEL_TRACE = 1;
+        public static final int LEVEL_DEBUG = 2;
+        public static final int LEVEL_INFO = 3;
+        public static final int LEVEL_WARNING = 4;
+        public static final int LEVEL_ERROR = 5;
+        public static final int LEVEL_FATAL = 6;
+
+        private final long parser;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+        private final long[] dropped = new long[1];
+
+        private long totalDropped = 0;
+        private boolean closed = false;
+
+        /**
+         * @param capacity bytes of parsed records held until the next {@link #drain}.
+         */
+        public LogParser(final int capacity) {
+            final long parser = nativeCreateLogParser(capacity);
+
+            this.parser = parser;
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> nativeReleaseLogParser(parser));
+        }
+
+        /**
+         * Moves as many whole records as fit into {@code dst}, which must be a direct buffer with at least
+         * {@link #MAX_RECORD_SIZE} bytes remaining, so that the next record always fits.
+         *
+         * @return bytes written starting at the position of {@code dst}, which is advanced past them.
+         */
+        public synchronized int drain(@NotNull final ByteBuffer dst) {
+            ensureOpen();
+
+            if (!dst.isDirect()) {
+                throw new IllegalArgumentException("Direct buffer required");
+            }
+            if (dst.remaining() < MAX_RECORD_SIZE) {
+                throw new IllegalArgumentException("At least " + MAX_RECORD_SIZE + " bytes required");
+            }
+
+            final int length = nativeDrainLogParser(parser, dst, dst.position(), dst.limit(), dropped);
+
+            totalDropped += dropped[0];
+            dst.position(dst.position() + length);
+
+            return length;
+        }
+
+        /**
+         * @return lines dropped so far because the batch was full.
+         */
+        public synchronized long getDropped() {
+            return totalDropped;
+        }
+
+        @Override
+        public synchronized void close() {
+            closed = true;
+
+            cleanable.clean();
+        }
+
+        @Override
+        synchronized void attach(@NotNull final FileDescriptor[] sources) throws IOException {
+            ensureOpen();
+
+            nativeAttachLogParser(parser, sources);
+        }
+
+        private void ensureOpen() {
+            if (closed) {
+                throw new IllegalStateException("Log parser closed");
+            }
+        }
+    }
+}
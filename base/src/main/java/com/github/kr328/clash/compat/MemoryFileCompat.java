@@ -0,0 +1,157 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+
+import java.io.Closeable;
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.lang.ref.Cleaner;
+import java.nio.ByteBuffer;
+import java.nio.file.Path;
+import java.util.Objects;
+
+public final class MemoryFileCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    /**
+     * Copies {@code content} into an in-memory file sealed against writes, growth and shrinking, so a
+     * generated config reaches the core without touching the disk. Pass it through {@code inheritedFds} and
+     * let the core open {@code /proc/self/fd/<target>}: that path gets its own offset, which keeps it readable
+     * by every incarnation. Reloading means creating a new sealed file. Linux only.
+     */
+    @NotNull
+    public static SealedFile createSealedFile(@NotNull final String name, @NotNull final ByteBuffer content) throws IOException {
+        Objects.requireNonNull(name);
+
+        if (!content.isDirect()) {
+            throw new IllegalArgumentException("Direct buffer required");
+        }
+
+        final FileDescriptor fd = new FileDescriptor();
+
+        nativeCreateSealedFile(name, content, content.position(), content.remaining(), fd);
+
+        return new SealedFile(fd, content.remaining());
+    }
+
+    /**
+     * Copies the core binary into a sealed in-memory file, so it can be spawned without extracting it to disk:
+     * pass {@link EmbeddedExecutable#getPath()} as the executable path. Natively cached by {@code name}, so loading
+     * the same bytes again, e.g. for a restart, copies nothing. Linux only.
+     */
+    @NotNull
+    public static EmbeddedExecutable loadEmbeddedExecutable(@NotNull final String name, @NotNull final ByteBuffer content) throws IOException {
+        Objects.requireNonNull(name);
+
+        if (!content.isDirect()) {
+            throw new IllegalArgumentException("Direct buffer required");
+        }
+
+        final FileDescriptor fd = new FileDescriptor();
+        final int number = nativeLoadExecutable(name, content, content.position(), content.remaining(), fd);
+
+        return new EmbeddedExecutable(fd, number);
+    }
+
+    /**
+     * Like {@link #loadEmbeddedExecutable(String, ByteBuffer)}, taking {@code length} bytes at {@code offset} of
+     * {@code archive}, such as a stored (uncompressed) entry of our jar. A replaced archive is read again.
+     */
+    @NotNull
+    public static EmbeddedExecutable loadEmbeddedExecutable(
+            @NotNull final String name,
+            @NotNull final Path archive,
+            final long offset,
+            final long length
+    ) throws IOException {
+        Objects.requireNonNull(name);
+
+        final FileDescriptor fd = new FileDescriptor();
+        final int number = nativeLoadArchivedExecutable(name, archive.toAbsolutePath().toString(), offset, length, fd);
+
+        return new EmbeddedExecutable(fd, number);
+    }
+
+    private native static void nativeCreateSealedFile(
+            @NotNull final String name,
+            @NotNull final ByteBuffer content,
+            int offset,
+            int length,
+            @NotNull final FileDescriptor fd // Out
+    ) throws IOException;
+
+    private native static int nativeLoadExecutable(
+            @NotNull final String name,
+            @NotNull final ByteBuffer content,
+            int offset,
+            int length,
+            @NotNull final FileDescriptor fd
+    ) throws IOException;
+
+    private native static int nativeLoadArchivedExecutable(
+            @NotNull final String name,
+            @NotNull final String archive,
+            long offset,
+            long length,
+            @NotNull final FileDescriptor fd
+    ) throws IOException;
+
+    public static final class SealedFile implements AutoCloseable, Closeable {
+        @NotNull
+        private final FileDescriptor fd;
+        private final long size;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+
+        private SealedFile(@NotNull final FileDescriptor fd, final long size) {
+            this.fd = fd;
+            this.size = size;
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> ProcessCompat.releaseFileDescriptor(fd));
+        }
+
+        /**
+         * Stays valid until closed. Children keep their inherited copy.
+         */
+        @NotNull
+        public FileDescriptor getFileDescriptor() {
+            return fd;
+        }
+
+        public long getSize() {
+            return size;
+        }
+
+        @Override
+        public void close() {
+            cleanable.clean();
+        }
+    }
+
+    public static final class EmbeddedExecutable implements AutoCloseable, Closeable {
+        @NotNull
+        private final Path path;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+
+        private EmbeddedExecutable(@NotNull final FileDescriptor fd, final int number) {
+            this.path = Path.of("/proc/self/fd/" + number);
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> ProcessCompat.releaseFileDescriptor(fd));
+        }
+
+        /**
+         * Valid until closed. Prepared processes and supervisors hold their own reference,
+         * so this may be closed once they are set up.
+         */
+        @NotNull
+        public Path getPath() {
+            return path;
+        }
+
+        @Override
+        public void close() {
+            cleanable.clean();
+        }
+    }
+}
@@ -0,0 +1,37 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+
+import java.io.IOException;
+import java.nio.file.Path;
+import java.time.Duration;
+import java.util.List;
+
+public final class OrphanCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    /**
+     * Finds cores a crashed predecessor left running, so that they can be stopped before a new core
+     * fails to bind their ports. Matches processes of this user running {@code executable} (by inode) that
+     * were started with {@code markerName=markerValue} in their environment; put that into the environment
+     * of every core. Linux only.
+     * <p>
+     * The matches are adopted: {@link ProcessCompat.Process#terminate(Duration)} and closing work as
+     * for our own children, but they are not our children, so their exit code is always -1. An embedded
+     * executable gets a new inode per launch and cannot be matched this way.
+     */
+    @NotNull
+    public static List<ProcessCompat.Process> adoptOrphans(
+            @NotNull final Path executable,
+            @NotNull final String markerName,
+            @NotNull final String markerValue
+    ) throws IOException {
+        final long[] handles = nativeFindOrphans(executable.toAbsolutePath().toString(), markerName + "=" + markerValue);
+
+        return ProcessCompat.attachProcesses(handles);
+    }
+
+    private native static long[] nativeFindOrphans(@NotNull final String executable, @NotNull final String marker) throws IOException;
+}
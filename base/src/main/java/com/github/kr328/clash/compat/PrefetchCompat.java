@@ -0,0 +1,115 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+
+import java.io.Closeable;
+import java.lang.ref.Cleaner;
+import java.nio.file.Path;
+import java.util.List;
+import java.util.concurrent.CompletableFuture;
+
+public final class PrefetchCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    /**
+     * Pulls {@code paths}, usually the core binary and its GeoIP/geosite databases, into the page cache on a
+     * native thread, so that a cold start after boot does not wait on the disk. Start it ahead of creating the
+     * process, waiting for {@link Prefetch#onDone()} is optional. Missing files are skipped.
+     *
+     * @param lock keep the pages locked in memory until the prefetch is closed, within RLIMIT_MEMLOCK. Linux only.
+     */
+    @NotNull
+    public static Prefetch prefetchFiles(@NotNull final List<Path> paths, final boolean lock) {
+        final String[] cPaths = paths.stream().map(p -> p.toAbsolutePath().toString()).toArray(String[]::new);
+        final Prefetch.Done done = new Prefetch.Done();
+
+        return new Prefetch(nativePrefetchFiles(cPaths, lock, done), done.future);
+    }
+
+    private native static long nativePrefetchFiles(
+            @NotNull final String[] paths,
+            boolean lock,
+            @NotNull final NativePrefetchListener listener
+    );
+
+    private native static void nativeReleasePrefetch(long session);
+
+    private interface NativePrefetchListener {
+        void onPrefetched(long files, long pages, long residentPages, long lockedPages);
+    }
+
+    public static final class Prefetch implements AutoCloseable, Closeable {
+        @NotNull
+        private final CompletableFuture<Result> done;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+
+        private Prefetch(final long session, @NotNull final CompletableFuture<Result> done) {
+            this.done = done;
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> nativeReleasePrefetch(session));
+        }
+
+        /**
+         * Completes on the native prefetch thread once every read has been issued.
+         */
+        @NotNull
+        public CompletableFuture<Result> onDone() {
+            return done;
+        }
+
+        /**
+         * Unlocks the pages, they stay cached until the kernel needs the memory.
+         */
+        @Override
+        public void close() {
+            cleanable.clean();
+        }
+
+        public static final class Result {
+            private final long files;
+            private final long pages;
+            private final long residentPages;
+            private final long lockedPages;
+
+            private Result(final long files, final long pages, final long residentPages, final long lockedPages) {
+                this.files = files;
+                this.pages = pages;
+                this.residentPages = residentPages;
+                this.lockedPages = lockedPages;
+            }
+
+            /**
+             * @return files that could be opened.
+             */
+            public long getFiles() {
+                return files;
+            }
+
+            public long getPages() {
+                return pages;
+            }
+
+            /**
+             * @return pages that were cached before the prefetch, -1 where the platform or any file cannot tell.
+             */
+            public long getResidentPages() {
+                return residentPages;
+            }
+
+            public long getLockedPages() {
+                return lockedPages;
+            }
+        }
+
+        private static final class Done implements NativePrefetchListener {
+            private final CompletableFuture<Result> future = new CompletableFuture<>();
+
+            @Override
+            public void onPrefetched(final long files, final long pages, final long residentPages, final long lockedPages) {
+                future.complete(new Result(files, pages, residentPages, lockedPages));
+            }
+        }
+    }
+}
@@ -0,0 +1,76 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+
+import java.io.Closeable;
+import java.io.IOException;
+import java.lang.ref.Cleaner;
+import java.time.Duration;
+import java.util.Objects;
+import java.util.concurrent.TimeUnit;
+
+public final class PressureCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    /**
+     * Registers a PSI trigger on the {@code memory.pressure} of the cgroup {@code process} runs in,
+     * or on {@code /proc/pressure/memory} if it sits in the root cgroup. Linux only.
+     *
+     * @param full   count the time every task stalled, instead of some.
+     * @param stall  stall time within {@code window} that fires the trigger.
+     * @param window a multiple of 2s unless the JVM is privileged.
+     */
+    @NotNull
+    public static PressureMonitor watchMemoryPressure(
+            @NotNull final ProcessCompat.Process process,
+            final boolean full,
+            @NotNull final Duration stall,
+            @NotNull final Duration window,
+            @NotNull final PressureListener listener
+    ) throws IOException {
+        Objects.requireNonNull(listener);
+
+        final long stallMicros = TimeUnit.NANOSECONDS.toMicros(stall.toNanos());
+        final long windowMicros = TimeUnit.NANOSECONDS.toMicros(window.toNanos());
+
+        synchronized (process) {
+            process.ensureOpen();
+
+            return new PressureMonitor(nativeWatchMemoryPressure(process.handle, full, stallMicros, windowMicros, listener));
+        }
+    }
+
+    private native static long nativeWatchMemoryPressure(
+            long handle,
+            boolean full,
+            long stallMicros,
+            long windowMicros,
+            @NotNull final PressureListener listener
+    ) throws IOException;
+
+    private native static void nativeReleasePressureMonitor(long monitor);
+
+    /**
+     * Called on the native looper thread, at most once per trigger window.
+     * Averages are percentages, totals the cumulative stall time.
+     */
+    public interface PressureListener {
+        void onPressure(double someAvg10, double fullAvg10, long someTotalMicros, long fullTotalMicros);
+    }
+
+    public static final class PressureMonitor implements AutoCloseable, Closeable {
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+
+        private PressureMonitor(final long monitor) {
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> nativeReleasePressureMonitor(monitor));
+        }
+
+        @Override
+        public void close() {
+            cleanable.clean();
+        }
+    }
+}
@@ -6,8 +6,14 @@ import org.jetbrains.annotations.Nullable;
 import java.io.Closeable;
 import java.io.FileDescriptor;
 import java.io.IOException;
+import java.lang.invoke.MethodHandles;
+import java.lang.invoke.VarHandle;
 import java.lang.ref.Cleaner;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.nio.file.Path;
+import java.time.Duration;
+import java.util.ArrayList;
 import java.util.HashMap;
 import java.util.List;
 import java.util.Map;
@@ -15,75 +21,301 @@ import java.util.Objects;
 import java.util.concurrent.*;
 
 public final class ProcessCompat {
-    private static final ExecutorService MONITOR_POOL = Executors.newCachedThreadPool((runnable) -> {
-        final Thread thread = new Thread(runnable);
-        thread.setName("Process-Monitor-Thread");
-        thread.setDaemon(true);
-        return thread;
-    });
-
     static {
         CompatLibrary.load();
     }
 
+    @NotNull
+    public static Process createProcess(
+            @NotNull final Path executablePath,
+            @NotNull final List<String> arguments,
+            @Nullable final Path workingDir,
+            @Nullable final Map<String, String> environments,
+            final boolean pipeStdin,
+            final boolean pipeStdout,
+            final boolean pipeStderr
+    ) throws IOException {
+        return createProcess(executablePath, arguments, workingDir, environments, null, pipeStdin, pipeStdout, pipeStderr);
+    }
+
+    /**
+     * @param inheritedFds extra descriptors passed to the child, keyed by the descriptor number they get in the child.
+     *                     On Windows the handles are inherited with their original values and the keys are ignored.
+     */
     @NotNull
     public static synchronized Process createProcess(
             @NotNull final Path executablePath,
             @NotNull final List<String> arguments,
             @Nullable final Path workingDir,
             @Nullable final Map<String, String> environments,
+            @Nullable final Map<Integer, FileDescriptor> inheritedFds,
             final boolean pipeStdin,
             final boolean pipeStdout,
             final boolean pipeStderr
     ) throws IOException {
-        Objects.requireNonNull(executablePath);
-        Objects.requireNonNull(arguments);
+        final Command command = new Command(executablePath, arguments, workingDir, environments, inheritedFds);
 
-        final Map<String, String> mergedEnvironments = new HashMap<>(System.getenv());
-        if (environments != null) {
-            mergedEnvironments.putAll(environments);
-        }
+        final FileDescriptor stdin = pipeStdin ? new FileDescriptor() : null;
+        final FileDescriptor stdout = pipeStdout ? new FileDescriptor() : null;
+        final FileDescriptor stderr = pipeStderr ? new FileDescriptor() : null;
 
-        final String nativeExecutablePath = executablePath.toAbsolutePath().toString();
-        final String[] nativeArguments = arguments.toArray(String[]::new);
-        final String nativeWorkingDir = (workingDir != null ? workingDir : Path.of(".")).toAbsolutePath().toString();
-        final String[] nativeEnvironments = mergedEnvironments.entrySet().stream()
-                .map(e -> e.getKey() + "=" + e.getValue()).toArray(String[]::new);
+        final long handle = nativeCreateProcess(
+                command.path,
+                command.arguments,
+                command.workingDir,
+                command.environments,
+                command.inheritedFds,
+                command.inheritedTargets,
+                stdin,
+                stdout,
+                stderr
+        );
 
-        final FileDescriptor stdin;
-        if (pipeStdin) {
-            stdin = new FileDescriptor();
-        } else {
-            stdin = null;
-        }
+        return attachProcess(handle, stdin, stdout, stderr, null, null);
+    }
 
-        final FileDescriptor stdout;
-        if (pipeStdout) {
-            stdout = new FileDescriptor();
-        } else {
-            stdout = null;
-        }
+    /**
+     * Like {@link #createProcess(Path, List, Path, Map, Map, boolean, boolean, boolean)}, but stdout and stderr
+     * are drained natively into {@code logTarget} and are not exposed by the returned process.
+     */
+    @NotNull
+    public static Process createProcess(
+            @NotNull final Path executablePath,
+            @NotNull final List<String> arguments,
+            @Nullable final Path workingDir,
+            @Nullable final Map<String, String> environments,
+            @Nullable final Map<Integer, FileDescriptor> inheritedFds,
+            final boolean pipeStdin,
+            @NotNull final LogTarget logTarget
+    ) throws IOException {
+        return createProcess(executablePath, arguments, workingDir, environments, inheritedFds, pipeStdin, logTarget, null);
+    }
 
-        final FileDescriptor stderr;
-        if (pipeStderr) {
-            stderr = new FileDescriptor();
-        } else {
-            stderr = null;
-        }
+    /**
+     * @param readiness probes completing {@link Process#onReady()} natively, instead of polling the core from Java.
+     */
+    @NotNull
+    public static synchronized Process createProcess(
+            @NotNull final Path executablePath,
+            @NotNull final List<String> arguments,
+            @Nullable final Path workingDir,
+            @Nullable final Map<String, String> environments,
+            @Nullable final Map<Integer, FileDescriptor> inheritedFds,
+            final boolean pipeStdin,
+            @NotNull final LogTarget logTarget,
+            @Nullable final Readiness readiness
+    ) throws IOException {
+        Objects.requireNonNull(logTarget);
+
+        final Command command = new Command(executablePath, arguments, workingDir, environments, inheritedFds);
+
+        final FileDescriptor stdin = pipeStdin ? new FileDescriptor() : null;
+        final FileDescriptor stdout = new FileDescriptor();
+        final FileDescriptor stderr = new FileDescriptor();
 
         final long handle = nativeCreateProcess(
-                nativeExecutablePath,
-                nativeArguments,
-                nativeWorkingDir,
-                nativeEnvironments,
+                command.path,
+                command.arguments,
+                command.workingDir,
+                command.environments,
+                command.inheritedFds,
+                command.inheritedTargets,
                 stdin,
                 stdout,
                 stderr
         );
 
-        final Future<Integer> monitor = MONITOR_POOL.submit(() -> nativeWaitProcess(handle));
+        return attachProcess(handle, stdin, stdout, stderr, logTarget, readiness);
+    }
+
+    /**
+     * Marshals the command once into a native template, so that repeated launches skip
+     * string conversion and reopening the executable and working directory.
+     * Inherited descriptors are duplicated into the template and may be closed by the caller.
+     */
+    @NotNull
+    public static PreparedProcess prepareProcess(
+            @NotNull final Path executablePath,
+            @NotNull final List<String> arguments,
+            @Nullable final Path workingDir,
+            @Nullable final Map<String, String> environments,
+            @Nullable final Map<Integer, FileDescriptor> inheritedFds
+    ) throws IOException {
+        return prepareProcess(executablePath, arguments, workingDir, environments, inheritedFds, null);
+    }
+
+    /**
+     * @param placement applied by the child before it execs, so the core never runs outside of it.
+     */
+    @NotNull
+    public static PreparedProcess prepareProcess(
+            @NotNull final Path executablePath,
+            @NotNull final List<String> arguments,
+            @Nullable final Path workingDir,
+            @Nullable final Map<String, String> environments,
+            @Nullable final Map<Integer, FileDescriptor> inheritedFds,
+            @Nullable final Placement placement
+    ) throws IOException {
+        final Command command = new Command(executablePath, arguments, workingDir, environments, inheritedFds);
+
+        return new PreparedProcess(prepare(command, placement, false));
+    }
+
+    /**
+     * Prepares the best of several builds of the same core, see {@link CpuCompat#selectExecutable}.
+     */
+    @NotNull
+    public static PreparedProcess prepareProcess(
+            @NotNull final List<CpuCompat.ExecutableCandidate> candidates,
+            @NotNull final List<String> arguments,
+            @Nullable final Path workingDir,
+            @Nullable final Map<String, String> environments,
+            @Nullable final Map<Integer, FileDescriptor> inheritedFds,
+            @Nullable final Placement placement
+    ) throws IOException {
+        return prepareProcess(CpuCompat.selectExecutable(candidates), arguments, workingDir, environments, inheritedFds, placement);
+    }
+
+    /**
+     * A template bound to the JVM, as {@link SupervisorCompat#superviseProcess} spawns its cores from.
+     */
+    static long prepareBound(
+            @NotNull final Path executablePath,
+            @NotNull final List<String> arguments,
+            @Nullable final Path workingDir,
+            @Nullable final Map<String, String> environments,
+            @Nullable final Map<Integer, FileDescriptor> inheritedFds,
+            @Nullable final Placement placement
+    ) throws IOException {
+        final Command command = new Command(executablePath, arguments, workingDir, environments, inheritedFds);
+
+        return prepare(command, placement != null ? placement : new Placement(), true);
+    }
+
+    static void releasePrepared(final long prepared) {
+        nativeReleasePrepared(prepared);
+    }
+
+    private static long prepare(
+            @NotNull final Command command,
+            @Nullable final Placement placement,
+            final boolean bindToParent
+    ) throws IOException {
+        if (placement != null) {
+            return nativePrepareSpawn(
+                    command.path,
+                    command.arguments,
+                    command.workingDir,
+                    command.environments,
+                    command.inheritedFds,
+                    command.inheritedTargets,
+                    true,
+                    placement.cgroup != null ? placement.cgroup.toAbsolutePath().toString() : null,
+                    placement.cpus,
+                    placement.nice != null,
+                    placement.nice != null ? placement.nice : 0,
+                    placement.ioPriority,
+                    placement.maxOpenFiles,
+                    placement.transparentHugePages,
+                    bindToParent
+            );
+        }
+
+        return nativePrepareSpawn(
+                command.path,
+                command.arguments,
+                command.workingDir,
+                command.environments,
+                command.inheritedFds,
+                command.inheritedTargets,
+                false,
+                null,
+                null,
+                false,
+                0,
+                -1,
+                -1,
+                -1,
+                false
+        );
+    }
+
+    /**
+     * Attaches processes found by other modules, e.g. {@link OrphanCompat}. On failure the handles that
+     * were not attached yet are released.
+     */
+    @NotNull
+    static List<Process> attachProcesses(@NotNull final long[] handles) throws IOException {
+        final List<Process> processes = new ArrayList<>(handles.length);
+        for (int i = 0; i < handles.length; i++) {
+            try {
+                processes.add(attachProcess(handles[i], null, null, null, null, null));
+            } catch (final IOException e) {
+                for (int j = i + 1; j < handles.length; j++) {
+                    nativeReleaseProcess(handles[j]);
+                }
+
+                throw e;
+            }
+        }
+
+        return processes;
+    }
+
+    @NotNull
+    private static Process attachProcess(
+            final long handle,
+            @Nullable final FileDescriptor stdin,
+            @Nullable final FileDescriptor stdout,
+            @Nullable final FileDescriptor stderr,
+            @Nullable final LogTarget logTarget,
+            @Nullable final Readiness readiness
+    ) throws IOException {
+        final Process.Status status = new Process.Status();
+
+        try {
+            // the marker probe interposes on stdout, so it goes first
+            if (readiness != null) {
+                nativeWatchReadiness(
+                        handle,
+                        stdout,
+                        readiness.marker,
+                        readiness.port,
+                        readiness.unixSocket != null ? readiness.unixSocket.toAbsolutePath().toString() : null,
+                        readiness.timeout.toMillis(),
+                        status
+                );
+            } else {
+                status.ready.complete(true);
+            }
+
+            if (logTarget != null) {
+                logTarget.attach(new FileDescriptor[]{stdout, stderr});
+            }
+
+            nativeWatchProcess(handle, status);
+        } catch (final IOException e) {
+            nativeTerminateProcess(handle);
+            nativeReleaseProcess(handle);
+
+            if (stdin != null) {
+                releaseFileDescriptor(stdin);
+            }
+            if (stdout != null) {
+                releaseFileDescriptor(stdout);
+            }
+            if (stderr != null) {
+                releaseFileDescriptor(stderr);
+            }
 
-        return new Process(handle, stdin, stdout, stderr, monitor);
+            throw e;
+        }
+
+        if (logTarget != null) {
+            return new Process(handle, stdin, null, null, status);
+        }
+
+        return new Process(handle, stdin, stdout, stderr, status);
     }
 
     private native static long nativeCreateProcess(
@@ -91,20 +323,79 @@ public final class ProcessCompat {
             @NotNull final String[] args,
             @NotNull final String workingDir,
             @NotNull final String[] environments,
+            @Nullable final FileDescriptor[] inheritedFds,
+            @Nullable final int[] inheritedTargets,
+            @Nullable final FileDescriptor stdin,  // Out
+            @Nullable final FileDescriptor stdout, // Out
+            @Nullable final FileDescriptor stderr  // Out
+    ) throws IOException;
+
+    private native static long nativePrepareSpawn(
+            @NotNull final String path,
+            @NotNull final String[] args,
+            @NotNull final String workingDir,
+            @NotNull final String[] environments,
+            @Nullable final FileDescriptor[] inheritedFds,
+            @Nullable final int[] inheritedTargets,
+            boolean hasPlacement,
+            @Nullable final String cgroup,
+            @Nullable final int[] cpus,
+            boolean hasNice,
+            int nice,
+            int ioPriority,
+            long maxOpenFiles,
+            int transparentHugePages,
+            boolean bindToParent
+    ) throws IOException;
+
+    private native static long nativeSpawnPrepared(
+            long prepared,
             @Nullable final FileDescriptor stdin,  // Out
             @Nullable final FileDescriptor stdout, // Out
             @Nullable final FileDescriptor stderr  // Out
     ) throws IOException;
 
-    private native static int nativeWaitProcess(long handle);
+    private native static void nativeReleasePrepared(long prepared);
+
+    private native static void nativeAttachLogSink(
+            @NotNull final String path,
+            long maxBytes,
+            int maxFiles,
+            @NotNull final FileDescriptor[] sources
+    ) throws IOException;
+
+    private native static long nativeCreateLogRing(int capacity) throws IOException;
+
+    @NotNull
+    private native static ByteBuffer nativeLogRingBuffer(long ring);
+
+    private native static void nativeAttachLogRing(long ring, @NotNull final FileDescriptor[] sources) throws IOException;
+
+    private native static void nativeReleaseLogRing(long ring);
+
+    private native static void nativeWatchProcess(long handle, @NotNull final NativeExitListener listener) throws IOException;
+
+    private native static void nativeWatchReadiness(
+            long handle,
+            @Nullable final FileDescriptor stdout, // In/Out
+            @Nullable final String marker,
+            int port,
+            @Nullable final String unixSocket,
+            long timeoutMillis,
+            @NotNull final NativeReadinessListener listener
+    ) throws IOException;
+
+    private native static boolean nativeSampleProcess(long handle, @NotNull final long[] values);
 
     private native static void nativeTerminateProcess(long handle);
 
+    private native static void nativeTerminateProcess(long handle, long graceMillis);
+
     private native static void nativeReleaseProcess(long handle);
 
     private native static void nativeReleaseFileDescriptor(@NotNull final FileDescriptor fd) throws IOException;
 
-    private static void releaseFileDescriptor(@NotNull final FileDescriptor fd) {
+    static void releaseFileDescriptor(@NotNull final FileDescriptor fd) {
         try {
             nativeReleaseFileDescriptor(fd);
         } catch (IOException e) {
@@ -112,9 +403,491 @@ public final class ProcessCompat {
         }
     }
 
-    public static class Process implements AutoCloseable, Closeable, Future<Integer> {
-        private static final Cleaner cleaner = Cleaner.create();
+    private static final class Command {
+        @NotNull
+        private final String path;
+        @NotNull
+        private final String[] arguments;
+        @NotNull
+        private final String workingDir;
+        @NotNull
+        private final String[] environments;
+        @Nullable
+        private final FileDescriptor[] inheritedFds;
+        @Nullable
+        private final int[] inheritedTargets;
+
+        private Command(
+                @NotNull final Path executablePath,
+                @NotNull final List<String> arguments,
+                @Nullable final Path workingDir,
+                @Nullable final Map<String, String> environments,
+                @Nullable final Map<Integer, FileDescriptor> inheritedFds
+        ) {
+            Objects.requireNonNull(executablePath);
+            Objects.requireNonNull(arguments);
+
+            final Map<String, String> mergedEnvironments = new HashMap<>(System.getenv());
+            if (environments != null) {
+                mergedEnvironments.putAll(environments);
+            }
+
+            this.path = executablePath.toAbsolutePath().toString();
+            this.arguments = arguments.toArray(String[]::new);
+            this.workingDir = (workingDir != null ? workingDir : Path.of(".")).toAbsolutePath().toString();
+            this.environments = mergedEnvironments.entrySet().stream()
+                    .map(e -> e.getKey() + "=" + e.getValue()).toArray(String[]::new);
+
+            if (inheritedFds != null) {
+                this.inheritedFds = inheritedFds.values().toArray(FileDescriptor[]::new);
+                this.inheritedTargets = inheritedFds.keySet().stream().mapToInt(Integer::intValue).toArray();
+            } else {
+                this.inheritedFds = null;
+                this.inheritedTargets = null;
+            }
+        }
+    }
+
+    private interface NativeExitListener {
+        void onExited(
+                int status,
+                long userTimeMicros,
+                long systemTimeMicros,
+                long maxResidentKb,
+                long minorFaults,
+                long majorFaults,
+                long voluntarySwitches,
+                long involuntarySwitches
+        );
+    }
+
+    private interface NativeReadinessListener {
+        void onReady(boolean ready);
+    }
+
+    public static final class ResourceUsage {
+        private final long userTimeMicros;
+        private final long systemTimeMicros;
+        private final long maxResidentKb;
+        private final long minorFaults;
+        private final long majorFaults;
+        private final long voluntarySwitches;
+        private final long involuntarySwitches;
+
+        public ResourceUsage(
+                long userTimeMicros,
+                long systemTimeMicros,
+                long maxResidentKb,
+                long minorFaults,
+                long majorFaults,
+                long voluntarySwitches,
+                long involuntarySwitches
+        ) {
+            this.userTimeMicros = userTimeMicros;
+            this.systemTimeMicros = systemTimeMicros;
+            this.maxResidentKb = maxResidentKb;
+            this.minorFaults = minorFaults;
+            this.majorFaults = majorFaults;
+            this.voluntarySwitches = voluntarySwitches;
+            this.involuntarySwitches = involuntarySwitches;
+        }
+
+        public long getUserTimeMicros() {
+            return userTimeMicros;
+        }
+
+        public long getSystemTimeMicros() {
+            return systemTimeMicros;
+        }
+
+        public long getMaxResidentKb() {
+            return maxResidentKb;
+        }
+
+        public long getMinorFaults() {
+            return minorFaults;
+        }
+
+        public long getMajorFaults() {
+            return majorFaults;
+        }
 
+        public long getVoluntarySwitches() {
+            return voluntarySwitches;
+        }
+
+        public long getInvoluntarySwitches() {
+            return involuntarySwitches;
+        }
+    }
+
+    /**
+     * Reusable holder for {@link Process#sample(ResourceSample)}. Counters the platform cannot provide are -1.
+     */
+    public static final class ResourceSample {
+        private final long[] values = new long[8];
+
+        public long getUserTimeMicros() {
+            return values[0];
+        }
+
+        public long getSystemTimeMicros() {
+            return values[1];
+        }
+
+        public long getResidentKb() {
+            return values[2];
+        }
+
+        public long getVoluntarySwitches() {
+            return values[3];
+        }
+
+        public long getInvoluntarySwitches() {
+            return values[4];
+        }
+
+        public long getReadBytes() {
+            return values[5];
+        }
+
+        public long getWrittenBytes() {
+            return values[6];
+        }
+
+        public long getThreads() {
+            return values[7];
+        }
+    }
+
+    /**
+     * Where and how the child runs. Unset fields are inherited from the JVM.
+     * Windows only honours the CPU set (first 64 CPUs) and the nice value, mapped to a priority class.
+     */
+    public static final class Placement {
+        public static final int IO_PRIORITY_CLASS_REALTIME = 1;
+        public static final int IO_PRIORITY_CLASS_BEST_EFFORT = 2;
+        public static final int IO_PRIORITY_CLASS_IDLE = 3;
+
+        @Nullable
+        private Path cgroup = null;
+        @Nullable
+        private int[] cpus = null;
+        @Nullable
+        private Integer nice = null;
+        private int ioPriority = -1;
+        private long maxOpenFiles = -1;
+        private int transparentHugePages = -1;
+
+        /**
+         * @param cgroup cgroup v2 directory the child joins, e.g. {@code /sys/fs/cgroup/clash.slice/core}.
+         */
+        @NotNull
+        public Placement setCgroup(@Nullable final Path cgroup) {
+            this.cgroup = cgroup;
+            return this;
+        }
+
+        @NotNull
+        public Placement setCpus(@Nullable final int... cpus) {
+            this.cpus = cpus != null ? cpus.clone() : null;
+            return this;
+        }
+
+        @NotNull
+        public Placement setNice(@Nullable final Integer nice) {
+            this.nice = nice;
+            return this;
+        }
+
+        @NotNull
+        public Placement setIoPriority(final int ioClass, final int level) {
+            this.ioPriority = (ioClass << 13) | (level & 0x1fff);
+            return this;
+        }
+
+        /**
+         * Raises the soft limit, and the hard limit too when permitted. Otherwise it is capped at the hard limit.
+         */
+        @NotNull
+        public Placement setMaxOpenFiles(final long maxOpenFiles) {
+            this.maxOpenFiles = maxOpenFiles;
+            return this;
+        }
+
+        /**
+         * Linux only. The policy is set on the core's mm before it executes. Cores bound to the JVM are
+         * spawned from it, so the JVM's own policy is switched for as long as the spawn takes, one spawn at a time.
+         */
+        @NotNull
+        public Placement setTransparentHugePages(final boolean enabled) {
+            this.transparentHugePages = enabled ? 1 : 0;
+            return this;
+        }
+    }
+
+    /**
+     * Conditions that make a core ready, all of which must hold. Linux only, except for the output marker.
+     */
+    public static final class Readiness {
+        @Nullable
+        private String marker = null;
+        private int port = -1;
+        @Nullable
+        private Path unixSocket = null;
+        @NotNull
+        private Duration timeout = Duration.ZERO;
+
+        /**
+         * Ready once stdout contains {@code marker}. The output still reaches the log target unchanged.
+         */
+        @NotNull
+        public Readiness expectOutput(@Nullable final String marker) {
+            this.marker = marker != null && !marker.isEmpty() ? marker : null;
+            return this;
+        }
+
+        /**
+         * Ready once the core itself listens on TCP {@code port}, or on any port if it is 0.
+         */
+        @NotNull
+        public Readiness expectListening(final int port) {
+            this.port = port;
+            return this;
+        }
+
+        @NotNull
+        public Readiness expectUnixSocket(@Nullable final Path path) {
+            this.unixSocket = path;
+            return this;
+        }
+
+        /**
+         * Gives up after {@code timeout}. Zero waits until the core exits.
+         */
+        @NotNull
+        public Readiness setTimeout(@NotNull final Duration timeout) {
+            this.timeout = Objects.requireNonNull(timeout);
+            return this;
+        }
+    }
+
+    /**
+     * Destination that takes over the stdout and stderr pipes of a child.
+     */
+    public static abstract class LogTarget {
+        LogTarget() {
+        }
+
+        abstract void attach(@NotNull final FileDescriptor[] sources) throws IOException;
+    }
+
+    /**
+     * A size-capped log file rotated as {@code path}, {@code path.1}, ... {@code path.(maxFiles - 1)}.
+     * A non-positive {@code maxBytes} disables rotation.
+     */
+    public static final class LogSink extends LogTarget {
+        @NotNull
+        private final Path path;
+        private final long maxBytes;
+        private final int maxFiles;
+
+        public LogSink(@NotNull final Path path, final long maxBytes, final int maxFiles) {
+            this.path = Objects.requireNonNull(path);
+            this.maxBytes = maxBytes;
+            this.maxFiles = Math.max(maxFiles, 1);
+        }
+
+        @NotNull
+        public Path getPath() {
+            return path;
+        }
+
+        public long getMaxBytes() {
+            return maxBytes;
+        }
+
+        public int getMaxFiles() {
+            return maxFiles;
+        }
+
+        @Override
+        void attach(@NotNull final FileDescriptor[] sources) throws IOException {
+            nativeAttachLogSink(path.toAbsolutePath().toString(), maxBytes, maxFiles, sources);
+        }
+    }
+
+    /**
+     * Native ring buffer holding the latest output of one or more children, filled without Java threads.
+     * When full the oldest bytes are dropped. Positions are sequence numbers counting every byte ever written.
+     */
+    public static final class LogRing extends LogTarget implements AutoCloseable, Closeable {
+        private static final VarHandle LONGS = MethodHandles.byteBufferViewVarHandle(long[].class, ByteOrder.nativeOrder());
+
+        private static final int OFFSET_COMMITTED = 0;
+        private static final int OFFSET_CLAIMED = 8;
+        private static final int OFFSET_CAPACITY = 16;
+        private static final int HEADER_SIZE = 64;
+
+        final long ring;
+        @NotNull
+        private final ByteBuffer mapping;
+        private final int capacity;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+
+        private boolean closed = false;
+
+        public LogRing(final int capacity) throws IOException {
+            final long ring = nativeCreateLogRing(capacity);
+
+            this.ring = ring;
+            this.mapping = nativeLogRingBuffer(ring);
+            this.capacity = (int) (long) LONGS.get(mapping, OFFSET_CAPACITY);
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> nativeReleaseLogRing(ring));
+        }
+
+        public int getCapacity() {
+            return capacity;
+        }
+
+        /**
+         * @return sequence number following the latest written byte.
+         */
+        public synchronized long getSequence() {
+            ensureOpen();
+
+            return (long) LONGS.getAcquire(mapping, OFFSET_COMMITTED);
+        }
+
+        /**
+         * Copies bytes starting at sequence {@code from} into {@code dst}, as many as fit.
+         * Bytes already overwritten are skipped, so the copy may start after {@code from}.
+         *
+         * @return sequence number following the last copied byte.
+         */
+        public synchronized long read(final long from, @NotNull final ByteBuffer dst) {
+            ensureOpen();
+
+            final long committed = (long) LONGS.getAcquire(mapping, OFFSET_COMMITTED);
+            final long start = Math.max(from, committed - capacity);
+            final int length = (int) Math.min(Math.max(committed - start, 0), dst.remaining());
+
+            final int position = dst.position();
+            for (int copied = 0; copied < length; ) {
+                final int offset = (int) ((start + copied) & (capacity - 1));
+                final int chunk = Math.min(length - copied, capacity - offset);
+
+                dst.put(mapping.duplicate().position(HEADER_SIZE + offset).limit(HEADER_SIZE + offset + chunk));
+
+                copied += chunk;
+            }
+
+            VarHandle.fullFence();
+
+            // drop the prefix the writer overwrote while it was being copied
+            final long claimed = (long) LONGS.getAcquire(mapping, OFFSET_CLAIMED);
+            final int overwritten = (int) Math.min(Math.max(claimed - capacity - start, 0), length);
+            if (overwritten > 0) {
+                final ByteBuffer valid = dst.duplicate().position(position + overwritten).limit(position + length);
+
+                dst.position(position).put(valid);
+            }
+
+            return start + length;
+        }
+
+        @Override
+        public synchronized void close() {
+            closed = true;
+
+            cleanable.clean();
+        }
+
+        @Override
+        synchronized void attach(@NotNull final FileDescriptor[] sources) throws IOException {
+            ensureOpen();
+
+            nativeAttachLogRing(ring, sources);
+        }
+
+        void ensureOpen() {
+            if (closed) {
+                throw new IllegalStateException("Log ring closed");
+            }
+        }
+    }
+
+    public static final class PreparedProcess implements AutoCloseable, Closeable {
+        private final long prepared;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+
+        private boolean closed = false;
+
+        private PreparedProcess(final long prepared) {
+            this.prepared = prepared;
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> nativeReleasePrepared(prepared));
+        }
+
+        @NotNull
+        public Process start(
+                final boolean pipeStdin,
+                final boolean pipeStdout,
+                final boolean pipeStderr
+        ) throws IOException {
+            final FileDescriptor stdin = pipeStdin ? new FileDescriptor() : null;
+            final FileDescriptor stdout = pipeStdout ? new FileDescriptor() : null;
+            final FileDescriptor stderr = pipeStderr ? new FileDescriptor() : null;
+
+            return attachProcess(spawn(stdin, stdout, stderr), stdin, stdout, stderr, null, null);
+        }
+
+        @NotNull
+        public Process start(final boolean pipeStdin, @NotNull final LogTarget logTarget) throws IOException {
+            return start(pipeStdin, logTarget, null);
+        }
+
+        @NotNull
+        public Process start(
+                final boolean pipeStdin,
+                @NotNull final LogTarget logTarget,
+                @Nullable final Readiness readiness
+        ) throws IOException {
+            Objects.requireNonNull(logTarget);
+
+            final FileDescriptor stdin = pipeStdin ? new FileDescriptor() : null;
+            final FileDescriptor stdout = new FileDescriptor();
+            final FileDescriptor stderr = new FileDescriptor();
+
+            return attachProcess(spawn(stdin, stdout, stderr), stdin, stdout, stderr, logTarget, readiness);
+        }
+
+        private long spawn(
+                @Nullable final FileDescriptor stdin,
+                @Nullable final FileDescriptor stdout,
+                @Nullable final FileDescriptor stderr
+        ) throws IOException {
+            synchronized (ProcessCompat.class) {
+                synchronized (this) {
+                    if (closed) {
+                        throw new IOException("Prepared process closed");
+                    }
+
+                    return nativeSpawnPrepared(prepared, stdin, stdout, stderr);
+                }
+            }
+        }
+
+        @Override
+        public synchronized void close() {
+            closed = true;
+
+            cleanable.clean();
+        }
+    }
+
+    public static class Process implements AutoCloseable, Closeable, Future<Integer> {
         @Nullable
         private final FileDescriptor stdin;
         @Nullable
@@ -124,16 +897,19 @@ public final class ProcessCompat {
         @NotNull
         private final Cleaner.Cleanable cleanable;
         @NotNull
-        private final Future<Integer> monitor;
+        private final Status status;
+        final long handle;
+
+        private boolean closed = false;
 
         private Process(
                 final long handle,
                 @Nullable final FileDescriptor stdin,
                 @Nullable final FileDescriptor stdout,
                 @Nullable final FileDescriptor stderr,
-                @NotNull final Future<Integer> monitor
+                @NotNull final Status status
         ) {
-            this.cleanable = cleaner.register(this, () -> {
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> {
                 nativeTerminateProcess(handle);
                 nativeReleaseProcess(handle);
 
@@ -151,7 +927,8 @@ public final class ProcessCompat {
             this.stdin = stdin;
             this.stdout = stdout;
             this.stderr = stderr;
-            this.monitor = monitor;
+            this.status = status;
+            this.handle = handle;
         }
 
         @Nullable
@@ -169,14 +946,69 @@ public final class ProcessCompat {
             return stderr;
         }
 
+        @Nullable
+        public ResourceUsage getResourceUsage() {
+            return status.usage;
+        }
+
+        /**
+         * Fills {@code sample} with the current usage of the running process, without allocating.
+         *
+         * @return false if the process has exited or was closed.
+         */
+        public synchronized boolean sample(@NotNull final ResourceSample sample) {
+            if (closed) {
+                return false;
+            }
+
+            return nativeSampleProcess(handle, sample.values);
+        }
+
+        /**
+         * Asks the process to stop with SIGTERM and escalates to SIGKILL natively once {@code grace} elapses.
+         * Windows has no stop request a console-less child is sure to receive and kills right away.
+         *
+         * @return completes once the process has exited.
+         */
+        @NotNull
+        public synchronized CompletableFuture<Process> terminate(@NotNull final Duration grace) {
+            if (!closed) {
+                nativeTerminateProcess(handle, grace.toMillis());
+            }
+
+            return onExit();
+        }
+
+        @NotNull
+        public CompletableFuture<Process> onExit() {
+            return status.exit.thenApply(code -> this);
+        }
+
+        /**
+         * Completes exactly once: true when every readiness probe passed, false if the core exited or timed out first.
+         * Without probes it completes with true right away.
+         */
+        @NotNull
+        public CompletableFuture<Boolean> onReady() {
+            return status.ready;
+        }
+
         @Override
-        public void close() {
+        public synchronized void close() {
+            closed = true;
+
             cleanable.clean();
         }
 
+        void ensureOpen() throws IOException {
+            if (closed) {
+                throw new IOException("Process closed");
+            }
+        }
+
         @Override
         public boolean cancel(boolean mayInterruptIfRunning) {
-            if (monitor.cancel(mayInterruptIfRunning)) {
+            if (status.exit.cancel(mayInterruptIfRunning)) {
                 close();
 
                 return true;
@@ -187,24 +1019,64 @@ public final class ProcessCompat {
 
         @Override
         public boolean isCancelled() {
-            return monitor.isCancelled();
+            return status.exit.isCancelled();
         }
 
         @Override
         public boolean isDone() {
-            return monitor.isDone();
+            return status.exit.isDone();
         }
 
         @NotNull
         @Override
         public Integer get() throws InterruptedException, ExecutionException {
-            return monitor.get();
+            return status.exit.get();
         }
 
         @NotNull
         @Override
         public Integer get(long timeout, @NotNull TimeUnit unit) throws InterruptedException, ExecutionException, TimeoutException {
-            return monitor.get(timeout, unit);
+            return status.exit.get(timeout, unit);
+        }
+
+        /**
+         * Called on the native looper thread, which also reaps, splices logs and probes readiness for every
+         * other process, so dependent stages run on the common pool instead.
+         */
+        private static final class Status implements NativeExitListener, NativeReadinessListener {
+            private final CompletableFuture<Integer> exit = new CompletableFuture<>();
+            private final CompletableFuture<Boolean> ready = new CompletableFuture<>();
+
+            private volatile ResourceUsage usage = null;
+
+            @Override
+            public void onExited(
+                    int status,
+                    long userTimeMicros,
+                    long systemTimeMicros,
+                    long maxResidentKb,
+                    long minorFaults,
+                    long majorFaults,
+                    long voluntarySwitches,
+                    long involuntarySwitches
+            ) {
+                usage = new ResourceUsage(
+                        userTimeMicros,
+                        systemTimeMicros,
+                        maxResidentKb,
+                        minorFaults,
+                        majorFaults,
+                        voluntarySwitches,
+                        involuntarySwitches
+                );
+
+                exit.completeAsync(() -> status);
+            }
+
+            @Override
+            public void onReady(final boolean ready) {
+                this.ready.completeAsync(() -> ready);
+            }
         }
     }
 }
@@ -0,0 +1,354 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+import org.jetbrains.annotations.Nullable;
+
+import java.io.IOException;
+import java.net.InetAddress;
+import java.net.UnknownHostException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.ArrayList;
+import java.util.List;
+
+public final class RoutesCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    /**
+     * Reads what {@link #applyRoutes} would compare {@code plan} against: routes and rules tagged with
+     * {@code protocol}, addresses on the interfaces the plan assigns addresses to, and which of the
+     * interfaces the plan brings up are up. Linux only.
+     */
+    @NotNull
+    public static List<RouteEntry> readRoutes(@NotNull final List<RouteEntry> plan, final int protocol) throws IOException {
+        return RouteEntry.decode(nativeReadRoutes(RouteEntry.encode(plan), protocol));
+    }
+
+    /**
+     * Turns the routing state owned by {@code protocol} into {@code plan} over rtnetlink, with a few writes instead of an
+     * {@code ip} process per step. Routes and rules are tagged with {@code protocol}, so those that are not in the plan
+     * anymore are removed, and an empty plan removes everything. If a change fails, the applied ones are rolled back.
+     * Rules need Linux 4.17 to be tagged. Linux only.
+     *
+     * @param protocol 5 to 255, distinct from other route daemons, e.g. the kernel's RTPROT_* numbers.
+     * @param dryRun only compute the changes.
+     * @return the changes, deletions first.
+     */
+    @NotNull
+    public static List<RouteEntry> applyRoutes(
+            @NotNull final List<RouteEntry> plan,
+            final int protocol,
+            final boolean dryRun
+    ) throws IOException {
+        if (protocol <= 4 || protocol > 255) {
+            throw new IllegalArgumentException("Invalid protocol " + protocol);
+        }
+
+        return RouteEntry.decode(nativeApplyRoutes(RouteEntry.encode(plan), protocol, dryRun));
+    }
+
+    @NotNull
+    private native static byte[] nativeReadRoutes(@NotNull final byte[] plan, int protocol) throws IOException;
+
+    @NotNull
+    private native static byte[] nativeApplyRoutes(@NotNull final byte[] plan, int protocol, boolean dryRun) throws IOException;
+
+    /**
+     * One step of a routing plan, or a change or read back state from {@link #applyRoutes} and {@link #readRoutes}.
+     * Interfaces are referred to by index, see {@link java.net.NetworkInterface#getIndex()}; table 0 is main.
+     */
+    public static final class RouteEntry {
+        public static final int KIND_LINK = 1;
+        public static final int KIND_ADDRESS = 2;
+        public static final int KIND_ROUTE = 3;
+        public static final int KIND_RULE = 4;
+
+        public static final int OPERATION_NONE = 0;
+        public static final int OPERATION_ADD = 1;
+        public static final int OPERATION_DELETE = 2;
+
+        public static final int TYPE_UNICAST = 1;
+        public static final int TYPE_LOOKUP = 1;
+        public static final int TYPE_BLACKHOLE = 6;
+        public static final int TYPE_UNREACHABLE = 7;
+        public static final int TYPE_PROHIBIT = 8;
+        public static final int TYPE_THROW = 9;
+
+        private static final int SIZE = 64;
+        private static final int FLAG_INVERT = 1;
+
+        private final int kind;
+        private final int operation;
+        private final boolean ipv6;
+        @Nullable
+        private final InetAddress address;
+        private final int prefixLength;
+        private final int type;
+        private final boolean invert;
+        private final int interfaceIndex;
+        private final int table;
+        private final int priority;
+        private final int fwmark;
+        private final int fwmask;
+        private final int suppressPrefixLength;
+        @Nullable
+        private final InetAddress gateway;
+
+        private RouteEntry(
+                final int kind,
+                final int operation,
+                final boolean ipv6,
+                @Nullable final InetAddress address,
+                final int prefixLength,
+                final int type,
+                final boolean invert,
+                final int interfaceIndex,
+                final int table,
+                final int priority,
+                final int fwmark,
+                final int fwmask,
+                final int suppressPrefixLength,
+                @Nullable final InetAddress gateway
+        ) {
+            this.kind = kind;
+            this.operation = operation;
+            this.ipv6 = ipv6;
+            this.address = address;
+            this.prefixLength = prefixLength;
+            this.type = type;
+            this.invert = invert;
+            this.interfaceIndex = interfaceIndex;
+            this.table = table;
+            this.priority = priority;
+            this.fwmark = fwmark;
+            this.fwmask = fwmask;
+            this.suppressPrefixLength = suppressPrefixLength;
+            this.gateway = gateway;
+        }
+
+        /**
+         * Brings the interface up, it is never taken down again.
+         */
+        @NotNull
+        public static RouteEntry link(final int interfaceIndex) {
+            return new RouteEntry(KIND_LINK, OPERATION_NONE, false, null, 0, 0, false, interfaceIndex, 0, 0, 0, 0, -1, null);
+        }
+
+        @NotNull
+        public static RouteEntry address(final int interfaceIndex, @NotNull final InetAddress address, final int prefixLength) {
+            return new RouteEntry(
+                    KIND_ADDRESS, OPERATION_NONE, isIpv6(address), address, prefixLength,
+                    0, false, interfaceIndex, 0, 0, 0, 0, -1, null
+            );
+        }
+
+        /**
+         * @param gateway next hop, or null for a route straight out of the interface.
+         * @param metric 0 for the kernel default.
+         */
+        @NotNull
+        public static RouteEntry route(
+                @NotNull final InetAddress destination,
+                final int prefixLength,
+                final int interfaceIndex,
+                @Nullable final InetAddress gateway,
+                final int table,
+                final int metric
+        ) {
+            return new RouteEntry(
+                    KIND_ROUTE, OPERATION_NONE, isIpv6(destination), destination, prefixLength,
+                    TYPE_UNICAST, false, interfaceIndex, table, metric, 0, 0, -1, gateway
+            );
+        }
+
+        /**
+         * A route without next hop, e.g. {@link #TYPE_THROW} to fall back to the next rule.
+         */
+        @NotNull
+        public static RouteEntry route(
+                final int type,
+                @NotNull final InetAddress destination,
+                final int prefixLength,
+                final int table,
+                final int metric
+        ) {
+            return new RouteEntry(
+                    KIND_ROUTE, OPERATION_NONE, isIpv6(destination), destination, prefixLength,
+                    type, false, 0, table, metric, 0, 0, -1, null
+            );
+        }
+
+        /**
+         * Looks up {@code table} for packets matching {@code fwmark/fwmask}, or for all packets if both are 0.
+         *
+         * @param invert match packets that do not carry the mark instead.
+         * @param suppressPrefixLength ignore lookup results with this prefix length or shorter, -1 for none.
+         */
+        @NotNull
+        public static RouteEntry rule(
+                final boolean ipv6,
+                final int priority,
+                final int fwmark,
+                final int fwmask,
+                final boolean invert,
+                final int table,
+                final int suppressPrefixLength
+        ) {
+            return new RouteEntry(
+                    KIND_RULE, OPERATION_NONE, ipv6, null, 0,
+                    TYPE_LOOKUP, invert, 0, table, priority, fwmark, fwmask, suppressPrefixLength, null
+            );
+        }
+
+        private static boolean isIpv6(@NotNull final InetAddress address) {
+            return address.getAddress().length == 16;
+        }
+
+        public int getKind() {
+            return kind;
+        }
+
+        public int getOperation() {
+            return operation;
+        }
+
+        public boolean isIpv6() {
+            return ipv6;
+        }
+
+        /**
+         * @return the address, route destination or rule source, or null.
+         */
+        @Nullable
+        public InetAddress getAddress() {
+            return address;
+        }
+
+        public int getPrefixLength() {
+            return prefixLength;
+        }
+
+        public int getType() {
+            return type;
+        }
+
+        public boolean isInvert() {
+            return invert;
+        }
+
+        public int getInterfaceIndex() {
+            return interfaceIndex;
+        }
+
+        public int getTable() {
+            return table;
+        }
+
+        /**
+         * @return the route metric or rule priority.
+         */
+        public int getPriority() {
+            return priority;
+        }
+
+        public int getFwmark() {
+            return fwmark;
+        }
+
+        public int getFwmask() {
+            return fwmask;
+        }
+
+        public int getSuppressPrefixLength() {
+            return suppressPrefixLength;
+        }
+
+        @Nullable
+        public InetAddress getGateway() {
+            return gateway;
+        }
+
+        @NotNull
+        private static byte[] encode(@NotNull final List<RouteEntry> entries) {
+            final ByteBuffer buffer = ByteBuffer.allocate(entries.size() * SIZE).order(ByteOrder.nativeOrder());
+
+            for (final RouteEntry entry : entries) {
+                final int start = buffer.position();
+
+                buffer.put((byte) entry.kind);
+                buffer.put((byte) entry.operation);
+                buffer.put((byte) (entry.ipv6 ? 6 : 4));
+                buffer.put((byte) entry.prefixLength);
+                buffer.put((byte) entry.type);
+                buffer.put((byte) (entry.invert ? FLAG_INVERT : 0));
+                buffer.putShort((short) 0);
+                buffer.putInt(entry.interfaceIndex);
+                buffer.putInt(entry.table);
+                buffer.putInt(entry.priority);
+                buffer.putInt(entry.fwmark);
+                buffer.putInt(entry.fwmask);
+                buffer.putInt(entry.suppressPrefixLength);
+                if (entry.address != null) {
+                    buffer.put(entry.address.getAddress());
+                }
+                buffer.position(start + 48);
+                if (entry.gateway != null) {
+                    buffer.put(entry.gateway.getAddress());
+                }
+                buffer.position(start + SIZE);
+            }
+
+            return buffer.array();
+        }
+
+        @NotNull
+        private static List<RouteEntry> decode(@NotNull final byte[] entries) {
+            final ByteBuffer buffer = ByteBuffer.wrap(entries).order(ByteOrder.nativeOrder());
+            final List<RouteEntry> result = new ArrayList<>(entries.length / SIZE);
+
+            for (int start = 0; start + SIZE <= entries.length; start += SIZE) {
+                final int kind = buffer.get(start) & 0xff;
+                final boolean ipv6 = buffer.get(start + 2) == 6;
+                final int prefixLength = buffer.get(start + 3) & 0xff;
+
+                final InetAddress address = kind != KIND_LINK && (kind != KIND_RULE || prefixLength > 0)
+                        ? readAddress(entries, start + 32, ipv6)
+                        : null;
+                final InetAddress gateway = kind == KIND_ROUTE ? readAddress(entries, start + 48, ipv6) : null;
+
+                result.add(new RouteEntry(
+                        kind,
+                        buffer.get(start + 1) & 0xff,
+                        ipv6,
+                        address,
+                        prefixLength,
+                        buffer.get(start + 4) & 0xff,
+                        (buffer.get(start + 5) & FLAG_INVERT) != 0,
+                        buffer.getInt(start + 8),
+                        buffer.getInt(start + 12),
+                        buffer.getInt(start + 16),
+                        buffer.getInt(start + 20),
+                        buffer.getInt(start + 24),
+                        buffer.getInt(start + 28),
+                        gateway != null && !gateway.isAnyLocalAddress() ? gateway : null
+                ));
+            }
+
+            return result;
+        }
+
+        @NotNull
+        private static InetAddress readAddress(@NotNull final byte[] entries, final int offset, final boolean ipv6) {
+            final byte[] address = new byte[ipv6 ? 16 : 4];
+            System.arraycopy(entries, offset, address, 0, address.length);
+
+            try {
+                return InetAddress.getByAddress(address);
+            } catch (final UnknownHostException e) {
+                throw new IllegalStateException(e); // only thrown for bad lengths
+            }
+        }
+    }
+}
@@ -0,0 +1,147 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+
+import java.io.Closeable;
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.lang.ref.Cleaner;
+import java.net.InetSocketAddress;
+import java.nio.file.Path;
+import java.util.List;
+import java.util.Map;
+import java.util.Objects;
+
+public final class SocketCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    private static final int LISTEN_FDS_START = 3;
+
+    /**
+     * Binds and listens in this process, so the socket outlives every core it is passed to and
+     * connections wait in the kernel accept queue while the core restarts. Linux only.
+     *
+     * @param name reported to the core through {@code LISTEN_FDNAMES}.
+     * @param address numeric address, port 0 picks a free port.
+     * @param backlog non-positive uses the system maximum.
+     */
+    @NotNull
+    public static ListeningSocket createListeningSocket(
+            @NotNull final String name,
+            @NotNull final InetSocketAddress address,
+            final int backlog
+    ) throws IOException {
+        Objects.requireNonNull(name);
+
+        if (address.isUnresolved()) {
+            throw new IllegalArgumentException("Unresolved address " + address);
+        }
+
+        final FileDescriptor fd = new FileDescriptor();
+        final int port = nativeCreateListeningSocket(address.getAddress().getHostAddress(), address.getPort(), backlog, fd);
+
+        return new ListeningSocket(name, fd, port);
+    }
+
+    /**
+     * Binds a unix socket at {@code path} with mode 0600, replacing a stale socket file. Pass it to the core
+     * with {@link #activateSockets} to serve its external controller on, then read the controller through
+     * {@link ControllerCompat#openControllerStream} without a TCP port or a Java HTTP client. Linux only.
+     *
+     * @param backlog non-positive uses the system maximum.
+     * @return a socket whose port is -1.
+     */
+    @NotNull
+    public static ListeningSocket createListeningSocket(
+            @NotNull final String name,
+            @NotNull final Path path,
+            final int backlog
+    ) throws IOException {
+        Objects.requireNonNull(name);
+
+        final FileDescriptor fd = new FileDescriptor();
+        nativeCreateUnixListeningSocket(path.toAbsolutePath().toString(), backlog, fd);
+
+        return new ListeningSocket(name, fd, -1);
+    }
+
+    /**
+     * Passes {@code sockets} the way systemd socket activation does: as descriptors 3, 4, ... with
+     * {@code LISTEN_FDS} and {@code LISTEN_FDNAMES}. {@code LISTEN_PID} is filled in natively with the pid of each child.
+     */
+    public static void activateSockets(
+            @NotNull final List<ListeningSocket> sockets,
+            @NotNull final Map<Integer, FileDescriptor> inheritedFds,
+            @NotNull final Map<String, String> environments
+    ) {
+        final StringBuilder names = new StringBuilder();
+
+        for (int i = 0; i < sockets.size(); i++) {
+            final ListeningSocket socket = sockets.get(i);
+
+            inheritedFds.put(LISTEN_FDS_START + i, socket.fd);
+
+            if (i > 0) {
+                names.append(':');
+            }
+            names.append(socket.name);
+        }
+
+        environments.put("LISTEN_FDS", Integer.toString(sockets.size()));
+        environments.put("LISTEN_FDNAMES", names.toString());
+    }
+
+    private native static int nativeCreateListeningSocket(
+            @NotNull final String host,
+            int port,
+            int backlog,
+            @NotNull final FileDescriptor fd // Out
+    ) throws IOException;
+
+    private native static void nativeCreateUnixListeningSocket(
+            @NotNull final String path,
+            int backlog,
+            @NotNull final FileDescriptor fd // Out
+    ) throws IOException;
+
+    public static final class ListeningSocket implements AutoCloseable, Closeable {
+        @NotNull
+        private final String name;
+        @NotNull
+        private final FileDescriptor fd;
+        private final int port;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+
+        private ListeningSocket(@NotNull final String name, @NotNull final FileDescriptor fd, final int port) {
+            this.name = name;
+            this.fd = fd;
+            this.port = port;
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> ProcessCompat.releaseFileDescriptor(fd));
+        }
+
+        @NotNull
+        public String getName() {
+            return name;
+        }
+
+        @NotNull
+        public FileDescriptor getFileDescriptor() {
+            return fd;
+        }
+
+        public int getPort() {
+            return port;
+        }
+
+        /**
+         * Stops listening once no core holds the socket anymore.
+         */
+        @Override
+        public void close() {
+            cleanable.clean();
+        }
+    }
+}
@@ -0,0 +1,243 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+import org.jetbrains.annotations.Nullable;
+
+import java.io.Closeable;
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.lang.ref.Cleaner;
+import java.nio.file.Path;
+import java.time.Duration;
+import java.util.List;
+import java.util.Map;
+import java.util.Objects;
+import java.util.concurrent.CompletableFuture;
+
+public final class SupervisorCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    /**
+     * Keeps the command running from native code: abnormal exits are restarted with exponential
+     * backoff until {@code supervision} sees a crash loop, and every transition is reported to {@code listener}.
+     * Cores are bound to the JVM on Linux: each runs in its own process group and is killed when the JVM dies,
+     * its descendants are not. Whatever is left in the group is killed when an incarnation exits or is stopped.
+     *
+     * @param logTarget receives the output of every incarnation, a {@link ProcessCompat.LogSink} or {@link ProcessCompat.LogRing}, or null to discard it.
+     */
+    @NotNull
+    public static Supervisor superviseProcess(
+            @NotNull final Path executablePath,
+            @NotNull final List<String> arguments,
+            @Nullable final Path workingDir,
+            @Nullable final Map<String, String> environments,
+            @Nullable final Map<Integer, FileDescriptor> inheritedFds,
+            @Nullable final ProcessCompat.Placement placement,
+            @NotNull final Supervision supervision,
+            @Nullable final ProcessCompat.LogTarget logTarget,
+            @NotNull final Supervisor.Listener listener
+    ) throws IOException {
+        Objects.requireNonNull(supervision);
+        Objects.requireNonNull(listener);
+
+        final long prepared = ProcessCompat.prepareBound(executablePath, arguments, workingDir, environments, inheritedFds, placement);
+
+        final long[] policy = new long[]{
+                supervision.initialBackoff.toMillis(),
+                supervision.maxBackoff.toMillis(),
+                supervision.stableUptime.toMillis(),
+                supervision.crashLoopCount,
+                supervision.crashLoopWindow.toMillis(),
+                supervision.stopGrace.toMillis(),
+        };
+
+        final Supervisor.Events events = new Supervisor.Events(listener);
+
+        final long supervisor;
+        if (logTarget instanceof ProcessCompat.LogSink) {
+            final ProcessCompat.LogSink sink = (ProcessCompat.LogSink) logTarget;
+
+            supervisor = nativeSuperviseProcess(
+                    prepared, policy, sink.getPath().toAbsolutePath().toString(), sink.getMaxBytes(), sink.getMaxFiles(), 0, events
+            );
+        } else if (logTarget instanceof ProcessCompat.LogRing) {
+            final ProcessCompat.LogRing ring = (ProcessCompat.LogRing) logTarget;
+
+            synchronized (ring) {
+                ring.ensureOpen();
+
+                supervisor = nativeSuperviseProcess(prepared, policy, null, 0, 0, ring.ring, events);
+            }
+        } else if (logTarget == null) {
+            supervisor = nativeSuperviseProcess(prepared, policy, null, 0, 0, 0, events);
+        } else {
+            ProcessCompat.releasePrepared(prepared);
+
+            throw new IllegalArgumentException("Unsupported log target for supervision: " + logTarget.getClass().getSimpleName());
+        }
+
+        return new Supervisor(supervisor, events);
+    }
+
+    private native static long nativeSuperviseProcess(
+            long prepared,
+            @NotNull final long[] policy,
+            @Nullable final String sinkPath,
+            long sinkMaxBytes,
+            int sinkMaxFiles,
+            long ring,
+            @NotNull final NativeSupervisorListener listener
+    );
+
+    private native static void nativeStopSupervisor(long supervisor);
+
+    private native static void nativeReleaseSupervisor(long supervisor);
+
+    private interface NativeSupervisorListener {
+        void onEvent(int event, long value, long delayMillis);
+    }
+
+    /**
+     * Restart policy of {@link #superviseProcess}.
+     */
+    public static final class Supervision {
+        @NotNull
+        private Duration initialBackoff = Duration.ofMillis(500);
+        @NotNull
+        private Duration maxBackoff = Duration.ofSeconds(30);
+        @NotNull
+        private Duration stableUptime = Duration.ofMinutes(1);
+        private int crashLoopCount = 5;
+        @NotNull
+        private Duration crashLoopWindow = Duration.ofMinutes(1);
+        @NotNull
+        private Duration stopGrace = Duration.ofSeconds(5);
+
+        /**
+         * Delay before the first restart, doubled after each consecutive failure up to {@code max}.
+         */
+        @NotNull
+        public Supervision setBackoff(@NotNull final Duration initial, @NotNull final Duration max) {
+            this.initialBackoff = Objects.requireNonNull(initial);
+            this.maxBackoff = Objects.requireNonNull(max);
+            return this;
+        }
+
+        /**
+         * Uptime after which a core counts as healthy and the backoff starts over.
+         */
+        @NotNull
+        public Supervision setStableUptime(@NotNull final Duration stableUptime) {
+            this.stableUptime = Objects.requireNonNull(stableUptime);
+            return this;
+        }
+
+        /**
+         * Gives up restarting once {@code count} abnormal exits happen within {@code window}.
+         * A non-positive count never gives up.
+         */
+        @NotNull
+        public Supervision setCrashLoop(final int count, @NotNull final Duration window) {
+            this.crashLoopCount = count;
+            this.crashLoopWindow = Objects.requireNonNull(window);
+            return this;
+        }
+
+        @NotNull
+        public Supervision setStopGrace(@NotNull final Duration stopGrace) {
+            this.stopGrace = Objects.requireNonNull(stopGrace);
+            return this;
+        }
+    }
+
+    public static final class Supervisor implements AutoCloseable, Closeable {
+        public enum Event {
+            /** value: restarts so far */
+            STARTED,
+            /** value: exit status */
+            EXITED,
+            /** value: consecutive failures, delay: backoff before the next start */
+            RESTART_SCHEDULED,
+            /** value: abnormal exits within the window. Final, nothing is restarted anymore. */
+            CRASH_LOOP,
+            /** value: last exit status. Final. */
+            STOPPED,
+            /** value: errno or GetLastError(). Counts as an abnormal exit. */
+            SPAWN_FAILED,
+        }
+
+        /**
+         * Called on the native supervisor thread, keep it short.
+         */
+        public interface Listener {
+            void onEvent(@NotNull Event event, long value, @NotNull Duration delay);
+        }
+
+        private final long supervisor;
+        @NotNull
+        private final Events events;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+
+        private boolean closed = false;
+
+        private Supervisor(final long supervisor, @NotNull final Events events) {
+            this.supervisor = supervisor;
+            this.events = events;
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> nativeReleaseSupervisor(supervisor));
+        }
+
+        /**
+         * Stops the current incarnation with SIGTERM, escalating after the stop grace, and restarts nothing.
+         *
+         * @return completes with the final event.
+         */
+        @NotNull
+        public synchronized CompletableFuture<Event> stop() {
+            if (!closed) {
+                nativeStopSupervisor(supervisor);
+            }
+
+            return events.done;
+        }
+
+        @NotNull
+        public CompletableFuture<Event> onDone() {
+            return events.done;
+        }
+
+        @Override
+        public synchronized void close() {
+            closed = true;
+
+            cleanable.clean();
+        }
+
+        private static final class Events implements NativeSupervisorListener {
+            private static final Event[] EVENTS = Event.values();
+
+            @NotNull
+            private final Listener listener;
+            private final CompletableFuture<Event> done = new CompletableFuture<>();
+
+            private Events(@NotNull final Listener listener) {
+                this.listener = listener;
+            }
+
+            @Override
+            public void onEvent(final int event, final long value, final long delayMillis) {
+                final Event e = EVENTS[event];
+
+                try {
+                    listener.onEvent(e, value, Duration.ofMillis(delayMillis));
+                } finally {
+                    if (e == Event.STOPPED || e == Event.CRASH_LOOP) {
+                        done.complete(e);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,132 @@
+package com.github.kr328.clash.compat;
+
+import org.jetbrains.annotations.NotNull;
+import org.jetbrains.annotations.Nullable;
+
+import java.io.Closeable;
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.lang.ref.Cleaner;
+import java.util.List;
+import java.util.Map;
+
+public final class TunCompat {
+    static {
+        CompatLibrary.load();
+    }
+
+    /**
+     * Creates a TUN interface with one descriptor per queue, so that the core can read and write packets
+     * on as many threads. Needs CAP_NET_ADMIN, which an unprivileged user and network namespace grants.
+     * Linux only.
+     * <p>
+     * With {@code offload}, every packet read or written starts with a 10 byte virtio_net_hdr and the
+     * kernel hands over GSO super-packets of up to 64 KiB; the core has to be configured for that, see
+     * {@link TunDevice#getOffloads()}.
+     *
+     * @param name interface name, or null to let the kernel pick one.
+     * @param queues 1 to 256, more than one creates a multi-queue interface.
+     * @param mtu 0 keeps the default.
+     */
+    @NotNull
+    public static TunDevice createTunDevice(
+            @Nullable final String name,
+            final int queues,
+            final boolean offload,
+            final int mtu
+    ) throws IOException {
+        if (queues < 1) {
+            throw new IllegalArgumentException("Invalid queue count " + queues);
+        }
+
+        final FileDescriptor[] fds = new FileDescriptor[queues];
+        for (int i = 0; i < queues; i++) {
+            fds[i] = new FileDescriptor();
+        }
+
+        final int[] offloads = new int[1];
+        final String created = nativeCreateTunDevice(name, queues, offload, mtu, fds, offloads);
+
+        return new TunDevice(created, fds, offloads[0]);
+    }
+
+    /**
+     * Passes the queues of {@code tun} to the child as descriptors {@code firstFd}, {@code firstFd + 1}, ...
+     * Leave room for {@link SocketCompat#activateSockets} when both are used.
+     */
+    public static void passQueues(
+            @NotNull final TunDevice tun,
+            final int firstFd,
+            @NotNull final Map<Integer, FileDescriptor> inheritedFds
+    ) {
+        final List<FileDescriptor> queues = tun.getQueues();
+
+        for (int i = 0; i < queues.size(); i++) {
+            inheritedFds.put(firstFd + i, queues.get(i));
+        }
+    }
+
+    @NotNull
+    private native static String nativeCreateTunDevice(
+            @Nullable final String name,
+            int queues,
+            boolean offload,
+            int mtu,
+            @NotNull final FileDescriptor[] fds, // Out
+            @NotNull final int[] offloads        // Out
+    ) throws IOException;
+
+    public static final class TunDevice implements AutoCloseable, Closeable {
+        public static final int OFFLOAD_CSUM = 0x01;
+        public static final int OFFLOAD_TSO4 = 0x02;
+        public static final int OFFLOAD_TSO6 = 0x04;
+        public static final int OFFLOAD_TSO_ECN = 0x08;
+        public static final int OFFLOAD_USO4 = 0x20;
+        public static final int OFFLOAD_USO6 = 0x40;
+
+        @NotNull
+        private final String name;
+        @NotNull
+        private final List<FileDescriptor> queues;
+        private final int offloads;
+        @NotNull
+        private final Cleaner.Cleanable cleanable;
+
+        private TunDevice(@NotNull final String name, @NotNull final FileDescriptor[] queues, final int offloads) {
+            this.name = name;
+            this.queues = List.of(queues);
+            this.offloads = offloads;
+            this.cleanable = CompatLibrary.cleaner.register(this, () -> {
+                for (final FileDescriptor fd : queues) {
+                    ProcessCompat.releaseFileDescriptor(fd);
+                }
+            });
+        }
+
+        @NotNull
+        public String getName() {
+            return name;
+        }
+
+        @NotNull
+        public List<FileDescriptor> getQueues() {
+            return queues;
+        }
+
+        /**
+         * @return OFFLOAD_* the kernel accepted, 0 without offload. Packets carry a virtio_net_hdr whenever
+         * offload was requested, even if this is 0.
+         */
+        public int getOffloads() {
+            return offloads;
+        }
+
+        /**
+         * The interface disappears once no core holds a queue anymore.
+         */
+        @Override
+        public void close() {
+            cleanable.clean();
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#define MIN_CAPACITY (64 * 1024)
+#define MAX_CAPACITY (64 * 1024 * 1024)
+
+namespace batch {
+    void reserve(Batch &batch, size_t capacity) {
+        batch.capacity = std::clamp<size_t>(capacity, MIN_CAPACITY, MAX_CAPACITY);
+        batch.records.reserve(batch.capacity);
+    }
+
+    char *append(Batch &batch, size_t size) {
+        if (batch.records.size() + size > batch.capacity) {
+            batch.dropped++;
+
+            return nullptr;
+        }
+
+        size_t offset = batch.records.size();
+        batch.records.resize(offset + size);
+
+        return batch.records.data() + offset;
+    }
+
+    size_t drain(Batch &batch, void *buffer, size_t capacity, uint64_t *dropped) {
+        size_t length = 0;
+        while (length < batch.records.size()) {
+            uint32_t size;
+            memcpy(&size, batch.records.data() + length, sizeof(size));
+
+            if (length + size > capacity) {
+                break;
+            }
+
+            length += size;
+        }
+
+        memcpy(buffer, batch.records.data(), length);
+        batch.records.erase(batch.records.begin(), batch.records.begin() + static_cast<ptrdiff_t>(length));
+
+        *dropped = batch.dropped;
+        batch.dropped = 0;
+
+        return length;
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace batch {
+    // Records queued until Java drains them. Each record starts with its uint32_t size, padded to 8 bytes.
+    // Not synchronized, the owner guards it with its own lock.
+    struct Batch {
+        std::vector<char> records;
+        size_t capacity = 0;
+        uint64_t dropped = 0;
+    };
+
+    // Clamps capacity to the supported range and reserves it up front.
+    void reserve(Batch &batch, size_t capacity);
+    // Room for a record of size bytes, or nullptr if it would exceed the capacity, counted as dropped.
+    char *append(Batch &batch, size_t size);
+    // Moves whole records into buffer while they fit into capacity, returns the bytes moved. Records
+    // dropped since the last call are counted in dropped.
+    size_t drain(Batch &batch, void *buffer, size_t capacity, uint64_t *dropped);
+}
@@ -0,0 +1,870 @@
+#include "controller.hpp"
+
+#include "batch.hpp"
+#include "jniutils.hpp"
+#include "logparse.hpp"
+#include "os.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#define MAX_HEADERS_SIZE (16 * 1024)
+#define MAX_DOCUMENT_SIZE (16 * 1024 * 1024)
+#define MAX_JSON_DEPTH 64
+
+namespace controller {
+    struct State {
+        std::mutex lock;
+        batch::Batch batch;
+        bool stopping = false;
+        intptr_t connection = -1;
+        std::condition_variable wakeup;
+    };
+
+    struct Reader {
+        std::shared_ptr<State> state;
+    };
+
+    static int64_t now() {
+        auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count();
+    }
+
+    static void append(State &state, Kind kind, const void *body, size_t length) {
+        size_t size = (sizeof(Header) + length + 7) & ~static_cast<size_t>(7);
+
+        std::lock_guard<std::mutex> guard{state.lock};
+
+        char *out = batch::append(state.batch, size);
+        if (out == nullptr) {
+            return;
+        }
+
+        Header header{
+                .size = static_cast<uint32_t>(size),
+                .kind = kind,
+                .reserved = 0,
+                .timeNanos = now(),
+        };
+
+        memcpy(out, &header, sizeof(header));
+        memcpy(out + sizeof(header), body, length);
+    }
+
+    void report(State &state, int64_t code) {
+        Error error{code};
+
+        append(state, KIND_ERROR, &error, sizeof(error));
+    }
+
+    // Just enough JSON for the controller documents: unknown members are skipped, numbers are integers.
+    class Json {
+    public:
+        Json(const char *p, const char *end) : p(p), end(end) {}
+
+    public:
+        bool ok = true;
+
+    public:
+        bool object(const std::function<void(const char *key, size_t keyLength)> &member) {
+            if (!consume('{')) {
+                return false;
+            }
+
+            if (consume('}')) {
+                return true;
+            }
+
+            do {
+                std::string key;
+                if (!string(&key) || !consume(':')) {
+                    return fail();
+                }
+
+                member(key.data(), key.size());
+                if (!ok) {
+                    return false;
+                }
+            } while (consume(','));
+
+            return consume('}') || fail();
+        }
+
+        bool array(const std::function<void()> &element) {
+            if (!consume('[')) {
+                return false;
+            }
+
+            if (consume(']')) {
+                return true;
+            }
+
+            do {
+                element();
+                if (!ok) {
+                    return false;
+                }
+            } while (consume(','));
+
+            return consume(']') || fail();
+        }
+
+        bool string(std::string *out) {
+            if (!consume('"')) {
+                return false;
+            }
+
+            out->clear();
+
+            while (p < end && *p != '"') {
+                if (*p != '\\') {
+                    out->push_back(*p++);
+
+                    continue;
+                }
+
+                if (++p >= end) {
+                    return fail();
+                }
+
+                switch (*p++) {
+                    case 'b':
+                        out->push_back('\b');
+                        break;
+                    case 'f':
+                        out->push_back('\f');
+                        break;
+                    case 'n':
+                        out->push_back('\n');
+                        break;
+                    case 'r':
+                        out->push_back('\r');
+                        break;
+                    case 't':
+                        out->push_back('\t');
+                        break;
+                    case 'u': {
+                        uint32_t c = 0;
+                        if (!hex(&c)) {
+                            return fail();
+                        }
+
+                        // a surrogate pair spells one code point
+                        if (c >= 0xD800 && c < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                            p += 2;
+
+                            uint32_t low = 0;
+                            if (!hex(&low)) {
+                                return fail();
+                            }
+
+                            c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                        }
+
+                        utf8(out, c);
+                        break;
+                    }
+                    default:
+                        out->push_back(p[-1]);
+                        break;
+                }
+            }
+
+            return consume('"') || fail();
+        }
+
+        bool number(int64_t *out) {
+            skipSpaces();
+
+            bool negative = p < end && *p == '-';
+            if (negative) {
+                p++;
+            }
+
+            if (p >= end || *p < '0' || *p > '9') {
+                return fail();
+            }
+
+            int64_t value = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; p++) {
+                value = value <= (INT64_MAX - 9) / 10 ? value * 10 + (*p - '0') : INT64_MAX;
+            }
+
+            // counters are integers, anything finer is cut off
+            while (p < end && (*p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-' || (*p >= '0' && *p <= '9'))) {
+                p++;
+            }
+
+            *out = negative ? -value : value;
+
+            return true;
+        }
+
+        // A number, or a string holding one, as some versions report ports.
+        bool integer(int64_t *out) {
+            skipSpaces();
+
+            if (p < end && *p == '"') {
+                std::string s;
+                if (!string(&s)) {
+                    return false;
+                }
+
+                Json inner{s.data(), s.data() + s.size()};
+
+                return inner.number(out) || (*out = 0, true);
+            }
+
+            return number(out);
+        }
+
+        bool skip() {
+            return skip(0);
+        }
+
+    private:
+        const char *p;
+        const char *end;
+
+    private:
+        bool fail() {
+            ok = false;
+
+            return false;
+        }
+
+        void skipSpaces() {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+                p++;
+            }
+        }
+
+        bool consume(char c) {
+            skipSpaces();
+
+            if (p < end && *p == c) {
+                p++;
+
+                return true;
+            }
+
+            return false;
+        }
+
+        bool hex(uint32_t *out) {
+            if (end - p < 4) {
+                return false;
+            }
+
+            for (int i = 0; i < 4; i++, p++) {
+                char c = *p;
+                uint32_t digit;
+                if (c >= '0' && c <= '9') {
+                    digit = c - '0';
+                } else if (c >= 'a' && c <= 'f') {
+                    digit = c - 'a' + 10;
+                } else if (c >= 'A' && c <= 'F') {
+                    digit = c - 'A' + 10;
+                } else {
+                    return false;
+                }
+
+                *out = *out * 16 + digit;
+            }
+
+            return true;
+        }
+
+        static void utf8(std::string *out, uint32_t c) {
+            if (c < 0x80) {
+                out->push_back(static_cast<char>(c));
+            } else if (c < 0x800) {
+                out->push_back(static_cast<char>(0xC0 | (c >> 6)));
+                out->push_back(static_cast<char>(0x80 | (c & 0x3F)));
+            } else if (c < 0x10000) {
+                out->push_back(static_cast<char>(0xE0 | (c >> 12)));
+                out->push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+                out->push_back(static_cast<char>(0x80 | (c & 0x3F)));
+            } else {
+                out->push_back(static_cast<char>(0xF0 | (c >> 18)));
+                out->push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+                out->push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+                out->push_back(static_cast<char>(0x80 | (c & 0x3F)));
+            }
+        }
+
+        bool skip(int depth) {
+            if (depth > MAX_JSON_DEPTH) {
+                return fail();
+            }
+
+            skipSpaces();
+            if (p >= end) {
+                return fail();
+            }
+
+            switch (*p) {
+                case '{':
+                    return object([this, depth](const char *, size_t) { skip(depth + 1); });
+                case '[':
+                    return array([this, depth]() { skip(depth + 1); });
+                case '"': {
+                    std::string ignored;
+                    return string(&ignored);
+                }
+                case 't':
+                case 'f':
+                case 'n':
+                    while (p < end && *p >= 'a' && *p <= 'z') {
+                        p++;
+                    }
+                    return true;
+                default: {
+                    int64_t ignored;
+                    return number(&ignored);
+                }
+            }
+        }
+    };
+
+    static bool keyIs(const char *key, size_t length, const char *literal) {
+        return length == strlen(literal) && memcmp(key, literal, length) == 0;
+    }
+
+    static void decodeTraffic(State &state, const char *data, size_t length) {
+        Traffic traffic{0, 0};
+
+        Json json{data, data + length};
+        json.object([&](const char *key, size_t keyLength) {
+            if (keyIs(key, keyLength, "up")) {
+                json.number(&traffic.up);
+            } else if (keyIs(key, keyLength, "down")) {
+                json.number(&traffic.down);
+            } else {
+                json.skip();
+            }
+        });
+
+        if (json.ok) {
+            append(state, KIND_TRAFFIC, &traffic, sizeof(traffic));
+        }
+    }
+
+    struct DecodedConnection {
+        Connection entry;
+        std::string id;
+        std::string host;
+        std::string destinationIp;
+        std::string rule;
+        std::string chain;
+    };
+
+    static void decodeConnection(Json &json, DecodedConnection *c) {
+        memset(&c->entry, 0, sizeof(c->entry));
+        c->entry.startNanos = INT64_MIN;
+
+        json.object([&](const char *key, size_t keyLength) {
+            if (keyIs(key, keyLength, "id")) {
+                json.string(&c->id);
+            } else if (keyIs(key, keyLength, "upload")) {
+                json.number(&c->entry.upload);
+            } else if (keyIs(key, keyLength, "download")) {
+                json.number(&c->entry.download);
+            } else if (keyIs(key, keyLength, "start")) {
+                std::string start;
+                if (json.string(&start)) {
+                    c->entry.startNanos = logparse::parseTime(start.data(), start.size());
+                }
+            } else if (keyIs(key, keyLength, "rule")) {
+                json.string(&c->rule);
+            } else if (keyIs(key, keyLength, "chains")) {
+                // ordered from the final outbound back to the first group
+                bool first = true;
+                json.array([&]() {
+                    if (first) {
+                        json.string(&c->chain);
+                        first = false;
+                    } else {
+                        json.skip();
+                    }
+                });
+            } else if (keyIs(key, keyLength, "metadata")) {
+                json.object([&](const char *metaKey, size_t metaKeyLength) {
+                    if (keyIs(metaKey, metaKeyLength, "host")) {
+                        json.string(&c->host);
+                    } else if (keyIs(metaKey, metaKeyLength, "destinationIP")) {
+                        json.string(&c->destinationIp);
+                    } else if (keyIs(metaKey, metaKeyLength, "destinationPort")) {
+                        int64_t port = 0;
+                        json.integer(&port);
+                        c->entry.destinationPort = static_cast<uint16_t>(std::clamp<int64_t>(port, 0, UINT16_MAX));
+                    } else if (keyIs(metaKey, metaKeyLength, "network")) {
+                        std::string network;
+                        json.string(&network);
+                        c->entry.network = network == "tcp" ? NETWORK_TCP : network == "udp" ? NETWORK_UDP : NETWORK_UNKNOWN;
+                    } else {
+                        json.skip();
+                    }
+                });
+            } else {
+                json.skip();
+            }
+        });
+    }
+
+    static void decodeConnections(State &state, const char *data, size_t length) {
+        Connections header{0, 0, -1, 0, 0};
+        std::vector<DecodedConnection> connections;
+
+        Json json{data, data + length};
+        json.object([&](const char *key, size_t keyLength) {
+            if (keyIs(key, keyLength, "uploadTotal")) {
+                json.number(&header.uploadTotal);
+            } else if (keyIs(key, keyLength, "downloadTotal")) {
+                json.number(&header.downloadTotal);
+            } else if (keyIs(key, keyLength, "memory")) {
+                json.number(&header.memory);
+            } else if (keyIs(key, keyLength, "connections")) {
+                json.array([&]() {
+                    connections.emplace_back();
+                    decodeConnection(json, &connections.back());
+                }) || json.skip(); // null without connections
+            } else {
+                json.skip();
+            }
+        });
+
+        if (!json.ok) {
+            return;
+        }
+
+        header.count = static_cast<uint32_t>(connections.size());
+
+        size_t stringsOffset = sizeof(Header) + sizeof(Connections) + connections.size() * sizeof(Connection);
+        size_t stringsSize = 0;
+        for (const auto &c: connections) {
+            stringsSize += c.id.size() + c.host.size() + c.destinationIp.size() + c.rule.size() + c.chain.size();
+        }
+
+        std::vector<char> body(sizeof(Connections) + connections.size() * sizeof(Connection) + stringsSize);
+        memcpy(body.data(), &header, sizeof(header));
+
+        char *entries = body.data() + sizeof(Connections);
+        size_t cursor = stringsOffset;
+        auto store = [&](const std::string &s) {
+            size_t length = std::min<size_t>(s.size(), UINT16_MAX);
+            memcpy(body.data() + cursor - sizeof(Header), s.data(), length);
+
+            String ref{static_cast<uint32_t>(cursor), static_cast<uint16_t>(length), 0};
+            cursor += length;
+
+            return ref;
+        };
+
+        for (size_t i = 0; i < connections.size(); i++) {
+            DecodedConnection &c = connections[i];
+
+            c.entry.id = store(c.id);
+            c.entry.host = store(c.host);
+            c.entry.destinationIp = store(c.destinationIp);
+            c.entry.rule = store(c.rule);
+            c.entry.chain = store(c.chain);
+
+            memcpy(entries + i * sizeof(Connection), &c.entry, sizeof(Connection));
+        }
+
+        append(state, KIND_CONNECTIONS, body.data(), cursor - sizeof(Header));
+    }
+
+    Decoder::Decoder(State &state, Stream stream) : state(state), stream(stream) {
+    }
+
+    void Decoder::reset() {
+        phase = PHASE_HEADERS;
+        pending.clear();
+        line.clear();
+        code = 0;
+        chunked = false;
+        keepAlive = true;
+        remaining = -1;
+    }
+
+    static std::string lowercase(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), [](char c) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        });
+
+        return s;
+    }
+
+    // name and value in lowercase, value is searched for as a token of a list
+    static bool headerIs(const std::string &header, const char *name, const char *value) {
+        size_t nameLength = strlen(name);
+        if (header.size() < nameLength + 1 || header[nameLength] != ':' || lowercase(header.substr(0, nameLength)) != name) {
+            return false;
+        }
+
+        return value == nullptr || lowercase(header.substr(nameLength + 1)).find(value) != std::string::npos;
+    }
+
+    bool Decoder::parseHeaders() {
+        size_t lineEnd = pending.find("\r\n");
+        if (pending.compare(0, 5, "HTTP/") != 0 || lineEnd == std::string::npos) {
+            return false;
+        }
+
+        size_t space = pending.find(' ');
+        code = space < lineEnd ? atoi(pending.data() + space + 1) : 0;
+        keepAlive = pending.compare(0, 8, "HTTP/1.0") != 0;
+
+        for (size_t start = lineEnd + 2; start < pending.size();) {
+            size_t next = pending.find("\r\n", start);
+            if (next == std::string::npos || next == start) {
+                break;
+            }
+
+            std::string header = pending.substr(start, next - start);
+            if (headerIs(header, "transfer-encoding", "chunked")) {
+                chunked = true;
+            } else if (headerIs(header, "content-length", nullptr)) {
+                remaining = strtoll(header.data() + strlen("Content-Length:"), nullptr, 10);
+            } else if (headerIs(header, "connection", "close")) {
+                keepAlive = false;
+            }
+
+            start = next + 2;
+        }
+
+        return code == 200;
+    }
+
+    void Decoder::document(const char *data, size_t length) {
+        while (length > 0 && (data[length - 1] == '\r' || data[length - 1] == ' ')) {
+            length--;
+        }
+        if (length == 0) {
+            return;
+        }
+
+        if (stream == STREAM_TRAFFIC) {
+            decodeTraffic(state, data, length);
+        } else {
+            decodeConnections(state, data, length);
+        }
+    }
+
+    // Documents are separated by newlines, the last one of a response may end with the body.
+    void Decoder::body(const char *data, size_t length) {
+        const char *p = data;
+        const char *end = data + length;
+
+        while (p < end) {
+            auto newline = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (newline == nullptr) {
+                if (line.size() + (end - p) <= MAX_DOCUMENT_SIZE) {
+                    line.append(p, end - p);
+                }
+
+                return;
+            }
+
+            if (line.empty()) {
+                document(p, newline - p);
+            } else {
+                line.append(p, newline - p);
+                document(line.data(), line.size());
+                line.clear();
+            }
+
+            p = newline + 1;
+        }
+    }
+
+    Decoder::Result Decoder::ended() {
+        if (!line.empty()) {
+            document(line.data(), line.size());
+        }
+
+        bool close = !keepAlive;
+        reset();
+
+        return close ? RESULT_CLOSE : RESULT_COMPLETE;
+    }
+
+    Decoder::Result Decoder::feed(const char *data, size_t length) {
+        const char *p = data;
+        const char *end = data + length;
+
+        while (p < end) {
+            switch (phase) {
+                case PHASE_HEADERS: {
+                    size_t scanFrom = pending.size() >= 3 ? pending.size() - 3 : 0;
+                    pending.append(p, end - p);
+                    p = end;
+
+                    size_t headersEnd = pending.find("\r\n\r\n", scanFrom);
+                    if (headersEnd == std::string::npos) {
+                        if (pending.size() > MAX_HEADERS_SIZE) {
+                            return RESULT_FAILED;
+                        }
+
+                        continue;
+                    }
+
+                    std::string rest = pending.substr(headersEnd + 4);
+                    pending.resize(headersEnd + 2);
+
+                    if (!parseHeaders()) {
+                        return RESULT_FAILED;
+                    }
+
+                    pending.clear();
+                    phase = chunked ? PHASE_CHUNK_SIZE : PHASE_BODY;
+
+                    if (!chunked && remaining == 0) {
+                        return ended();
+                    }
+
+                    // responses do not overlap, the next one is only requested after this one
+                    return rest.empty() ? RESULT_MORE : feed(rest.data(), rest.size());
+                }
+                case PHASE_CHUNK_SIZE:
+                case PHASE_CHUNK_END:
+                case PHASE_TRAILERS: {
+                    auto newline = static_cast<const char *>(memchr(p, '\n', end - p));
+                    if (newline == nullptr) {
+                        pending.append(p, end - p);
+                        if (pending.size() > MAX_HEADERS_SIZE) {
+                            return RESULT_FAILED;
+                        }
+
+                        p = end;
+
+                        continue;
+                    }
+
+                    pending.append(p, newline - p);
+                    p = newline + 1;
+
+                    if (phase == PHASE_CHUNK_SIZE) {
+                        char *parsed = nullptr;
+                        remaining = strtoll(pending.data(), &parsed, 16);
+                        if (parsed == pending.data() || remaining < 0) {
+                            return RESULT_FAILED;
+                        }
+
+                        phase = remaining == 0 ? PHASE_TRAILERS : PHASE_CHUNK_DATA;
+                    } else if (phase == PHASE_CHUNK_END) {
+                        phase = PHASE_CHUNK_SIZE;
+                    } else if (pending.empty() || pending == "\r") {
+                        pending.clear();
+
+                        return ended();
+                    }
+
+                    pending.clear();
+
+                    break;
+                }
+                case PHASE_CHUNK_DATA: {
+                    size_t n = static_cast<size_t>(std::min<int64_t>(remaining, end - p));
+                    body(p, n);
+
+                    p += n;
+                    remaining -= static_cast<int64_t>(n);
+
+                    if (remaining == 0) {
+                        phase = PHASE_CHUNK_END;
+                    }
+
+                    break;
+                }
+                case PHASE_BODY: {
+                    size_t n = remaining < 0 ? end - p : static_cast<size_t>(std::min<int64_t>(remaining, end - p));
+                    body(p, n);
+
+                    p += n;
+                    if (remaining > 0) {
+                        remaining -= static_cast<int64_t>(n);
+
+                        if (remaining == 0) {
+                            return ended();
+                        }
+                    }
+
+                    break;
+                }
+            }
+        }
+
+        return RESULT_MORE;
+    }
+
+    Decoder::Result Decoder::finish() {
+        // only a body delimited by the end of the connection may end here
+        if (phase == PHASE_BODY && remaining < 0) {
+            keepAlive = false;
+
+            return ended();
+        }
+
+        return RESULT_FAILED;
+    }
+
+    Reader *create(size_t capacity) {
+        auto state = std::make_shared<State>();
+        batch::reserve(state->batch, capacity);
+
+        return new Reader{state};
+    }
+
+    std::shared_ptr<State> share(Reader *reader) {
+        return reader->state;
+    }
+
+    bool track(State &state, intptr_t connection) {
+        std::lock_guard<std::mutex> guard{state.lock};
+
+        state.connection = state.stopping ? -1 : connection;
+
+        return !state.stopping;
+    }
+
+    bool pause(State &state, int64_t millis) {
+        std::unique_lock<std::mutex> guard{state.lock};
+
+        state.wakeup.wait_for(guard, std::chrono::milliseconds(millis), [&state]() { return state.stopping; });
+
+        return !state.stopping;
+    }
+
+    size_t drain(Reader *reader, void *buffer, size_t capacity, uint64_t *dropped) {
+        State &state = *reader->state;
+
+        std::lock_guard<std::mutex> guard{state.lock};
+
+        return batch::drain(state.batch, buffer, capacity, dropped);
+    }
+
+    void stop(Reader *reader, const std::function<void(intptr_t connection)> &interrupt) {
+        {
+            State &state = *reader->state;
+
+            std::lock_guard<std::mutex> guard{state.lock};
+
+            state.stopping = true;
+            state.wakeup.notify_all();
+
+            // under the lock, so that the transport cannot close the connection meanwhile
+            if (state.connection != -1) {
+                interrupt(state.connection);
+            }
+        }
+
+        delete reader;
+    }
+
+    static jlong jniOpenControllerStream(
+            JNIEnv *env,
+            jclass clazz,
+            jstring socketPath,
+            jint stream,
+            jstring secret,
+            jlong intervalMillis,
+            jint capacity
+    ) {
+        Request request{
+                jniutils::getString(env, socketPath),
+                static_cast<Stream>(stream),
+                secret != nullptr ? jniutils::getString(env, secret) : std::string(),
+                static_cast<int64_t>(intervalMillis),
+                static_cast<size_t>(std::max(capacity, 0)),
+        };
+
+        Reader *reader = open(request);
+        if (reader == nullptr) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return 0;
+        }
+
+        return reinterpret_cast<jlong>(reader);
+    }
+
+    static jint jniDrainControllerStream(
+            JNIEnv *env,
+            jclass clazz,
+            jlong reader,
+            jobject buffer,
+            jint position,
+            jint limit,
+            jlongArray dropped
+    ) {
+        auto base = static_cast<char *>(env->GetDirectBufferAddress(buffer));
+        jlong capacity = env->GetDirectBufferCapacity(buffer);
+
+        if (base == nullptr || position < 0 || limit < position || limit > capacity) {
+            env->ThrowNew(env->FindClass("java/lang/IllegalArgumentException"), "Invalid buffer range");
+
+            return 0;
+        }
+
+        uint64_t cDropped = 0;
+        size_t length = drain(
+                reinterpret_cast<Reader *>(reader),
+                base + position,
+                static_cast<size_t>(limit - position),
+                &cDropped
+        );
+
+        jlong jDropped = static_cast<jlong>(cDropped);
+        env->SetLongArrayRegion(dropped, 0, 1, &jDropped);
+
+        return static_cast<jint>(length);
+    }
+
+    static void jniReleaseControllerStream(JNIEnv *env, jclass clazz, jlong reader) {
+        release(reinterpret_cast<Reader *>(reader));
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cController = env->FindClass("com/github/kr328/clash/compat/ControllerCompat");
+        if (cController == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeOpenControllerStream"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;ILjava/lang/String;JI)J"),
+                        .fnPtr = reinterpret_cast<void *>(&jniOpenControllerStream),
+                },
+                {
+                        .name = const_cast<char *>("nativeDrainControllerStream"),
+                        .signature = const_cast<char *>("(JLjava/nio/ByteBuffer;II[J)I"),
+                        .fnPtr = reinterpret_cast<void *>(&jniDrainControllerStream),
+                },
+                {
+                        .name = const_cast<char *>("nativeReleaseControllerStream"),
+                        .signature = const_cast<char *>("(J)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniReleaseControllerStream),
+                },
+        };
+
+        if (env->RegisterNatives(cController, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <jni.h>
+
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace controller {
+    enum Stream {
+        STREAM_TRAFFIC = 1,     // GET /traffic, one document per second
+        STREAM_CONNECTIONS = 2, // GET /connections, requested again every interval
+    };
+
+    enum Kind : uint16_t {
+        KIND_ERROR = 0,
+        KIND_TRAFFIC = 1,
+        KIND_CONNECTIONS = 2,
+    };
+
+    // A batch is a sequence of records, each starting with this header. String offsets are relative to
+    // the record, strings are UTF-8 without terminator.
+    struct Header {
+        uint32_t size;     // whole record, padded to 8 bytes
+        uint16_t kind;
+        uint16_t reserved;
+        int64_t timeNanos; // receive time, nanoseconds since the epoch
+    };
+
+    struct Error {         // the stream broke and is being reopened
+        int64_t code;      // HTTP status, or a negative errno
+    };
+
+    struct Traffic {
+        int64_t up;        // bytes per second
+        int64_t down;
+    };
+
+    struct Connections {
+        int64_t uploadTotal;
+        int64_t downloadTotal;
+        int64_t memory;    // -1 if not reported
+        uint32_t count;    // followed by this many Connection entries, then their strings
+        uint32_t reserved;
+    };
+
+    struct String {
+        uint32_t offset;
+        uint16_t length;
+        uint16_t reserved;
+    };
+
+    struct Connection {
+        int64_t upload;
+        int64_t download;
+        int64_t startNanos; // INT64_MIN if not reported
+        uint16_t destinationPort;
+        uint8_t network;    // NETWORK_*
+        uint8_t reserved[5];
+        String id;
+        String host;
+        String destinationIp;
+        String rule;
+        String chain;       // the outbound the connection finally went through
+    };
+
+    static const uint8_t NETWORK_UNKNOWN = 0;
+    static const uint8_t NETWORK_TCP = 1;
+    static const uint8_t NETWORK_UDP = 2;
+
+    static_assert(sizeof(Header) == 16, "record layout is shared with Java");
+    static_assert(sizeof(Connections) == 32, "record layout is shared with Java");
+    static_assert(sizeof(Connection) == 72, "record layout is shared with Java");
+
+    struct Request {
+        std::string socketPath;     // unix socket the core serves its controller on
+        Stream stream;
+        std::string secret;         // sent as bearer token, empty for none
+        int64_t intervalMillis;     // between requests of non-streaming endpoints, and between reconnects
+        size_t capacity;            // bytes of records held until the next drain
+    };
+
+    struct Reader;
+
+    bool initialize(JNIEnv *env);
+
+    // Keeps the stream open in the background, reconnecting until released.
+    Reader *open(const Request &request);
+    // Moves as many whole records as fit, returns the bytes written. Records that did not fit
+    // into the batch since the last call are counted in dropped.
+    size_t drain(Reader *reader, void *buffer, size_t capacity, uint64_t *dropped);
+    void release(Reader *reader);
+
+    // Shared with the platform transports.
+    struct State;
+
+    Reader *create(size_t capacity);
+    std::shared_ptr<State> share(Reader *reader);
+    // Registers the connection that stop has to interrupt, -1 for none. False once stopping.
+    bool track(State &state, intptr_t connection);
+    // Waits for millis, false if stopped meanwhile.
+    bool pause(State &state, int64_t millis);
+    // Marks the reader stopping and frees it, interrupt runs with the tracked connection unless that is -1.
+    void stop(Reader *reader, const std::function<void(intptr_t connection)> &interrupt);
+
+    // Decodes one HTTP response at a time from the bytes read off the connection.
+    class Decoder {
+    public:
+        enum Result {
+            RESULT_MORE,     // need more bytes
+            RESULT_COMPLETE, // the response ended, the connection may carry the next one
+            RESULT_CLOSE,    // the response ended, the server closes the connection
+            RESULT_FAILED,   // malformed or not 200, see status
+        };
+
+    public:
+        Decoder(State &state, Stream stream);
+
+    public:
+        Result feed(const char *data, size_t length);
+        Result finish(); // the connection reached EOF
+        int status() const { return code; }
+        void reset();
+
+    private:
+        enum Phase {
+            PHASE_HEADERS,
+            PHASE_CHUNK_SIZE,
+            PHASE_CHUNK_DATA,
+            PHASE_CHUNK_END,
+            PHASE_TRAILERS,
+            PHASE_BODY,
+        };
+
+    private:
+        bool parseHeaders();
+        void body(const char *data, size_t length);
+        void document(const char *data, size_t length);
+        Result ended();
+
+    private:
+        State &state;
+        Stream stream;
+        Phase phase = PHASE_HEADERS;
+        std::string pending;   // headers or a chunk size line
+        std::string line;      // the unterminated tail of the body
+        int code = 0;
+        bool chunked = false;
+        bool keepAlive = true;
+        int64_t remaining = -1; // body or chunk bytes left, -1 until EOF
+    };
+
+    // Records that the stream broke, see Error.
+    void report(State &state, int64_t code);
+}
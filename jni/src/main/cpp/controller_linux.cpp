@@ -0,0 +1,143 @@
+#include "controller.hpp"
+
+#include <thread>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#define READ_BUFFER_SIZE (64 * 1024)
+#define MIN_RETRY_MILLIS 100
+
+namespace controller {
+    static int connectTo(const std::string &path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            errno = ENAMETOOLONG;
+
+            return -1;
+        }
+
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.data(), path.size());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            int err = errno;
+            close(fd);
+            errno = err;
+
+            return -1;
+        }
+
+        return fd;
+    }
+
+    static bool sendAll(int fd, const std::string &data) {
+        for (size_t sent = 0; sent < data.size();) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0) {
+                return false;
+            }
+
+            sent += n;
+        }
+
+        return true;
+    }
+
+    // Serves requests on one connection until it breaks, returns the HTTP status or a negative errno.
+    static int64_t serve(State &state, int fd, const Request &request, const std::string &message) {
+        Decoder decoder{state, request.stream};
+        std::unique_ptr<char[]> buffer{new char[READ_BUFFER_SIZE]};
+
+        while (true) {
+            if (!sendAll(fd, message)) {
+                return -errno;
+            }
+
+            Decoder::Result result = Decoder::RESULT_MORE;
+            while (result == Decoder::RESULT_MORE) {
+                ssize_t n = recv(fd, buffer.get(), READ_BUFFER_SIZE, 0);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                } else if (n < 0) {
+                    return -errno;
+                }
+
+                result = n == 0 ? decoder.finish() : decoder.feed(buffer.get(), n);
+            }
+
+            if (result == Decoder::RESULT_FAILED) {
+                return decoder.status() != 200 && decoder.status() != 0 ? decoder.status() : -EPROTO;
+            }
+
+            // a streaming endpoint never gets here, a snapshot is requested again after the interval
+            if (!pause(state, request.intervalMillis)) {
+                return 0;
+            }
+
+            if (result == Decoder::RESULT_CLOSE) {
+                return 200;
+            }
+        }
+    }
+
+    static void run(const std::shared_ptr<State> &state, const Request &request) {
+        std::string message = std::string("GET ") + (request.stream == STREAM_TRAFFIC ? "/traffic" : "/connections") +
+                              " HTTP/1.1\r\nHost: controller\r\n";
+        if (!request.secret.empty()) {
+            message += "Authorization: Bearer " + request.secret + "\r\n";
+        }
+        message += "\r\n";
+
+        int64_t retryMillis = std::max<int64_t>(request.intervalMillis, MIN_RETRY_MILLIS);
+
+        while (true) {
+            int fd = connectTo(request.socketPath);
+            if (fd >= 0 && !track(*state, fd)) {
+                close(fd);
+
+                return;
+            }
+
+            int64_t code = fd >= 0 ? serve(*state, fd, request, message) : -errno;
+
+            if (fd >= 0) {
+                track(*state, -1);
+                close(fd);
+            }
+
+            // a connection closed after a complete snapshot is no failure
+            if (code != 200 && code != 0) {
+                report(*state, code);
+            }
+
+            if (!pause(*state, code == 200 ? 0 : retryMillis)) {
+                return;
+            }
+        }
+    }
+
+    Reader *open(const Request &request) {
+        Reader *reader = create(request.capacity);
+
+        std::thread{run, share(reader), request}.detach();
+
+        return reader;
+    }
+
+    void release(Reader *reader) {
+        stop(reader, [](intptr_t connection) {
+            shutdown(static_cast<int>(connection), SHUT_RDWR);
+        });
+    }
+}
@@ -0,0 +1,18 @@
+#include "controller.hpp"
+
+#include <windows.h>
+
+namespace controller {
+    Reader *open(const Request &request) {
+        // the controller socket is handed over through socket activation, which cores on Windows lack
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return nullptr;
+    }
+
+    void release(Reader *reader) {
+        stop(reader, [](intptr_t connection) {});
+
+        delete reader;
+    }
+}
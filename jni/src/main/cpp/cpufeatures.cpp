@@ -0,0 +1,167 @@
+#include "cpufeatures.hpp"
+
+#include "jniutils.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace cpufeatures {
+#if defined(__x86_64__) || defined(__i386__)
+    static bool has(unsigned int value, unsigned int mask) {
+        return (value & mask) == mask;
+    }
+
+    // Register states the OS saves on context switches, CPUID bits alone do not make AVX usable.
+    static uint64_t enabledStates() {
+        unsigned int low, high;
+        __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+
+        return (static_cast<uint64_t>(high) << 32) | low;
+    }
+
+    static Info probeCpuid() {
+        Info info{LEVEL_BASELINE, 0};
+
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            return info;
+        }
+        unsigned int ecx1 = ecx;
+
+        unsigned int ebx7 = 0, ecx7 = 0;
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx7, ecx7, edx);
+        }
+
+        unsigned int ecxExtended = 0;
+        if (__get_cpuid(0x80000001, &eax, &ebx, &ecxExtended, &edx) == 0) {
+            ecxExtended = 0;
+        }
+
+        uint64_t states = has(ecx1, bit_OSXSAVE) ? enabledStates() : 0;
+        bool avxStates = (states & 0x06) == 0x06;    // XMM, YMM
+        bool avx512States = (states & 0xe6) == 0xe6; // and opmask, ZMM
+
+        bool v2 = has(ecx1, bit_SSE3 | bit_SSSE3 | bit_SSE4_1 | bit_SSE4_2 | bit_POPCNT | bit_CMPXCHG16B) &&
+                  has(ecxExtended, bit_LAHF_LM);
+        bool v3 = v2 && avxStates &&
+                  has(ecx1, bit_AVX | bit_F16C | bit_FMA | bit_MOVBE) &&
+                  has(ebx7, bit_AVX2 | bit_BMI | bit_BMI2) &&
+                  has(ecxExtended, bit_LZCNT);
+        bool v4 = v3 && avx512States &&
+                  has(ebx7, bit_AVX512F | bit_AVX512BW | bit_AVX512CD | bit_AVX512DQ | bit_AVX512VL);
+
+        info.level = v4 ? LEVEL_V4 : v3 ? LEVEL_V3 : v2 ? LEVEL_V2 : LEVEL_BASELINE;
+
+        if (has(ecx1, bit_AES)) {
+            info.features |= FEATURE_AES;
+        }
+        if (has(ecx1, bit_PCLMUL)) {
+            info.features |= FEATURE_CLMUL;
+        }
+        if (has(ebx7, bit_SHA)) {
+            info.features |= FEATURE_SHA;
+        }
+        if (avxStates && has(ebx7, bit_AVX2)) {
+            info.features |= FEATURE_AVX2;
+        }
+        if (avx512States && has(ebx7, bit_AVX512F)) {
+            info.features |= FEATURE_AVX512;
+        }
+        if (avxStates && has(ecx7, bit_VAES | bit_VPCLMULQDQ)) {
+            info.features |= FEATURE_VAES;
+        }
+        if (has(ecx1, bit_SSE4_2)) {
+            info.features |= FEATURE_CRC32;
+        }
+
+        return info;
+    }
+#endif
+
+    Info probe() {
+#if defined(__x86_64__) || defined(__i386__)
+        Info info = probeCpuid();
+#else
+        Info info{LEVEL_BASELINE, 0};
+#endif
+
+        info.features |= probeSystem();
+
+        return info;
+    }
+
+    int select(const std::vector<std::string> &paths, const std::vector<int> &levels) {
+        int host = probe().level;
+
+        int selected = -1;
+        for (size_t i = 0; i < paths.size() && i < levels.size(); i++) {
+            if (levels[i] > host || (selected >= 0 && levels[i] <= levels[selected])) {
+                continue;
+            }
+
+            if (executable(paths[i])) {
+                selected = static_cast<int>(i);
+            }
+        }
+
+        return selected;
+    }
+
+    static void jniProbeCpuFeatures(JNIEnv *env, jclass clazz, jlongArray values) {
+        Info info = probe();
+
+        const jlong cValues[] = {
+                static_cast<jlong>(info.level),
+                static_cast<jlong>(info.features),
+        };
+
+        env->SetLongArrayRegion(values, 0, sizeof(cValues) / sizeof(*cValues), cValues);
+    }
+
+    static jint jniSelectExecutable(JNIEnv *env, jclass clazz, jobjectArray paths, jintArray levels) {
+        std::vector<std::string> cPaths;
+        std::for_each(jniutils::begin(env, paths), jniutils::end(env, paths), [&](jobject p) {
+            cPaths.push_back(jniutils::getString(env, reinterpret_cast<jstring>(p)));
+        });
+
+        std::vector<int> cLevels(env->GetArrayLength(levels));
+        env->GetIntArrayRegion(levels, 0, static_cast<jsize>(cLevels.size()), reinterpret_cast<jint *>(cLevels.data()));
+
+        int selected = select(cPaths, cLevels);
+        if (selected < 0) {
+            env->ThrowNew(env->FindClass("java/io/IOException"), "No candidate executable runs on this CPU");
+        }
+
+        return selected;
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cCpu = env->FindClass("com/github/kr328/clash/compat/CpuCompat");
+        if (cCpu == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeProbeCpuFeatures"),
+                        .signature = const_cast<char *>("([J)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniProbeCpuFeatures),
+                },
+                {
+                        .name = const_cast<char *>("nativeSelectExecutable"),
+                        .signature = const_cast<char *>("([Ljava/lang/String;[I)I"),
+                        .fnPtr = reinterpret_cast<void *>(&jniSelectExecutable),
+                },
+        };
+
+        if (env->RegisterNatives(cCpu, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <jni.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace cpufeatures {
+    // x86-64 microarchitecture levels, as in GOAMD64 and -march=x86-64-vN. Everything else is baseline.
+    enum Level {
+        LEVEL_BASELINE = 1,
+        LEVEL_V2 = 2, // SSE4.2, POPCNT, CMPXCHG16B
+        LEVEL_V3 = 3, // AVX2, BMI2, FMA, MOVBE
+        LEVEL_V4 = 4, // AVX-512 F/BW/CD/DQ/VL
+    };
+
+    // Extensions proxy cores care about, mostly for their TLS and AEAD ciphers.
+    static const uint64_t FEATURE_AES = 1u << 0;        // AES-NI, ARMv8 AES
+    static const uint64_t FEATURE_CLMUL = 1u << 1;      // PCLMULQDQ, ARMv8 PMULL, for GCM
+    static const uint64_t FEATURE_SHA = 1u << 2;        // SHA-NI, ARMv8 SHA1 and SHA2
+    static const uint64_t FEATURE_AVX2 = 1u << 3;
+    static const uint64_t FEATURE_AVX512 = 1u << 4;     // AVX-512 F, enabled by the OS
+    static const uint64_t FEATURE_VAES = 1u << 5;       // VAES and VPCLMULQDQ
+    static const uint64_t FEATURE_ATOMICS = 1u << 6;    // ARMv8.1 LSE
+    static const uint64_t FEATURE_CRC32 = 1u << 7;      // SSE4.2, ARMv8 CRC32
+
+    struct Info {
+        Level level;
+        uint64_t features; // FEATURE_*
+    };
+
+    bool initialize(JNIEnv *env);
+
+    // What this CPU supports and the OS has enabled.
+    Info probe();
+
+    // Index of the candidate requiring the highest level the host supports that is present and
+    // executable, the first on ties, or -1 if none is.
+    int select(const std::vector<std::string> &paths, const std::vector<int> &levels);
+
+    // Platform part: extensions only the OS reports, and whether path can be launched.
+    uint64_t probeSystem();
+    bool executable(const std::string &path);
+}
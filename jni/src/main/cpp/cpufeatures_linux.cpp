@@ -0,0 +1,40 @@
+#include "cpufeatures.hpp"
+
+#include <unistd.h>
+#include <sys/auxv.h>
+
+#if defined(__aarch64__)
+#include <asm/hwcap.h>
+#endif
+
+namespace cpufeatures {
+    uint64_t probeSystem() {
+        uint64_t features = 0;
+
+#if defined(__aarch64__)
+        unsigned long hwcap = getauxval(AT_HWCAP);
+
+        if ((hwcap & HWCAP_AES) != 0) {
+            features |= FEATURE_AES;
+        }
+        if ((hwcap & HWCAP_PMULL) != 0) {
+            features |= FEATURE_CLMUL;
+        }
+        if ((hwcap & (HWCAP_SHA1 | HWCAP_SHA2)) == (HWCAP_SHA1 | HWCAP_SHA2)) {
+            features |= FEATURE_SHA;
+        }
+        if ((hwcap & HWCAP_ATOMICS) != 0) {
+            features |= FEATURE_ATOMICS;
+        }
+        if ((hwcap & HWCAP_CRC32) != 0) {
+            features |= FEATURE_CRC32;
+        }
+#endif
+
+        return features;
+    }
+
+    bool executable(const std::string &path) {
+        return access(path.data(), X_OK) == 0;
+    }
+}
@@ -0,0 +1,29 @@
+#include "cpufeatures.hpp"
+
+#include <windows.h>
+
+namespace cpufeatures {
+    uint64_t probeSystem() {
+        uint64_t features = 0;
+
+#if defined(__aarch64__)
+        if (IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE)) {
+            features |= FEATURE_AES | FEATURE_CLMUL | FEATURE_SHA;
+        }
+        if (IsProcessorFeaturePresent(PF_ARM_V81_ATOMIC_INSTRUCTIONS_AVAILABLE)) {
+            features |= FEATURE_ATOMICS;
+        }
+        if (IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE)) {
+            features |= FEATURE_CRC32;
+        }
+#endif
+
+        return features;
+    }
+
+    bool executable(const std::string &path) {
+        DWORD attributes = GetFileAttributesA(path.data());
+
+        return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+    }
+}
@@ -0,0 +1,426 @@
+#include "logparse.hpp"
+
+#include "batch.hpp"
+#include "os.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <mutex>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace logparse {
+    struct State {
+        std::mutex lock;
+        batch::Batch batch;
+    };
+
+    struct Parser {
+        std::shared_ptr<State> state;
+    };
+
+    // First of a or b in [p, end), or end. Sixteen bytes per step where SSE2 is available.
+    static const char *findEither(const char *p, const char *end, char a, char b) {
+#if defined(__SSE2__)
+        const __m128i va = _mm_set1_epi8(a);
+        const __m128i vb = _mm_set1_epi8(b);
+
+        for (; end - p >= 16; p += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)));
+            if (mask != 0) {
+                return p + __builtin_ctz(static_cast<unsigned int>(mask));
+            }
+        }
+#endif
+
+        for (; p < end; p++) {
+            if (*p == a || *p == b) {
+                return p;
+            }
+        }
+
+        return end;
+    }
+
+    static bool equals(const char *p, size_t length, const char *literal) {
+        return length == strlen(literal) && memcmp(p, literal, length) == 0;
+    }
+
+    static Level parseLevel(const char *p, size_t length) {
+        if (equals(p, length, "info")) {
+            return LEVEL_INFO;
+        } else if (equals(p, length, "debug")) {
+            return LEVEL_DEBUG;
+        } else if (equals(p, length, "warning") || equals(p, length, "warn")) {
+            return LEVEL_WARNING;
+        } else if (equals(p, length, "error")) {
+            return LEVEL_ERROR;
+        } else if (equals(p, length, "trace")) {
+            return LEVEL_TRACE;
+        } else if (equals(p, length, "fatal") || equals(p, length, "panic")) {
+            return LEVEL_FATAL;
+        }
+
+        return LEVEL_UNKNOWN;
+    }
+
+    static bool parseDigits(const char *&p, const char *end, int count, int *value) {
+        *value = 0;
+
+        for (int i = 0; i < count; i++, p++) {
+            if (p >= end || *p < '0' || *p > '9') {
+                return false;
+            }
+
+            *value = *value * 10 + (*p - '0');
+        }
+
+        return true;
+    }
+
+    static int64_t daysFromCivil(int year, int month, int day) {
+        year -= month <= 2;
+
+        int64_t era = (year >= 0 ? year : year - 399) / 400;
+        int64_t yearOfEra = year - era * 400;
+        int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+        return era * 146097 + dayOfEra - 719468;
+    }
+
+    // e.g. 2024-05-01T12:00:00.123456789+08:00
+    int64_t parseTime(const char *p, size_t length) {
+        const char *end = p + length;
+        int year, month, day, hour, minute, second;
+
+        bool parsed = parseDigits(p, end, 4, &year) && p < end && *p++ == '-' &&
+                      parseDigits(p, end, 2, &month) && p < end && *p++ == '-' &&
+                      parseDigits(p, end, 2, &day) && p < end && (*p == 'T' || *p == ' ') && ++p &&
+                      parseDigits(p, end, 2, &hour) && p < end && *p++ == ':' &&
+                      parseDigits(p, end, 2, &minute) && p < end && *p++ == ':' &&
+                      parseDigits(p, end, 2, &second);
+        if (!parsed || month < 1 || month > 12) {
+            return INT64_MIN;
+        }
+
+        int64_t nanos = 0;
+        if (p < end && *p == '.') {
+            int64_t scale = 100000000;
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+                nanos += (*p - '0') * scale;
+                scale /= 10;
+            }
+        }
+
+        int64_t offsetSeconds = 0;
+        if (p < end && (*p == '+' || *p == '-')) {
+            int sign = *p++ == '-' ? -1 : 1;
+            int offsetHours, offsetMinutes;
+            if (!parseDigits(p, end, 2, &offsetHours) || p >= end || *p++ != ':' || !parseDigits(p, end, 2, &offsetMinutes)) {
+                return INT64_MIN;
+            }
+
+            offsetSeconds = sign * (offsetHours * 3600 + offsetMinutes * 60);
+        } else if (p >= end || (*p != 'Z' && *p != 'z')) {
+            return INT64_MIN;
+        }
+
+        int64_t seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offsetSeconds;
+
+        return seconds * 1000000000 + nanos;
+    }
+
+    // Must be called with the lock held.
+    static void parseLine(State &state, const char *line, size_t length) {
+        if (length > 0 && line[length - 1] == '\r') {
+            length--;
+        }
+        length = std::min(length, MAX_LINE_LENGTH);
+
+        const char *end = line + length;
+
+        Field fields[MAX_FIELDS];
+        size_t fieldCount = 0;
+
+        Record record{};
+        record.timeNanos = INT64_MIN;
+        record.level = LEVEL_UNKNOWN;
+        record.messageOffset = 0;
+        record.messageLength = static_cast<uint32_t>(length);
+
+        for (const char *p = line; p < end && fieldCount < MAX_FIELDS;) {
+            if (*p == ' ') {
+                p++;
+
+                continue;
+            }
+
+            const char *key = p;
+            const char *separator = findEither(p, end, '=', ' ');
+            if (separator == end || *separator != '=' || separator == key || separator - key > UINT16_MAX) {
+                if (fieldCount == 0) {
+                    break; // not key=value, keep the line as a plain message
+                }
+
+                p = findEither(key, end, ' ', ' '); // a stray word between fields, which may start with '='
+                continue;
+            }
+
+            Field &field = fields[fieldCount++];
+            field.keyOffset = static_cast<uint32_t>(key - line);
+            field.keyLength = static_cast<uint16_t>(separator - key);
+            field.flags = 0;
+
+            p = separator + 1;
+            if (p < end && *p == '"') {
+                const char *value = ++p;
+
+                while (true) {
+                    p = findEither(p, end, '"', '\\');
+                    if (p < end && *p == '\\') {
+                        field.flags |= FLAG_ESCAPED;
+                        p = std::min(p + 2, end);
+
+                        continue;
+                    }
+
+                    break;
+                }
+
+                field.valueOffset = static_cast<uint32_t>(value - line);
+                field.valueLength = static_cast<uint32_t>(p - value);
+
+                p = std::min(p + 1, end);
+            } else {
+                const char *value = p;
+                p = findEither(p, end, ' ', ' ');
+
+                field.valueOffset = static_cast<uint32_t>(value - line);
+                field.valueLength = static_cast<uint32_t>(p - value);
+            }
+
+            const char *k = line + field.keyOffset;
+            const char *v = line + field.valueOffset;
+            if (equals(k, field.keyLength, "msg")) {
+                record.messageOffset = field.valueOffset;
+                record.messageLength = field.valueLength;
+                record.flags = field.flags;
+            } else if (equals(k, field.keyLength, "level")) {
+                record.level = parseLevel(v, field.valueLength);
+            } else if (equals(k, field.keyLength, "time")) {
+                record.timeNanos = parseTime(v, field.valueLength);
+            }
+        }
+
+        if (fieldCount == 0) {
+            record.timeNanos = INT64_MIN;
+            record.level = LEVEL_UNKNOWN;
+            record.flags = 0;
+            record.messageOffset = 0;
+            record.messageLength = static_cast<uint32_t>(length);
+        }
+
+        size_t size = sizeof(Record) + fieldCount * sizeof(Field) + length;
+        size = (size + 7) & ~static_cast<size_t>(7);
+
+        char *out = batch::append(state.batch, size);
+        if (out == nullptr) {
+            return;
+        }
+
+        record.size = static_cast<uint32_t>(size);
+        record.textLength = static_cast<uint32_t>(length);
+        record.fieldCount = static_cast<uint16_t>(fieldCount);
+
+        memcpy(out, &record, sizeof(Record));
+        memcpy(out + sizeof(Record), fields, fieldCount * sizeof(Field));
+        memcpy(out + sizeof(Record) + fieldCount * sizeof(Field), line, length);
+    }
+
+    void feed(State &state, std::string &partial, const char *data, size_t length) {
+        std::lock_guard<std::mutex> guard{state.lock};
+
+        const char *p = data;
+        const char *end = data + length;
+
+        if (!partial.empty()) {
+            const char *newline = findEither(p, end, '\n', '\n');
+
+            partial.append(p, std::min<size_t>(newline - p, MAX_LINE_LENGTH - std::min(partial.size(), MAX_LINE_LENGTH)));
+            if (newline == end) {
+                return;
+            }
+
+            parseLine(state, partial.data(), partial.size());
+            partial.clear();
+
+            p = newline + 1;
+        }
+
+        while (p < end) {
+            const char *newline = findEither(p, end, '\n', '\n');
+            if (newline == end) {
+                partial.assign(p, std::min<size_t>(end - p, MAX_LINE_LENGTH));
+
+                break;
+            }
+
+            parseLine(state, p, newline - p);
+
+            p = newline + 1;
+        }
+    }
+
+    Parser *create(size_t capacity) {
+        auto state = std::make_shared<State>();
+        batch::reserve(state->batch, capacity);
+
+        return new Parser{state};
+    }
+
+    std::shared_ptr<State> share(Parser *parser) {
+        return parser->state;
+    }
+
+    size_t drain(Parser *parser, void *buffer, size_t capacity, uint64_t *dropped) {
+        State &state = *parser->state;
+
+        std::lock_guard<std::mutex> guard{state.lock};
+
+        return batch::drain(state.batch, buffer, capacity, dropped);
+    }
+
+    void release(Parser *parser) {
+        delete parser;
+    }
+
+    // Looked up here instead of going through process::, so that logparse_check links without the process module.
+    static jfieldID fFileDescriptorFd;
+    static jfieldID fFileDescriptorHandle;
+
+    static std::vector<process::ResourceHandle> takeHandles(JNIEnv *env, jobjectArray fds) {
+        std::vector<process::ResourceHandle> handles;
+
+        for (jsize i = 0; i < env->GetArrayLength(fds); i++) {
+            jobject fd = env->GetObjectArrayElement(fds, i);
+
+#if defined(__WIN32__)
+            handles.push_back(process::fromJLong(env->GetLongField(fd, fFileDescriptorHandle)));
+            env->SetLongField(fd, fFileDescriptorHandle, -1);
+#elif defined(__linux__)
+            handles.push_back(env->GetIntField(fd, fFileDescriptorFd));
+            env->SetIntField(fd, fFileDescriptorFd, -1);
+#endif
+
+            env->DeleteLocalRef(fd);
+        }
+
+        return handles;
+    }
+
+    static jlong jniCreateLogParser(JNIEnv *env, jclass clazz, jint capacity) {
+        return reinterpret_cast<jlong>(create(static_cast<size_t>(std::max(capacity, 0))));
+    }
+
+    static void jniAttachLogParser(JNIEnv *env, jclass clazz, jlong parser, jobjectArray sources) {
+        if (!attach(reinterpret_cast<Parser *>(parser), takeHandles(env, sources))) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+        }
+    }
+
+    static jint jniDrainLogParser(
+            JNIEnv *env,
+            jclass clazz,
+            jlong parser,
+            jobject buffer,
+            jint position,
+            jint limit,
+            jlongArray dropped
+    ) {
+        auto base = static_cast<char *>(env->GetDirectBufferAddress(buffer));
+        jlong capacity = env->GetDirectBufferCapacity(buffer);
+
+        // a smaller range could stall behind a record that never fits
+        if (base == nullptr || position < 0 || limit < position || limit > capacity ||
+            static_cast<size_t>(limit - position) < MAX_RECORD_SIZE) {
+            env->ThrowNew(env->FindClass("java/lang/IllegalArgumentException"), "Invalid buffer range");
+
+            return 0;
+        }
+
+        uint64_t cDropped = 0;
+        size_t length = drain(
+                reinterpret_cast<Parser *>(parser),
+                base + position,
+                static_cast<size_t>(limit - position),
+                &cDropped
+        );
+
+        jlong jDropped = static_cast<jlong>(cDropped);
+        env->SetLongArrayRegion(dropped, 0, 1, &jDropped);
+
+        return static_cast<jint>(length);
+    }
+
+    static void jniReleaseLogParser(JNIEnv *env, jclass clazz, jlong parser) {
+        release(reinterpret_cast<Parser *>(parser));
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cLogParser = env->FindClass("com/github/kr328/clash/compat/LogParserCompat");
+        if (cLogParser == nullptr) {
+            return false;
+        }
+
+        jclass cFileDescriptor = env->FindClass("java/io/FileDescriptor");
+        if (cFileDescriptor == nullptr) {
+            return false;
+        }
+
+        fFileDescriptorFd = env->GetFieldID(cFileDescriptor, "fd", "I");
+        if (fFileDescriptorFd == nullptr) {
+            return false;
+        }
+
+        fFileDescriptorHandle = env->GetFieldID(cFileDescriptor, "handle", "J");
+        if (fFileDescriptorHandle == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeCreateLogParser"),
+                        .signature = const_cast<char *>("(I)J"),
+                        .fnPtr = reinterpret_cast<void *>(&jniCreateLogParser),
+                },
+                {
+                        .name = const_cast<char *>("nativeAttachLogParser"),
+                        .signature = const_cast<char *>("(J[Ljava/io/FileDescriptor;)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniAttachLogParser),
+                },
+                {
+                        .name = const_cast<char *>("nativeDrainLogParser"),
+                        .signature = const_cast<char *>("(JLjava/nio/ByteBuffer;II[J)I"),
+                        .fnPtr = reinterpret_cast<void *>(&jniDrainLogParser),
+                },
+                {
+                        .name = const_cast<char *>("nativeReleaseLogParser"),
+                        .signature = const_cast<char *>("(J)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniReleaseLogParser),
+                },
+        };
+
+        if (env->RegisterNatives(cLogParser, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
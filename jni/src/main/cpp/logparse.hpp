@@ -0,0 +1,76 @@
+#pragma once
+
+#include <jni.h>
+
+#include "process.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace logparse {
+    enum Level : uint8_t {
+        LEVEL_UNKNOWN = 0,
+        LEVEL_TRACE = 1,
+        LEVEL_DEBUG = 2,
+        LEVEL_INFO = 3,
+        LEVEL_WARNING = 4,
+        LEVEL_ERROR = 5,
+        LEVEL_FATAL = 6,
+    };
+
+    // A batch is a sequence of records, each followed by its fields and then the raw line.
+    // Offsets are relative to the raw line, quoted values exclude their quotes.
+    struct Record {
+        uint32_t size;          // whole record, padded to 8 bytes
+        uint32_t textLength;
+        int64_t timeNanos;      // INT64_MIN without a parsable time field
+        uint8_t level;
+        uint8_t flags;
+        uint16_t fieldCount;
+        uint32_t messageOffset; // the whole line if it is not key=value
+        uint32_t messageLength;
+        uint32_t reserved;
+    };
+
+    struct Field {
+        uint32_t keyOffset;
+        uint16_t keyLength;
+        uint16_t flags;
+        uint32_t valueOffset;
+        uint32_t valueLength;
+    };
+
+    static const uint8_t FLAG_ESCAPED = 1; // the value still contains backslash escapes
+
+    static const size_t MAX_LINE_LENGTH = 16 * 1024; // longer lines are truncated
+    static const size_t MAX_FIELDS = 32;
+    static const size_t MAX_RECORD_SIZE = sizeof(Record) + MAX_FIELDS * sizeof(Field) + MAX_LINE_LENGTH;
+
+    static_assert(sizeof(Record) == 32, "record layout is shared with Java");
+    static_assert(sizeof(Field) == 16, "field layout is shared with Java");
+
+    struct Parser;
+
+    bool initialize(JNIEnv *env);
+
+    Parser *create(size_t capacity);
+    // Takes ownership of the sources, even on failure.
+    bool attach(Parser *parser, const std::vector<process::ResourceHandle> &sources);
+    // Moves as many whole records as fit, returns the bytes written. Records that did not fit
+    // into the batch since the last call are counted in dropped.
+    size_t drain(Parser *parser, void *buffer, size_t capacity, uint64_t *dropped);
+    void release(Parser *parser);
+
+    // RFC 3339 to nanoseconds since the epoch, INT64_MIN if malformed.
+    int64_t parseTime(const char *p, size_t length);
+
+    // Shared with the platform drains.
+    struct State;
+
+    std::shared_ptr<State> share(Parser *parser);
+    // Parses the complete lines, partial keeps the unterminated tail of a source between calls.
+    void feed(State &state, std::string &partial, const char *data, size_t length);
+}
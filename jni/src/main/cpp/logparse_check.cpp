@@ -0,0 +1,202 @@
+// Log parser regression check, runs without a JVM:
+//
+//   logparse_check
+//
+// Feeds known lines through logparse::feed and drains the records, and checks parseTime against known
+// timestamps. Prints every failed expectation and exits non-zero if there was one.
+
+#include "logparse.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace check {
+    struct Parsed {
+        std::string text;
+        std::string message;
+        int64_t timeNanos;
+        uint8_t level;
+        uint8_t flags;
+        std::vector<std::pair<std::string, std::string>> fields;
+    };
+
+    static int failures = 0;
+
+    static void expect(bool condition, const char *what, const std::string &input) {
+        if (!condition) {
+            fprintf(stderr, "FAILED: %s, input \"%s\"\n", what, input.data());
+
+            failures++;
+        }
+    }
+
+    static std::vector<Parsed> decode(const std::vector<char> &batch, size_t length) {
+        std::vector<Parsed> result;
+
+        for (size_t offset = 0; offset < length;) {
+            logparse::Record record{};
+            memcpy(&record, batch.data() + offset, sizeof(record));
+
+            const char *fields = batch.data() + offset + sizeof(record);
+            const char *text = fields + record.fieldCount * sizeof(logparse::Field);
+
+            Parsed parsed{
+                    .text = std::string(text, record.textLength),
+                    .message = std::string(text + record.messageOffset, record.messageLength),
+                    .timeNanos = record.timeNanos,
+                    .level = record.level,
+                    .flags = record.flags,
+                    .fields = {},
+            };
+
+            for (uint16_t i = 0; i < record.fieldCount; i++) {
+                logparse::Field field{};
+                memcpy(&field, fields + i * sizeof(field), sizeof(field));
+
+                parsed.fields.emplace_back(
+                        std::string(text + field.keyOffset, field.keyLength),
+                        std::string(text + field.valueOffset, field.valueLength)
+                );
+            }
+
+            result.push_back(parsed);
+            offset += record.size;
+        }
+
+        return result;
+    }
+
+    // Feeds the chunks as if read one after another from the same source.
+    static std::vector<Parsed> parse(const std::vector<std::string> &chunks) {
+        logparse::Parser *parser = logparse::create(0);
+        std::shared_ptr<logparse::State> state = logparse::share(parser);
+
+        std::string partial;
+        for (const std::string &chunk: chunks) {
+            logparse::feed(*state, partial, chunk.data(), chunk.size());
+        }
+
+        std::vector<char> batch(1024 * 1024);
+        uint64_t dropped = 0;
+        size_t length = logparse::drain(parser, batch.data(), batch.size(), &dropped);
+
+        logparse::release(parser);
+
+        return decode(batch, length);
+    }
+
+    static std::vector<Parsed> parse(const std::string &input) {
+        return parse(std::vector<std::string>{input});
+    }
+
+    static void checkLines() {
+        std::string input = "time=\"2024-01-02T03:04:05.5Z\" level=warning msg=\"dial \\\"x\\\" failed\"\n";
+        auto records = parse(input);
+        expect(records.size() == 1 && records[0].fields.size() == 3, "quoted fields", input);
+        if (records.size() == 1) {
+            expect(records[0].level == logparse::LEVEL_WARNING, "level", input);
+            expect(records[0].timeNanos == 1704164645500000000LL, "time", input);
+            expect(records[0].message == "dial \\\"x\\\" failed", "message", input);
+            expect(records[0].flags & logparse::FLAG_ESCAPED, "escaped message", input);
+        }
+
+        input = "plain output of a core\r\n";
+        records = parse(input);
+        expect(records.size() == 1 && records[0].fields.empty(), "plain line", input);
+        if (records.size() == 1) {
+            expect(records[0].message == "plain output of a core", "plain message without CR", input);
+            expect(records[0].timeNanos == INT64_MIN, "plain line time", input);
+        }
+
+        // stray words between fields, including ones starting with '=', must never stall the parser
+        for (const char *line: {"level=info =oops\n", "level=info == msg=x\n", "level=info stray msg=x\n", "a=1 =\n", "= = =\n"}) {
+            input = line;
+            records = parse(input);
+            expect(records.size() == 1, "stray word", input);
+        }
+
+        input = "level=info =oops msg=hello\n";
+        records = parse(input);
+        expect(records.size() == 1 && records[0].fields.size() == 2 && records[0].message == "hello", "field after stray word", input);
+
+        input = "level=error msg=\"unterminated\n";
+        records = parse(input);
+        expect(records.size() == 1 && records[0].message == "unterminated", "unterminated quote", input);
+
+        records = parse(std::vector<std::string>{"level=de", "bug msg=sp", "lit\nlevel=fatal\n"});
+        expect(records.size() == 2, "line split across reads", "level=de|bug msg=sp|lit");
+        if (records.size() == 2) {
+            expect(records[0].level == logparse::LEVEL_DEBUG && records[0].message == "split", "split line fields", "level=debug msg=split");
+            expect(records[1].level == logparse::LEVEL_FATAL, "line after split", "level=fatal");
+        }
+
+        input = "msg=" + std::string(logparse::MAX_LINE_LENGTH * 2, 'x') + "\n";
+        records = parse(input);
+        expect(records.size() == 1 && records[0].text.size() == logparse::MAX_LINE_LENGTH, "long line truncated", "msg=xxx...");
+
+        input.clear();
+        for (size_t i = 0; i < logparse::MAX_FIELDS + 8; i++) {
+            input += "k" + std::to_string(i) + "=v ";
+        }
+        records = parse(input + "\n");
+        expect(records.size() == 1 && records[0].fields.size() == logparse::MAX_FIELDS, "field limit", "k0=v k1=v ...");
+    }
+
+    static void checkDrain() {
+        logparse::Parser *parser = logparse::create(0);
+        std::shared_ptr<logparse::State> state = logparse::share(parser);
+
+        std::string partial;
+        std::string input = "level=info msg=" + std::string(1000, 'x') + "\n";
+        logparse::feed(*state, partial, input.data(), input.size());
+
+        std::vector<char> buffer(logparse::MAX_RECORD_SIZE);
+        uint64_t dropped = 0;
+        expect(logparse::drain(parser, buffer.data(), 64, &dropped) == 0, "record larger than the range stays queued", input);
+        expect(logparse::drain(parser, buffer.data(), buffer.size(), &dropped) > 0, "range of MAX_RECORD_SIZE fits a record", input);
+        expect(logparse::drain(parser, buffer.data(), buffer.size(), &dropped) == 0, "batch empty after drain", input);
+
+        logparse::release(parser);
+    }
+
+    static void checkTimes() {
+        struct {
+            const char *text;
+            int64_t nanos;
+        } cases[] = {
+                {"1970-01-01T00:00:00Z", 0},
+                {"1970-01-01 00:00:01z", 1000000000LL},
+                {"2000-02-29T12:00:00+01:00", 951822000000000000LL},
+                {"2024-01-02T03:04:05.123456789-00:30", 1704166445123456789LL},
+                {"1969-12-31T23:59:59Z", -1000000000LL},
+                {"2024-13-01T00:00:00Z", INT64_MIN},
+                {"2024-01-02T03:04:05", INT64_MIN},
+                {"2024-01-02T03:04:05+0100", INT64_MIN},
+                {"2024-01-02", INT64_MIN},
+                {"", INT64_MIN},
+        };
+
+        for (const auto &c: cases) {
+            expect(logparse::parseTime(c.text, strlen(c.text)) == c.nanos, "parseTime", c.text);
+        }
+    }
+}
+
+int main() {
+    check::checkLines();
+    check::checkDrain();
+    check::checkTimes();
+
+    if (check::failures > 0) {
+        fprintf(stderr, "%d expectations failed\n", check::failures);
+
+        return 1;
+    }
+
+    printf("logparse: all expectations held\n");
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "logparse.hpp"
+
+#include "looper.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define READ_CHUNK_SIZE (64 * 1024)
+#define DRAIN_LIMIT (1024 * 1024)
+
+namespace logparse {
+    struct Source {
+        int fd;
+        std::string partial;
+    };
+
+    static void drain(State &state, Source &source) {
+        char buffer[READ_CHUNK_SIZE];
+        size_t moved = 0;
+
+        while (moved < DRAIN_LIMIT) {
+            ssize_t n = read(source.fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                feed(state, source.partial, buffer, n);
+                moved += n;
+
+                continue;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && errno == EAGAIN) {
+                return;
+            }
+
+            break;
+        }
+
+        if (moved >= DRAIN_LIMIT) {
+            return;
+        }
+
+        // the last line may come without a newline
+        if (!source.partial.empty()) {
+            feed(state, source.partial, "\n", 1);
+        }
+
+        looper::unwatch(source.fd);
+        close(source.fd);
+    }
+
+    bool attach(Parser *parser, const std::vector<process::ResourceHandle> &sources) {
+        std::shared_ptr<State> state = share(parser);
+        bool success = true;
+
+        for (int fd: sources) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+            auto source = std::make_shared<Source>();
+            source->fd = fd;
+
+            bool watched = success && looper::watch(fd, EPOLLIN, [state, source](uint32_t events) {
+                drain(*state, *source);
+            });
+            if (!watched) {
+                success = false;
+
+                close(fd);
+            }
+        }
+
+        return success;
+    }
+}
@@ -0,0 +1,32 @@
+#include "logparse.hpp"
+
+#include <thread>
+#include <windows.h>
+
+#define PUMP_BUFFER_SIZE (64 * 1024)
+
+namespace logparse {
+    static void pump(const std::shared_ptr<State> &state, HANDLE source) {
+        std::unique_ptr<char[]> buffer{new char[PUMP_BUFFER_SIZE]};
+        std::string partial;
+
+        DWORD n = 0;
+        while (ReadFile(source, buffer.get(), PUMP_BUFFER_SIZE, &n, nullptr) && n > 0) {
+            feed(*state, partial, buffer.get(), n);
+        }
+
+        if (!partial.empty()) {
+            feed(*state, partial, "\n", 1);
+        }
+
+        CloseHandle(source);
+    }
+
+    bool attach(Parser *parser, const std::vector<process::ResourceHandle> &sources) {
+        for (HANDLE source: sources) {
+            std::thread{pump, share(parser), source}.detach();
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "process.hpp"
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace logring {
+    // Shared with Java, which reads it through a direct ByteBuffer.
+    // Bytes in [claimed - capacity, committed) are readable, older bytes have been overwritten.
+    struct Header {
+        std::atomic<uint64_t> committed;
+        std::atomic<uint64_t> claimed;
+        uint64_t capacity;
+        uint64_t reserved[5];
+    };
+
+    static_assert(sizeof(Header) == 64, "header must fill one cache line");
+
+    struct Ring;
+
+    Ring *create(size_t capacity);
+    // Another reference to the same ring, released on its own.
+    Ring *retain(Ring *ring);
+    void *mapping(Ring *ring);
+    size_t mappingSize(Ring *ring);
+    // Takes ownership of the sources, even on failure.
+    bool attach(Ring *ring, const std::vector<process::ResourceHandle> &sources);
+    void release(Ring *ring);
+}
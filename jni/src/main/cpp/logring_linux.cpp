@@ -0,0 +1,141 @@
+#include "logring.hpp"
+
+#include "looper.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+
+#define MIN_CAPACITY 4096
+#define MAX_CAPACITY (64 * 1024 * 1024)
+#define READ_CHUNK_SIZE (64 * 1024)
+#define DRAIN_LIMIT (1024 * 1024)
+
+namespace logring {
+    struct State {
+        void *mapping = MAP_FAILED;
+        size_t size = 0;
+
+        ~State() {
+            if (mapping != MAP_FAILED) {
+                munmap(mapping, size);
+            }
+        }
+
+        Header *header() {
+            return static_cast<Header *>(mapping);
+        }
+
+        char *data() {
+            return static_cast<char *>(mapping) + sizeof(Header);
+        }
+    };
+
+    struct Ring {
+        std::shared_ptr<State> state;
+    };
+
+    static void drain(State &state, int source) {
+        Header *header = state.header();
+        uint64_t capacity = header->capacity;
+        size_t moved = 0;
+
+        while (moved < DRAIN_LIMIT) {
+            uint64_t committed = header->committed.load(std::memory_order_relaxed);
+            size_t offset = committed & (capacity - 1);
+            size_t length = std::min<size_t>(capacity - offset, READ_CHUNK_SIZE);
+
+            // announce the bytes about to be overwritten before touching them
+            uint64_t claimed = header->claimed.load(std::memory_order_relaxed);
+            header->claimed.store(std::max(claimed, committed + length), std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            ssize_t n = read(source, state.data() + offset, length);
+
+            // read() only touched what it returned, give the rest of the claim back
+            header->claimed.store(std::max<uint64_t>(claimed, committed + std::max<ssize_t>(n, 0)), std::memory_order_release);
+
+            if (n > 0) {
+                header->committed.store(committed + n, std::memory_order_release);
+                moved += n;
+
+                continue;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && errno == EAGAIN) {
+                return;
+            }
+
+            break;
+        }
+
+        if (moved >= DRAIN_LIMIT) {
+            return;
+        }
+
+        looper::unwatch(source);
+        close(source);
+    }
+
+    Ring *create(size_t capacity) {
+        capacity = std::clamp<size_t>(capacity, MIN_CAPACITY, MAX_CAPACITY);
+
+        size_t rounded = MIN_CAPACITY;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+
+        auto state = std::make_shared<State>();
+        state->size = sizeof(Header) + rounded;
+        state->mapping = mmap(nullptr, state->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (state->mapping == MAP_FAILED) {
+            return nullptr;
+        }
+
+        state->header()->capacity = rounded;
+
+        return new Ring{
+                .state = state,
+        };
+    }
+
+    void *mapping(Ring *ring) {
+        return ring->state->mapping;
+    }
+
+    size_t mappingSize(Ring *ring) {
+        return ring->state->size;
+    }
+
+    bool attach(Ring *ring, const std::vector<process::ResourceHandle> &sources) {
+        std::shared_ptr<State> state = ring->state;
+        bool success = true;
+
+        for (int source: sources) {
+            fcntl(source, F_SETFL, fcntl(source, F_GETFL) | O_NONBLOCK);
+
+            bool watched = success && looper::watch(source, EPOLLIN, [state, source](uint32_t events) {
+                drain(*state, source);
+            });
+            if (!watched) {
+                success = false;
+
+                close(source);
+            }
+        }
+
+        return success;
+    }
+
+    Ring *retain(Ring *ring) {
+        return new Ring{ring->state};
+    }
+
+    void release(Ring *ring) {
+        delete ring;
+    }
+}
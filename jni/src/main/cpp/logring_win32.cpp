@@ -0,0 +1,118 @@
+#include "logring.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cstring>
+#include <windows.h>
+
+#define MIN_CAPACITY 4096
+#define MAX_CAPACITY (64 * 1024 * 1024)
+#define PUMP_BUFFER_SIZE (64 * 1024)
+
+namespace logring {
+    struct State {
+        std::mutex lock;
+        void *mapping = nullptr;
+        size_t size = 0;
+
+        ~State() {
+            if (mapping != nullptr) {
+                VirtualFree(mapping, 0, MEM_RELEASE);
+            }
+        }
+
+        Header *header() {
+            return static_cast<Header *>(mapping);
+        }
+
+        char *data() {
+            return static_cast<char *>(mapping) + sizeof(Header);
+        }
+    };
+
+    struct Ring {
+        std::shared_ptr<State> state;
+    };
+
+    static void append(State &state, const char *bytes, size_t length) {
+        Header *header = state.header();
+        uint64_t capacity = header->capacity;
+
+        while (length > 0) {
+            uint64_t committed = header->committed.load(std::memory_order_relaxed);
+            size_t offset = committed & (capacity - 1);
+            size_t chunk = std::min<size_t>(capacity - offset, length);
+
+            header->claimed.store(committed + chunk, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            memcpy(state.data() + offset, bytes, chunk);
+
+            header->committed.store(committed + chunk, std::memory_order_release);
+
+            bytes += chunk;
+            length -= chunk;
+        }
+    }
+
+    static void pump(const std::shared_ptr<State> &state, HANDLE source) {
+        std::unique_ptr<char[]> buffer{new char[PUMP_BUFFER_SIZE]};
+
+        DWORD n = 0;
+        while (ReadFile(source, buffer.get(), PUMP_BUFFER_SIZE, &n, nullptr) && n > 0) {
+            std::lock_guard<std::mutex> guard{state->lock};
+
+            append(*state, buffer.get(), n);
+        }
+
+        CloseHandle(source);
+    }
+
+    Ring *create(size_t capacity) {
+        capacity = std::clamp<size_t>(capacity, MIN_CAPACITY, MAX_CAPACITY);
+
+        size_t rounded = MIN_CAPACITY;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+
+        auto state = std::make_shared<State>();
+        state->size = sizeof(Header) + rounded;
+        state->mapping = VirtualAlloc(nullptr, state->size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (state->mapping == nullptr) {
+            return nullptr;
+        }
+
+        state->header()->capacity = rounded;
+
+        return new Ring{
+                .state = state,
+        };
+    }
+
+    void *mapping(Ring *ring) {
+        return ring->state->mapping;
+    }
+
+    size_t mappingSize(Ring *ring) {
+        return ring->state->size;
+    }
+
+    bool attach(Ring *ring, const std::vector<process::ResourceHandle> &sources) {
+        for (HANDLE source: sources) {
+            std::thread{pump, ring->state, source}.detach();
+        }
+
+        return true;
+    }
+
+    Ring *retain(Ring *ring) {
+        return new Ring{ring->state};
+    }
+
+    void release(Ring *ring) {
+        delete ring;
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "process.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace logsink {
+    // Takes ownership of the sources, even on failure.
+    bool attach(
+            const std::string &path,
+            int64_t maxBytes,
+            int maxFiles,
+            const std::vector<process::ResourceHandle> &sources
+    );
+}
@@ -0,0 +1,165 @@
+#include "logsink.hpp"
+
+#include "looper.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define SPLICE_CHUNK_SIZE (64 * 1024)
+#define DRAIN_LIMIT (1024 * 1024)
+#define COPY_BUFFER_SIZE (16 * 1024)
+
+namespace logsink {
+    struct Sink {
+        std::string path;
+        int64_t maxBytes = 0;
+        int maxFiles = 1;
+        int fd = -1;
+        int64_t size = 0;
+        bool copy = false; // the file system cannot splice, read and write instead
+
+        ~Sink() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    };
+
+    static int openLogFile(const std::string &path, int flags) {
+        return open(path.data(), O_WRONLY | O_CREAT | O_CLOEXEC | flags, 0644);
+    }
+
+    static void rotate(Sink &sink) {
+        for (int i = sink.maxFiles - 1; i > 0; i--) {
+            std::string from = i == 1 ? sink.path : sink.path + "." + std::to_string(i - 1);
+            std::string to = sink.path + "." + std::to_string(i);
+
+            rename(from.data(), to.data());
+        }
+
+        int fd = sink.maxFiles > 1 ? openLogFile(sink.path, O_TRUNC) : -1;
+        if (fd < 0) {
+            ftruncate(sink.fd, 0);
+            lseek(sink.fd, 0, SEEK_SET);
+        } else {
+            close(sink.fd);
+            sink.fd = fd;
+        }
+
+        sink.size = 0;
+    }
+
+    static void drain(Sink &sink, int source) {
+        size_t moved = 0;
+
+        while (moved < DRAIN_LIMIT) {
+            size_t length = SPLICE_CHUNK_SIZE;
+            if (sink.maxBytes > 0) {
+                if (sink.size >= sink.maxBytes) {
+                    rotate(sink);
+                }
+
+                length = std::min<size_t>(length, sink.maxBytes - sink.size);
+            }
+
+            if (!sink.copy) {
+                ssize_t n = splice(source, nullptr, sink.fd, nullptr, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n > 0) {
+                    sink.size += n;
+                    moved += n;
+
+                    continue;
+                } else if (n == 0) {
+                    break;
+                } else if (errno == EINTR) {
+                    continue;
+                } else if (errno == EAGAIN) {
+                    return;
+                } else if (errno == EINVAL || errno == ENOSYS) {
+                    sink.copy = true;
+                }
+            }
+
+            char buffer[COPY_BUFFER_SIZE];
+            ssize_t n = read(source, buffer, std::min(length, sizeof(buffer)));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && errno == EAGAIN) {
+                return;
+            } else if (n <= 0) {
+                break;
+            }
+
+            moved += n;
+
+            // a failed write drops the rest of the chunk rather than block the child
+            for (ssize_t written = 0; written < n;) {
+                ssize_t w = write(sink.fd, buffer + written, n - written);
+                if (w > 0) {
+                    written += w;
+                    sink.size += w;
+                } else if (w < 0 && errno == EINTR) {
+                    continue;
+                } else {
+                    break;
+                }
+            }
+        }
+
+        if (moved >= DRAIN_LIMIT) {
+            return;
+        }
+
+        looper::unwatch(source);
+        close(source);
+    }
+
+    bool attach(
+            const std::string &path,
+            int64_t maxBytes,
+            int maxFiles,
+            const std::vector<process::ResourceHandle> &sources
+    ) {
+        int fd = openLogFile(path, 0);
+        if (fd < 0) {
+            int err = errno;
+
+            for (int source: sources) {
+                close(source);
+            }
+
+            errno = err;
+
+            return false;
+        }
+
+        auto sink = std::make_shared<Sink>();
+        sink->path = path;
+        sink->maxBytes = maxBytes;
+        sink->maxFiles = maxFiles;
+        sink->fd = fd;
+        sink->size = std::max<int64_t>(lseek(fd, 0, SEEK_END), 0);
+
+        bool success = true;
+
+        for (int source: sources) {
+            fcntl(source, F_SETFL, fcntl(source, F_GETFL) | O_NONBLOCK);
+
+            bool watched = success && looper::watch(source, EPOLLIN, [sink, source](uint32_t events) {
+                drain(*sink, source);
+            });
+            if (!watched) {
+                success = false;
+
+                close(source);
+            }
+        }
+
+        return success;
+    }
+}
@@ -0,0 +1,125 @@
+#include "logsink.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <windows.h>
+
+#define PUMP_BUFFER_SIZE (64 * 1024)
+
+namespace logsink {
+    struct Sink {
+        std::mutex lock;
+        std::string path;
+        int64_t maxBytes = 0;
+        int maxFiles = 1;
+        HANDLE file = INVALID_HANDLE_VALUE;
+        int64_t size = 0;
+
+        ~Sink() {
+            if (file != INVALID_HANDLE_VALUE) {
+                CloseHandle(file);
+            }
+        }
+    };
+
+    static HANDLE openLogFile(const std::string &path, DWORD disposition) {
+        return CreateFileA(
+                path.data(),
+                FILE_APPEND_DATA,
+                FILE_SHARE_READ | FILE_SHARE_DELETE,
+                nullptr,
+                disposition,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr
+        );
+    }
+
+    static void rotate(Sink &sink) {
+        CloseHandle(sink.file);
+
+        for (int i = sink.maxFiles - 1; i > 0; i--) {
+            std::string from = i == 1 ? sink.path : sink.path + "." + std::to_string(i - 1);
+            std::string to = sink.path + "." + std::to_string(i);
+
+            MoveFileExA(from.data(), to.data(), MOVEFILE_REPLACE_EXISTING);
+        }
+
+        sink.file = openLogFile(sink.path, CREATE_ALWAYS);
+        sink.size = 0;
+    }
+
+    static void write(Sink &sink, const char *data, DWORD length) {
+        while (length > 0) {
+            if (sink.maxBytes > 0 && sink.size >= sink.maxBytes) {
+                rotate(sink);
+            }
+
+            DWORD chunk = length;
+            if (sink.maxBytes > 0) {
+                chunk = static_cast<DWORD>(std::min<int64_t>(chunk, sink.maxBytes - sink.size));
+            }
+
+            DWORD written = 0;
+            if (sink.file == INVALID_HANDLE_VALUE || !WriteFile(sink.file, data, chunk, &written, nullptr)) {
+                return;
+            }
+
+            sink.size += written;
+            data += written;
+            length -= written;
+        }
+    }
+
+    static void pump(const std::shared_ptr<Sink> &sink, HANDLE source) {
+        std::unique_ptr<char[]> buffer{new char[PUMP_BUFFER_SIZE]};
+
+        DWORD n = 0;
+        while (ReadFile(source, buffer.get(), PUMP_BUFFER_SIZE, &n, nullptr) && n > 0) {
+            std::lock_guard<std::mutex> guard{sink->lock};
+
+            write(*sink, buffer.get(), n);
+        }
+
+        CloseHandle(source);
+    }
+
+    bool attach(
+            const std::string &path,
+            int64_t maxBytes,
+            int maxFiles,
+            const std::vector<process::ResourceHandle> &sources
+    ) {
+        HANDLE file = openLogFile(path, OPEN_ALWAYS);
+        if (file == INVALID_HANDLE_VALUE) {
+            DWORD code = GetLastError();
+
+            for (HANDLE source: sources) {
+                CloseHandle(source);
+            }
+
+            SetLastError(code);
+
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            size.QuadPart = 0;
+        }
+
+        auto sink = std::make_shared<Sink>();
+        sink->path = path;
+        sink->maxBytes = maxBytes;
+        sink->maxFiles = maxFiles;
+        sink->file = file;
+        sink->size = size.QuadPart;
+
+        for (HANDLE source: sources) {
+            std::thread{pump, sink, source}.detach();
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace looper {
+    using Handler = std::function<void(uint32_t events)>;
+
+    bool watch(int fd, uint32_t events, const Handler &handler);
+    void unwatch(int fd);
+}
@@ -0,0 +1,100 @@
+#include "looper.hpp"
+
+#include <map>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define MAX_EVENTS 32
+
+namespace looper {
+    struct Watch {
+        uint32_t generation;
+        std::shared_ptr<Handler> handler;
+    };
+
+    static std::mutex lock;
+    static int epoll = -1;
+    static uint32_t generation = 0;
+    static std::map<int, Watch> watches;
+
+    static void loop(int fd) {
+        epoll_event events[MAX_EVENTS];
+
+        while (true) {
+            int count = epoll_wait(fd, events, MAX_EVENTS, -1);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                // the epoll fd itself is broken, nothing would ever be dispatched again
+                fprintf(stderr, "Looper: epoll_wait: %s\n", strerror(errno));
+                abort();
+            }
+
+            for (int i = 0; i < count; i++) {
+                auto target = static_cast<int>(events[i].data.u64 & 0xffffffff);
+                auto targetGeneration = static_cast<uint32_t>(events[i].data.u64 >> 32);
+
+                std::shared_ptr<Handler> handler;
+                {
+                    std::lock_guard<std::mutex> guard{lock};
+
+                    auto it = watches.find(target);
+                    if (it == watches.end() || it->second.generation != targetGeneration) {
+                        continue;
+                    }
+
+                    handler = it->second.handler;
+                }
+
+                (*handler)(events[i].events);
+            }
+        }
+    }
+
+    bool watch(int fd, uint32_t events, const Handler &handler) {
+        std::lock_guard<std::mutex> guard{lock};
+
+        if (epoll < 0) {
+            epoll = epoll_create1(EPOLL_CLOEXEC);
+            if (epoll < 0) {
+                return false;
+            }
+
+            std::thread{loop, epoll}.detach();
+        }
+
+        uint32_t current = ++generation;
+
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = (static_cast<uint64_t>(current) << 32) | static_cast<uint32_t>(fd);
+
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+            return false;
+        }
+
+        watches[fd] = Watch{
+                .generation = current,
+                .handler = std::make_shared<Handler>(handler),
+        };
+
+        return true;
+    }
+
+    void unwatch(int fd) {
+        std::lock_guard<std::mutex> guard{lock};
+
+        if (watches.erase(fd) > 0) {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+        }
+    }
+}
@@ -5,6 +5,17 @@
 #include "window.hpp"
 #include "theme.hpp"
 #include "shell.hpp"
+#include "controller.hpp"
+#include "tun.hpp"
+#include "routes.hpp"
+#include "cpufeatures.hpp"
+#include "supervisor.hpp"
+#include "memfile.hpp"
+#include "sockets.hpp"
+#include "pressure.hpp"
+#include "logparse.hpp"
+#include "prefetch.hpp"
+#include "orphans.hpp"
 
 [[maybe_unused]]
 JNIEXPORT
@@ -36,6 +47,50 @@ jint JNI_OnLoad(JavaVM *vm, [[maybe_unused]] void *reserved) {
         goto error;
     }
 
+    if (!controller::initialize(env)) {
+        goto error;
+    }
+
+    if (!tun::initialize(env)) {
+        goto error;
+    }
+
+    if (!routes::initialize(env)) {
+        goto error;
+    }
+
+    if (!cpufeatures::initialize(env)) {
+        goto error;
+    }
+
+    if (!supervisor::initialize(env)) {
+        goto error;
+    }
+
+    if (!memfile::initialize(env)) {
+        goto error;
+    }
+
+    if (!sockets::initialize(env)) {
+        goto error;
+    }
+
+    if (!pressure::initialize(env)) {
+        goto error;
+    }
+
+    if (!logparse::initialize(env)) {
+        goto error;
+    }
+
+    if (!prefetch::initialize(env)) {
+        goto error;
+    }
+
+    if (!orphans::initialize(env)) {
+        goto error;
+    }
+
     return JNI_VERSION_1_8;
 
     error:
@@ -0,0 +1,97 @@
+#include "memfile.hpp"
+
+#include "jniutils.hpp"
+#include "os.hpp"
+
+namespace memfile {
+    static void jniCreateSealedFile(JNIEnv *env, jclass clazz, jstring name, jobject content, jint offset, jint length, jobject fd) {
+        auto data = static_cast<const char *>(env->GetDirectBufferAddress(content));
+
+        process::ResourceHandle h = createSealed(jniutils::getString(env, name), data + offset, static_cast<size_t>(length));
+        if (h == process::InvalidResourceHandle) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return;
+        }
+
+        process::setFileDescriptor(env, fd, h);
+    }
+
+    static jint loadedExecutable(JNIEnv *env, process::ResourceHandle h, jobject fd) {
+        if (h == process::InvalidResourceHandle) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return -1;
+        }
+
+        process::setFileDescriptor(env, fd, h);
+
+#if defined(__WIN32__)
+        return -1;
+#elif defined(__linux__)
+        return h;
+#endif
+    }
+
+    static jint jniLoadExecutable(JNIEnv *env, jclass clazz, jstring name, jobject content, jint offset, jint length, jobject fd) {
+        auto data = static_cast<const char *>(env->GetDirectBufferAddress(content));
+
+        process::ResourceHandle h = loadExecutable(jniutils::getString(env, name), data + offset, static_cast<size_t>(length));
+
+        return loadedExecutable(env, h, fd);
+    }
+
+    static jint jniLoadArchivedExecutable(
+            JNIEnv *env,
+            jclass clazz,
+            jstring name,
+            jstring archive,
+            jlong offset,
+            jlong length,
+            jobject fd
+    ) {
+        process::ResourceHandle h = loadExecutable(
+                jniutils::getString(env, name),
+                jniutils::getString(env, archive),
+                offset,
+                length
+        );
+
+        return loadedExecutable(env, h, fd);
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cMemoryFile = env->FindClass("com/github/kr328/clash/compat/MemoryFileCompat");
+        if (cMemoryFile == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeCreateSealedFile"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;Ljava/nio/ByteBuffer;IILjava/io/FileDescriptor;)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniCreateSealedFile),
+                },
+                {
+                        .name = const_cast<char *>("nativeLoadExecutable"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;Ljava/nio/ByteBuffer;IILjava/io/FileDescriptor;)I"),
+                        .fnPtr = reinterpret_cast<void *>(&jniLoadExecutable),
+                },
+                {
+                        .name = const_cast<char *>("nativeLoadArchivedExecutable"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;Ljava/lang/String;JJLjava/io/FileDescriptor;)I"),
+                        .fnPtr = reinterpret_cast<void *>(&jniLoadArchivedExecutable),
+                },
+        };
+
+        if (env->RegisterNatives(cMemoryFile, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
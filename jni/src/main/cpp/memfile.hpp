@@ -0,0 +1,24 @@
+#pragma once
+
+#include <jni.h>
+
+#include "process.hpp"
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace memfile {
+    bool initialize(JNIEnv *env);
+
+    // An in-memory file holding a copy of data, sealed against any later change,
+    // so a child can inherit it instead of reading a file written to disk.
+    process::ResourceHandle createSealed(const std::string &name, const void *data, size_t size);
+
+    // Like createSealed, but executable and cached by name: loading the same bytes again hands out
+    // the cached file without copying, different bytes replace it. The caller owns the returned handle.
+    process::ResourceHandle loadExecutable(const std::string &name, const void *data, size_t size);
+    // Takes the bytes from a range of archive, e.g. a stored jar entry. Cached by the identity of the
+    // archive file, so a replaced archive is read again.
+    process::ResourceHandle loadExecutable(const std::string &name, const std::string &archive, int64_t offset, int64_t length);
+}
@@ -0,0 +1,246 @@
+#include "memfile.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#ifndef MFD_EXEC
+#define MFD_EXEC 0x0010U
+#endif
+
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+namespace memfile {
+    struct CachedExecutable {
+        std::string identity;
+        int fd;
+    };
+
+    static std::mutex executablesLock;
+    static std::map<std::string, CachedExecutable> executables;
+
+    static void closeKeepingErrno(int fd) {
+        int err = errno;
+        close(fd);
+        errno = err;
+    }
+
+    static bool writeAll(int fd, const void *data, size_t size) {
+        auto bytes = static_cast<const char *>(data);
+        for (size_t written = 0; written < size;) {
+            ssize_t n = write(fd, bytes + written, size - written);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                return false;
+            }
+
+            written += n;
+        }
+
+        return true;
+    }
+
+    static bool seal(int fd) {
+        // shrinking is sealed too, or the child could still see a truncated file
+        return lseek(fd, 0, SEEK_SET) >= 0 && fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL) >= 0;
+    }
+
+    static int createExecutable(const std::string &name) {
+        // with vm.memfd_noexec set, a memfd is only executable when asked for explicitly
+        int fd = memfd_create(name.data(), MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_EXEC);
+        if (fd < 0 && errno == EINVAL) { // kernel before 6.3
+            fd = memfd_create(name.data(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        }
+
+        return fd;
+    }
+
+    static bool copyRange(int fdTarget, int fdSource, int64_t offset, int64_t length) {
+        off_t position = offset;
+        int64_t remaining = length;
+
+        while (remaining > 0) {
+            ssize_t n = sendfile(fdTarget, fdSource, &position, static_cast<size_t>(std::min<int64_t>(remaining, INT32_MAX)));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                break;
+            } else if (n < 0) {
+                return false;
+            } else if (n == 0) {
+                errno = EIO; // the archive shrank underneath
+
+                return false;
+            }
+
+            remaining -= n;
+        }
+
+        char buffer[COPY_BUFFER_SIZE];
+        while (remaining > 0) {
+            ssize_t n = pread(fdSource, buffer, static_cast<size_t>(std::min<int64_t>(remaining, sizeof(buffer))), position);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n <= 0) {
+                errno = n == 0 ? EIO : errno;
+
+                return false;
+            }
+
+            if (!writeAll(fdTarget, buffer, static_cast<size_t>(n))) {
+                return false;
+            }
+
+            position += n;
+            remaining -= n;
+        }
+
+        return true;
+    }
+
+    // The cached memfd is sealed, so comparing against it is as cheap as hashing and cannot collide.
+    static bool holds(int fd, const void *data, size_t size) {
+        if (size == 0) {
+            return true;
+        }
+
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+
+        bool same = memcmp(mapped, data, size) == 0;
+
+        munmap(mapped, size);
+
+        return same;
+    }
+
+    static int lookup(const std::string &name, const std::string &identity) {
+        auto it = executables.find(name);
+        if (it == executables.end() || it->second.identity != identity) {
+            return -1;
+        }
+
+        return fcntl(it->second.fd, F_DUPFD_CLOEXEC, 0);
+    }
+
+    static int store(const std::string &name, const std::string &identity, int fd) {
+        auto it = executables.find(name);
+        if (it != executables.end()) {
+            close(it->second.fd); // prepared processes hold their own reference
+        }
+
+        executables[name] = CachedExecutable{identity, fd};
+
+        return fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    }
+
+    process::ResourceHandle createSealed(const std::string &name, const void *data, size_t size) {
+        int fd = memfd_create(name.data(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0) {
+            return -1;
+        }
+
+        if (!writeAll(fd, data, size) || !seal(fd)) {
+            closeKeepingErrno(fd);
+
+            return -1;
+        }
+
+        return fd;
+    }
+
+    process::ResourceHandle loadExecutable(const std::string &name, const void *data, size_t size) {
+        std::string identity = "bytes:" + std::to_string(size);
+
+        std::lock_guard<std::mutex> guard{executablesLock};
+
+        int cached = lookup(name, identity);
+        if (cached >= 0) {
+            if (holds(cached, data, size)) {
+                return cached;
+            }
+
+            close(cached);
+        }
+
+        int fd = createExecutable(name);
+        if (fd < 0) {
+            return -1;
+        }
+
+        if (!writeAll(fd, data, size) || !seal(fd)) {
+            closeKeepingErrno(fd);
+
+            return -1;
+        }
+
+        return store(name, identity, fd);
+    }
+
+    process::ResourceHandle loadExecutable(const std::string &name, const std::string &archive, int64_t offset, int64_t length) {
+        int fdArchive = open(archive.data(), O_RDONLY | O_CLOEXEC);
+        if (fdArchive < 0) {
+            return -1;
+        }
+
+        struct stat st{};
+        if (fstat(fdArchive, &st) < 0) {
+            closeKeepingErrno(fdArchive);
+
+            return -1;
+        }
+
+        if (offset < 0 || length < 0 || offset > st.st_size || length > st.st_size - offset) {
+            close(fdArchive);
+            errno = EINVAL;
+
+            return -1;
+        }
+
+        std::string identity = "archive:" + std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) + ":" +
+                               std::to_string(st.st_size) + ":" + std::to_string(st.st_mtim.tv_sec) + "." +
+                               std::to_string(st.st_mtim.tv_nsec) + ":" + std::to_string(offset) + ":" +
+                               std::to_string(length);
+
+        std::lock_guard<std::mutex> guard{executablesLock};
+
+        int cached = lookup(name, identity);
+        if (cached >= 0) {
+            close(fdArchive);
+
+            return cached;
+        }
+
+        int fd = createExecutable(name);
+        if (fd < 0) {
+            closeKeepingErrno(fdArchive);
+
+            return -1;
+        }
+
+        bool copied = copyRange(fd, fdArchive, offset, length);
+
+        closeKeepingErrno(fdArchive);
+
+        if (!copied || !seal(fd)) {
+            closeKeepingErrno(fd);
+
+            return -1;
+        }
+
+        return store(name, identity, fd);
+    }
+}
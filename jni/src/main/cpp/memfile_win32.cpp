@@ -0,0 +1,23 @@
+#include "memfile.hpp"
+
+namespace memfile {
+    process::ResourceHandle createSealed(const std::string &name, const void *data, size_t size) {
+        // no sealable anonymous file that a child could read like a regular one
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return INVALID_HANDLE_VALUE;
+    }
+
+    process::ResourceHandle loadExecutable(const std::string &name, const void *data, size_t size) {
+        // CreateProcess only runs images that live in a file system
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return INVALID_HANDLE_VALUE;
+    }
+
+    process::ResourceHandle loadExecutable(const std::string &name, const std::string &archive, int64_t offset, int64_t length) {
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return INVALID_HANDLE_VALUE;
+    }
+}
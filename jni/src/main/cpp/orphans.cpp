@@ -0,0 +1,52 @@
+#include "orphans.hpp"
+
+#include "jniutils.hpp"
+#include "os.hpp"
+
+namespace orphans {
+    static jlongArray jniFindOrphans(JNIEnv *env, jclass clazz, jstring executable, jstring marker) {
+        std::vector<process::ResourceHandle> found;
+        if (!find(jniutils::getString(env, executable), jniutils::getString(env, marker), &found)) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return nullptr;
+        }
+
+        std::vector<jlong> handles;
+        for (process::ResourceHandle h: found) {
+#if defined(__WIN32__)
+            handles.push_back(reinterpret_cast<jlong>(h));
+#elif defined(__linux__)
+            handles.push_back(static_cast<jlong>(h));
+#endif
+        }
+
+        jlongArray result = env->NewLongArray(static_cast<jsize>(handles.size()));
+        env->SetLongArrayRegion(result, 0, static_cast<jsize>(handles.size()), handles.data());
+
+        return result;
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cOrphan = env->FindClass("com/github/kr328/clash/compat/OrphanCompat");
+        if (cOrphan == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeFindOrphans"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;Ljava/lang/String;)[J"),
+                        .fnPtr = reinterpret_cast<void *>(&jniFindOrphans),
+                },
+        };
+
+        if (env->RegisterNatives(cOrphan, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <jni.h>
+
+#include "process.hpp"
+
+#include <string>
+#include <vector>
+
+namespace orphans {
+    bool initialize(JNIEnv *env);
+
+    // Finds the running processes of executable, other than this one, whose initial environment holds
+    // marker ("NAME=VALUE"), e.g. cores a crashed predecessor left behind. Only processes of the same user
+    // are considered. The caller owns the returned handles. The processes are not our children, so waiting
+    // on them reports their exit, but not their status.
+    bool find(const std::string &executable, const std::string &marker, std::vector<process::ResourceHandle> *orphans);
+}
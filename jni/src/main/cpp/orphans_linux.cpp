@@ -0,0 +1,136 @@
+#include "orphans.hpp"
+
+#include "process_linux.hpp"
+
+#include <memory>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define DIRENT_BUFFER_SIZE (32 * 1024)
+#define ENVIRON_CHUNK_SIZE (16 * 1024)
+
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+namespace orphans {
+    static pid_t parsePid(const char *name) {
+        pid_t pid = 0;
+
+        for (const char *p = name; *p != '\0'; p++) {
+            if (*p < '0' || *p > '9') {
+                return 0;
+            }
+
+            pid = pid * 10 + (*p - '0');
+        }
+
+        return pid;
+    }
+
+    // The environment is NUL separated, the marker has to be a whole entry.
+    static bool hasMarker(int fdProc, const char *pid, const std::string &marker) {
+        std::string path = std::string(pid) + "/environ";
+
+        int fd = openat(fdProc, path.data(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+
+        std::string environ{'\0'};
+        char buffer[ENVIRON_CHUNK_SIZE];
+
+        while (true) {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n <= 0) {
+                break;
+            }
+
+            environ.append(buffer, n);
+        }
+
+        close(fd);
+
+        environ.push_back('\0');
+
+        std::string entry = '\0' + marker + '\0';
+
+        return environ.find(entry) != std::string::npos;
+    }
+
+    bool find(const std::string &executable, const std::string &marker, std::vector<process::ResourceHandle> *orphans) {
+        struct stat target{};
+        if (stat(executable.data(), &target) < 0) {
+            return false;
+        }
+
+        int fdProc = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fdProc < 0) {
+            return false;
+        }
+
+        uid_t uid = getuid();
+        pid_t self = getpid();
+
+        std::unique_ptr<char[]> buffer{new char[DIRENT_BUFFER_SIZE]};
+
+        while (true) {
+            long n = syscall(SYS_getdents64, fdProc, buffer.get(), DIRENT_BUFFER_SIZE);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n <= 0) {
+                break;
+            }
+
+            for (long offset = 0; offset < n;) {
+                auto entry = reinterpret_cast<linux_dirent64 *>(buffer.get() + offset);
+                offset += entry->d_reclen;
+
+                pid_t pid = parsePid(entry->d_name);
+                if (pid <= 0 || pid == self) {
+                    continue;
+                }
+
+                // cheapest filters first: owner of the /proc entry, then the executable inode
+                struct stat st{};
+                if (fstatat(fdProc, entry->d_name, &st, 0) < 0 || st.st_uid != uid) {
+                    continue;
+                }
+
+                std::string exe = std::string(entry->d_name) + "/exe";
+                if (fstatat(fdProc, exe.data(), &st, 0) < 0 || st.st_dev != target.st_dev || st.st_ino != target.st_ino) {
+                    continue;
+                }
+
+                // Open first and check afterwards: if it is still alive once the checks passed,
+                // the pid was not reused in between.
+                int pidfd = process::pidfdOpen(pid);
+                if (pidfd < 0) {
+                    continue;
+                }
+
+                if (!hasMarker(fdProc, entry->d_name, marker) || process::pidfdSendSignal(pidfd, 0) < 0) {
+                    close(pidfd);
+
+                    continue;
+                }
+
+                orphans->push_back(pidfd);
+            }
+        }
+
+        close(fdProc);
+
+        return true;
+    }
+}
@@ -0,0 +1,11 @@
+#include "orphans.hpp"
+
+namespace orphans {
+    bool find(const std::string &executable, const std::string &marker, std::vector<process::ResourceHandle> *orphans) {
+        // reading another process's environment means walking its PEB, and bound
+        // children already die with the kill-on-close job of their parent
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return false;
+    }
+}
@@ -0,0 +1,74 @@
+#include "prefetch.hpp"
+
+#include "jniutils.hpp"
+
+#include <algorithm>
+
+namespace prefetch {
+    static jmethodID mOnPrefetched;
+
+    static jlong jniPrefetchFiles(JNIEnv *env, jclass clazz, jobjectArray paths, jboolean lock, jobject listener) {
+        std::vector<std::string> cPaths;
+        std::for_each(jniutils::begin(env, paths), jniutils::end(env, paths), [&](jobject p) {
+            cPaths.push_back(jniutils::getString(env, reinterpret_cast<jstring>(p)));
+        });
+
+        listener = env->NewGlobalRef(listener);
+
+        Session *session = start(cPaths, lock, [listener](const Result &result) {
+            jniutils::AttachedEnv env{jniutils::currentJavaVM()};
+
+            env->CallVoidMethod(
+                    listener,
+                    mOnPrefetched,
+                    static_cast<jlong>(result.files),
+                    static_cast<jlong>(result.pages),
+                    static_cast<jlong>(result.residentPages),
+                    static_cast<jlong>(result.lockedPages)
+            );
+            env->DeleteGlobalRef(listener);
+        });
+
+        return reinterpret_cast<jlong>(session);
+    }
+
+    static void jniReleasePrefetch(JNIEnv *env, jclass clazz, jlong session) {
+        release(reinterpret_cast<Session *>(session));
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cListener = env->FindClass("com/github/kr328/clash/compat/PrefetchCompat$NativePrefetchListener");
+        if (cListener == nullptr) {
+            return false;
+        }
+
+        mOnPrefetched = env->GetMethodID(cListener, "onPrefetched", "(JJJJ)V");
+        if (mOnPrefetched == nullptr) {
+            return false;
+        }
+
+        jclass cPrefetch = env->FindClass("com/github/kr328/clash/compat/PrefetchCompat");
+        if (cPrefetch == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativePrefetchFiles"),
+                        .signature = const_cast<char *>("([Ljava/lang/String;ZLcom/github/kr328/clash/compat/PrefetchCompat$NativePrefetchListener;)J"),
+                        .fnPtr = reinterpret_cast<void *>(&jniPrefetchFiles),
+                },
+                {
+                        .name = const_cast<char *>("nativeReleasePrefetch"),
+                        .signature = const_cast<char *>("(J)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniReleasePrefetch),
+                },
+        };
+
+        if (env->RegisterNatives(cPrefetch, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <jni.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+namespace prefetch {
+    struct Result {
+        int64_t files;         // files that could be opened
+        int64_t pages;         // pages of those files
+        int64_t residentPages; // already in the page cache before the prefetch, -1 if unknown for any file
+        int64_t lockedPages;   // held in memory until release
+    };
+
+    struct Session;
+
+    bool initialize(JNIEnv *env);
+
+    // Pulls the files into the page cache on a background thread, which calls back once it has
+    // issued the reads. Missing files are skipped. With lock, their pages stay locked in memory
+    // as far as RLIMIT_MEMLOCK allows, until the session is released.
+    Session *start(const std::vector<std::string> &paths, bool lock, const std::function<void(const Result &)> &callback);
+    void release(Session *session);
+}
@@ -0,0 +1,132 @@
+#include "prefetch.hpp"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define READAHEAD_CHUNK_SIZE (128 * 1024)
+
+namespace prefetch {
+    struct Mapping {
+        void *address;
+        size_t size;
+    };
+
+    struct State {
+        std::mutex lock;
+        bool released = false;
+        std::vector<Mapping> locked;
+    };
+
+    struct Session {
+        std::shared_ptr<State> state;
+    };
+
+    static void warm(const std::shared_ptr<State> &state, const std::string &path, bool lock, Result *result) {
+        int fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+            close(fd);
+
+            return;
+        }
+
+        size_t size = static_cast<size_t>(st.st_size);
+        size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t pages = (size + pageSize - 1) / pageSize;
+
+        result->files++;
+        result->pages += static_cast<int64_t>(pages);
+
+        if (size == 0) {
+            close(fd);
+
+            return;
+        }
+
+        // mapping without touching faults nothing in, so mincore sees the cache as it was
+        void *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        std::unique_ptr<unsigned char[]> residency{new unsigned char[pages]};
+        if (address == MAP_FAILED || mincore(address, size, residency.get()) < 0) {
+            result->residentPages = -1; // one unknown file makes the total unknown
+        } else if (result->residentPages >= 0) {
+            for (size_t i = 0; i < pages; i++) {
+                result->residentPages += residency[i] & 1;
+            }
+        }
+
+        // the kernel trims each request to the device readahead window, so feed it in window sized steps
+        for (size_t offset = 0; offset < size; offset += READAHEAD_CHUNK_SIZE) {
+            if (readahead(fd, static_cast<off64_t>(offset), READAHEAD_CHUNK_SIZE) < 0) {
+                posix_fadvise(fd, static_cast<off_t>(offset), 0, POSIX_FADV_WILLNEED);
+
+                break;
+            }
+        }
+
+        close(fd);
+
+        if (address == MAP_FAILED) {
+            return;
+        }
+
+        if (lock) {
+            std::lock_guard<std::mutex> guard{state->lock};
+
+            if (!state->released && mlock(address, size) == 0) {
+                state->locked.push_back(Mapping{address, size});
+                result->lockedPages += static_cast<int64_t>(pages);
+
+                return;
+            }
+        }
+
+        munmap(address, size);
+    }
+
+    static void run(
+            const std::shared_ptr<State> &state,
+            const std::vector<std::string> &paths,
+            bool lock,
+            const std::function<void(const Result &)> &callback
+    ) {
+        Result result{};
+
+        for (const auto &path: paths) {
+            warm(state, path, lock, &result);
+        }
+
+        callback(result);
+    }
+
+    Session *start(const std::vector<std::string> &paths, bool lock, const std::function<void(const Result &)> &callback) {
+        auto state = std::make_shared<State>();
+
+        std::thread{run, state, paths, lock, callback}.detach();
+
+        return new Session{state};
+    }
+
+    void release(Session *session) {
+        {
+            std::lock_guard<std::mutex> guard{session->state->lock};
+
+            session->state->released = true;
+
+            for (const auto &mapping: session->state->locked) {
+                munmap(mapping.address, mapping.size);
+            }
+            session->state->locked.clear();
+        }
+
+        delete session;
+    }
+}
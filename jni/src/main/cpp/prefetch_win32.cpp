@@ -0,0 +1,64 @@
+#include "prefetch.hpp"
+
+#include <memory>
+#include <thread>
+#include <windows.h>
+
+#define READ_BUFFER_SIZE (1024 * 1024)
+
+namespace prefetch {
+    struct Session {
+    };
+
+    static void warm(const std::string &path, char *buffer, Result *result) {
+        HANDLE file = CreateFileA(
+                path.data(),
+                GENERIC_READ,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr,
+                OPEN_EXISTING,
+                FILE_FLAG_SEQUENTIAL_SCAN,
+                nullptr
+        );
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+
+        LARGE_INTEGER size{};
+        if (GetFileSizeEx(file, &size)) {
+            result->files++;
+            result->pages += (size.QuadPart + 4095) / 4096;
+
+            // reading through the cache manager is what warms it
+            DWORD n = 0;
+            while (ReadFile(file, buffer, READ_BUFFER_SIZE, &n, nullptr) && n > 0) {
+            }
+        }
+
+        CloseHandle(file);
+    }
+
+    static void run(const std::vector<std::string> &paths, const std::function<void(const Result &)> &callback) {
+        std::unique_ptr<char[]> buffer{new char[READ_BUFFER_SIZE]};
+
+        // residency of the file cache is not observable, and locking would need the working set quota
+        Result result{};
+        result.residentPages = -1;
+
+        for (const auto &path: paths) {
+            warm(path, buffer.get(), &result);
+        }
+
+        callback(result);
+    }
+
+    Session *start(const std::vector<std::string> &paths, bool lock, const std::function<void(const Result &)> &callback) {
+        std::thread{run, paths, callback}.detach();
+
+        return new Session{};
+    }
+
+    void release(Session *session) {
+        delete session;
+    }
+}
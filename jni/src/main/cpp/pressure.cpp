@@ -0,0 +1,100 @@
+#include "pressure.hpp"
+
+#include "jniutils.hpp"
+#include "os.hpp"
+
+#include <memory>
+
+namespace pressure {
+    static jmethodID mOnPressure;
+
+    static jlong jniWatchMemoryPressure(
+            JNIEnv *env,
+            jclass clazz,
+            jlong handle,
+            jboolean full,
+            jlong stallMicros,
+            jlong windowMicros,
+            jobject listener
+    ) {
+        Trigger trigger{
+                .full = static_cast<bool>(full),
+                .stallMicros = stallMicros,
+                .windowMicros = windowMicros,
+        };
+
+        // the last reference may go away on the looper or on the releasing Java thread
+        std::shared_ptr<_jobject> ref{env->NewGlobalRef(listener), [](jobject ref) {
+            JNIEnv *current = nullptr;
+            if (jniutils::currentJavaVM()->GetEnv(reinterpret_cast<void **>(&current), JNI_VERSION_1_8) == JNI_OK) {
+                current->DeleteGlobalRef(ref);
+            } else {
+                jniutils::AttachedEnv attached{jniutils::currentJavaVM()};
+
+                attached->DeleteGlobalRef(ref);
+            }
+        }};
+
+        Monitor *monitor = watch(process::fromJLong(handle), trigger, [ref](const Sample &sample) {
+            jniutils::AttachedEnv env{jniutils::currentJavaVM()};
+
+            env->CallVoidMethod(
+                    ref.get(),
+                    mOnPressure,
+                    static_cast<jdouble>(sample.someAvg10),
+                    static_cast<jdouble>(sample.fullAvg10),
+                    static_cast<jlong>(sample.someTotalMicros),
+                    static_cast<jlong>(sample.fullTotalMicros)
+            );
+        });
+        if (monitor == nullptr) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return 0;
+        }
+
+        return reinterpret_cast<jlong>(monitor);
+    }
+
+    static void jniReleasePressureMonitor(JNIEnv *env, jclass clazz, jlong monitor) {
+        release(reinterpret_cast<Monitor *>(monitor));
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cListener = env->FindClass("com/github/kr328/clash/compat/PressureCompat$PressureListener");
+        if (cListener == nullptr) {
+            return false;
+        }
+
+        mOnPressure = env->GetMethodID(cListener, "onPressure", "(DDJJ)V");
+        if (mOnPressure == nullptr) {
+            return false;
+        }
+
+        jclass cPressure = env->FindClass("com/github/kr328/clash/compat/PressureCompat");
+        if (cPressure == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeWatchMemoryPressure"),
+                        .signature = const_cast<char *>("(JZJJLcom/github/kr328/clash/compat/PressureCompat$PressureListener;)J"),
+                        .fnPtr = reinterpret_cast<void *>(&jniWatchMemoryPressure),
+                },
+                {
+                        .name = const_cast<char *>("nativeReleasePressureMonitor"),
+                        .signature = const_cast<char *>("(J)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniReleasePressureMonitor),
+                },
+        };
+
+        if (env->RegisterNatives(cPressure, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <jni.h>
+
+#include "process.hpp"
+
+#include <cstdint>
+#include <functional>
+
+namespace pressure {
+    struct Trigger {
+        bool full;            // every task stalled instead of some
+        int64_t stallMicros;  // stall time within one window that fires the trigger
+        int64_t windowMicros; // unprivileged callers need a multiple of 2s
+    };
+
+    struct Sample {
+        double someAvg10;
+        double fullAvg10;
+        int64_t someTotalMicros;
+        int64_t fullTotalMicros;
+    };
+
+    struct Monitor;
+
+    bool initialize(JNIEnv *env);
+
+    // Watches the memory pressure of the cgroup the process runs in, or of the whole system
+    // if it sits in the root cgroup. The callback runs on the looper, at most once per window.
+    Monitor *watch(process::ResourceHandle handle, const Trigger &trigger, const std::function<void(const Sample &)> &callback);
+    void release(Monitor *monitor);
+}
@@ -0,0 +1,150 @@
+#include "pressure.hpp"
+
+#include "looper.hpp"
+#include "process_linux.hpp"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define CGROUP_MOUNT "/sys/fs/cgroup"
+#define SYSTEM_PRESSURE "/proc/pressure/memory"
+#define READ_BUFFER_SIZE 512
+
+namespace pressure {
+    struct State {
+        int fd = -1;
+        std::function<void(const Sample &)> callback;
+
+        ~State() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    };
+
+    struct Monitor {
+        std::shared_ptr<State> state;
+    };
+
+    static std::string pressurePath(pid_t pid) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/cgroup", static_cast<int>(pid));
+
+        FILE *file = fopen(path, "re");
+        if (file == nullptr) {
+            return SYSTEM_PRESSURE;
+        }
+
+        std::string result = SYSTEM_PRESSURE;
+
+        char line[512];
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            // the unified hierarchy, "0::/path"
+            if (strncmp(line, "0::", 3) != 0) {
+                continue;
+            }
+
+            std::string cgroup{line + 3};
+            while (!cgroup.empty() && cgroup.back() == '\n') {
+                cgroup.pop_back();
+            }
+
+            // the root cgroup has no pressure file of its own
+            if (!cgroup.empty() && cgroup != "/") {
+                result = CGROUP_MOUNT + cgroup + "/memory.pressure";
+            }
+
+            break;
+        }
+
+        fclose(file);
+
+        return result;
+    }
+
+    static void readSample(int fd, Sample *sample) {
+        char buffer[READ_BUFFER_SIZE];
+
+        ssize_t n = pread(fd, buffer, sizeof(buffer) - 1, 0);
+        if (n <= 0) {
+            return;
+        }
+        buffer[n] = 0;
+
+        for (char *line = buffer; line != nullptr && *line != 0;) {
+            double avg10 = 0;
+            int64_t total = 0;
+
+            if (sscanf(line, "some avg10=%lf %*s %*s total=%" SCNd64, &avg10, &total) == 2) {
+                sample->someAvg10 = avg10;
+                sample->someTotalMicros = total;
+            } else if (sscanf(line, "full avg10=%lf %*s %*s total=%" SCNd64, &avg10, &total) == 2) {
+                sample->fullAvg10 = avg10;
+                sample->fullTotalMicros = total;
+            }
+
+            line = strchr(line, '\n');
+            if (line != nullptr) {
+                line++;
+            }
+        }
+    }
+
+    Monitor *watch(process::ResourceHandle handle, const Trigger &trigger, const std::function<void(const Sample &)> &callback) {
+        pid_t pid = process::pidOf(handle);
+        if (pid < 0) {
+            return nullptr;
+        }
+
+        std::string path = pressurePath(pid);
+
+        auto state = std::make_shared<State>();
+        state->callback = callback;
+        state->fd = open(path.data(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (state->fd < 0) {
+            return nullptr;
+        }
+
+        char request[64];
+        int length = snprintf(
+                request, sizeof(request), "%s %" PRId64 " %" PRId64,
+                trigger.full ? "full" : "some", trigger.stallMicros, trigger.windowMicros
+        );
+
+        // the trigger lives as long as the descriptor it was written to
+        if (write(state->fd, request, length + 1) < 0) {
+            return nullptr;
+        }
+
+        bool watched = looper::watch(state->fd, EPOLLPRI, [state](uint32_t events) {
+            if (events & EPOLLERR) {
+                looper::unwatch(state->fd); // the cgroup is gone
+
+                return;
+            }
+
+            Sample sample{};
+            readSample(state->fd, &sample);
+
+            state->callback(sample);
+        });
+        if (!watched) {
+            return nullptr;
+        }
+
+        return new Monitor{state};
+    }
+
+    void release(Monitor *monitor) {
+        looper::unwatch(monitor->state->fd);
+
+        delete monitor;
+    }
+}
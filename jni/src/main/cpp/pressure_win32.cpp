@@ -0,0 +1,17 @@
+#include "pressure.hpp"
+
+namespace pressure {
+    struct Monitor {
+    };
+
+    Monitor *watch(process::ResourceHandle handle, const Trigger &trigger, const std::function<void(const Sample &)> &callback) {
+        // memory resource notifications are system wide and carry no stall time
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return nullptr;
+    }
+
+    void release(Monitor *monitor) {
+        delete monitor;
+    }
+}
@@ -1,24 +1,30 @@
 #include "process.hpp"
 
 #include "os.hpp"
+#include "logsink.hpp"
+#include "logring.hpp"
+#include "readiness.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 namespace process {
     static jfieldID fFileDescriptorFd;
     static jfieldID fFileDescriptorHandle;
     static jmethodID mFileDescriptorClose;
+    static jmethodID mOnExited;
+    static jmethodID mOnReady;
 
-    static jlong jniCreateProcess(
+    static Template *prepareFromJava(
             JNIEnv *env,
-            jclass clazz,
             jstring path,
             jobjectArray args,
             jstring workingDir,
             jobjectArray environments,
-            jobject fdStdin,
-            jobject fdStdout,
-            jobject fdStderr
+            jobjectArray inheritedFds,
+            jintArray inheritedTargets,
+            const Placement *placement
     ) {
         std::string cPath = jniutils::getString(env, path);
 
@@ -34,16 +40,49 @@ namespace process {
             cEnvironments.push_back(jniutils::getString(env, reinterpret_cast<jstring>(e)));
         });
 
+        std::vector<InheritedHandle> cInherited;
+        if (inheritedFds != nullptr) {
+            std::vector<jint> targets(env->GetArrayLength(inheritedTargets));
+            env->GetIntArrayRegion(inheritedTargets, 0, static_cast<jsize>(targets.size()), targets.data());
+
+            std::for_each(jniutils::begin(env, inheritedFds), jniutils::end(env, inheritedFds), [&](jobject fd) {
+#if defined(__WIN32__)
+                ResourceHandle h = fromJLong(env->GetLongField(fd, fFileDescriptorHandle));
+#elif defined(__linux__)
+                ResourceHandle h = env->GetIntField(fd, fFileDescriptorFd);
+#endif
+
+                cInherited.push_back(InheritedHandle{
+                        .handle = h,
+                        .target = targets[cInherited.size()],
+                });
+            });
+        }
+
+        Template *prepared = prepare(cPath, cArgs, cWorkingDir, cEnvironments, cInherited, placement);
+        if (prepared == nullptr) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+        }
+
+        return prepared;
+    }
+
+    static jlong createFromTemplate(
+            JNIEnv *env,
+            const Template *prepared,
+            jobject fdStdin,
+            jobject fdStdout,
+            jobject fdStderr
+    ) {
         ResourceHandle hProcess = InvalidResourceHandle;
         ResourceHandle hStdin = InvalidResourceHandle;
         ResourceHandle hStdout = InvalidResourceHandle;
         ResourceHandle hStderr = InvalidResourceHandle;
 
         bool success = create(
-                cPath,
-                cArgs,
-                cWorkingDir,
-                cEnvironments,
+                prepared,
                 &hProcess,
                 fdStdin != nullptr ? &hStdin : nullptr,
                 fdStdout != nullptr ? &hStdout : nullptr,
@@ -83,18 +122,283 @@ namespace process {
         return (jlong) hProcess;
     }
 
-    static jint jniWaitProcess(JNIEnv *env, jclass clazz, jlong handle) {
-        return wait(fromJLong(handle));
+    static jlong jniCreateProcess(
+            JNIEnv *env,
+            jclass clazz,
+            jstring path,
+            jobjectArray args,
+            jstring workingDir,
+            jobjectArray environments,
+            jobjectArray inheritedFds,
+            jintArray inheritedTargets,
+            jobject fdStdin,
+            jobject fdStdout,
+            jobject fdStderr
+    ) {
+        Template *prepared = prepareFromJava(env, path, args, workingDir, environments, inheritedFds, inheritedTargets, nullptr);
+        if (prepared == nullptr) {
+            return -1;
+        }
+
+        jlong handle = createFromTemplate(env, prepared, fdStdin, fdStdout, fdStderr);
+
+        release(prepared);
+
+        return handle;
+    }
+
+    static jlong jniPrepareSpawn(
+            JNIEnv *env,
+            jclass clazz,
+            jstring path,
+            jobjectArray args,
+            jstring workingDir,
+            jobjectArray environments,
+            jobjectArray inheritedFds,
+            jintArray inheritedTargets,
+            jboolean hasPlacement,
+            jstring cgroup,
+            jintArray cpus,
+            jboolean hasNice,
+            jint nice,
+            jint ioPriority,
+            jlong maxOpenFiles,
+            jint transparentHugePages,
+            jboolean bindToParent
+    ) {
+        if (!hasPlacement) {
+            return reinterpret_cast<jlong>(prepareFromJava(env, path, args, workingDir, environments, inheritedFds, inheritedTargets, nullptr));
+        }
+
+        Placement placement{
+                .cgroup = cgroup != nullptr ? jniutils::getString(env, cgroup) : "",
+                .cpus = {},
+                .hasNice = static_cast<bool>(hasNice),
+                .nice = nice,
+                .ioPriority = ioPriority,
+                .maxOpenFiles = maxOpenFiles,
+                .transparentHugePages = transparentHugePages,
+                .bindToParent = static_cast<bool>(bindToParent),
+        };
+
+        if (cpus != nullptr) {
+            placement.cpus.resize(env->GetArrayLength(cpus));
+            env->GetIntArrayRegion(cpus, 0, static_cast<jsize>(placement.cpus.size()), reinterpret_cast<jint *>(placement.cpus.data()));
+        }
+
+        return reinterpret_cast<jlong>(prepareFromJava(env, path, args, workingDir, environments, inheritedFds, inheritedTargets, &placement));
+    }
+
+    static jlong jniSpawnPrepared(
+            JNIEnv *env,
+            jclass clazz,
+            jlong prepared,
+            jobject fdStdin,
+            jobject fdStdout,
+            jobject fdStderr
+    ) {
+        return createFromTemplate(env, reinterpret_cast<const Template *>(prepared), fdStdin, fdStdout, fdStderr);
+    }
+
+    static void jniReleasePrepared(JNIEnv *env, jclass clazz, jlong prepared) {
+        release(reinterpret_cast<Template *>(prepared));
+    }
+
+    static std::vector<ResourceHandle> takeHandles(JNIEnv *env, jobjectArray fds) {
+        std::vector<ResourceHandle> handles;
+
+        std::for_each(jniutils::begin(env, fds), jniutils::end(env, fds), [&](jobject fd) {
+#if defined(__WIN32__)
+            handles.push_back(fromJLong(env->GetLongField(fd, fFileDescriptorHandle)));
+            env->SetLongField(fd, fFileDescriptorHandle, -1);
+#elif defined(__linux__)
+            handles.push_back(env->GetIntField(fd, fFileDescriptorFd));
+            env->SetIntField(fd, fFileDescriptorFd, -1);
+#endif
+        });
+
+        return handles;
+    }
+
+    static void jniAttachLogSink(
+            JNIEnv *env,
+            jclass clazz,
+            jstring path,
+            jlong maxBytes,
+            jint maxFiles,
+            jobjectArray sources
+    ) {
+        if (!logsink::attach(jniutils::getString(env, path), maxBytes, maxFiles, takeHandles(env, sources))) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+        }
+    }
+
+    static jlong jniCreateLogRing(JNIEnv *env, jclass clazz, jint capacity) {
+        logring::Ring *ring = logring::create(static_cast<size_t>(std::max(capacity, 0)));
+        if (ring == nullptr) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return 0;
+        }
+
+        return reinterpret_cast<jlong>(ring);
+    }
+
+    static jobject jniLogRingBuffer(JNIEnv *env, jclass clazz, jlong ring) {
+        auto r = reinterpret_cast<logring::Ring *>(ring);
+
+        return env->NewDirectByteBuffer(logring::mapping(r), static_cast<jlong>(logring::mappingSize(r)));
+    }
+
+    static void jniAttachLogRing(JNIEnv *env, jclass clazz, jlong ring, jobjectArray sources) {
+        if (!logring::attach(reinterpret_cast<logring::Ring *>(ring), takeHandles(env, sources))) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+        }
+    }
+
+    static void jniReleaseLogRing(JNIEnv *env, jclass clazz, jlong ring) {
+        logring::release(reinterpret_cast<logring::Ring *>(ring));
+    }
+
+    static void jniWatchProcess(JNIEnv *env, jclass clazz, jlong handle, jobject listener) {
+        listener = env->NewGlobalRef(listener);
+
+        bool success = watch(fromJLong(handle), [listener](int status, const ResourceUsage &usage) {
+            jniutils::AttachedEnv env{jniutils::currentJavaVM()};
+
+            env->CallVoidMethod(
+                    listener,
+                    mOnExited,
+                    static_cast<jint>(status),
+                    static_cast<jlong>(usage.userTimeMicros),
+                    static_cast<jlong>(usage.systemTimeMicros),
+                    static_cast<jlong>(usage.maxResidentKb),
+                    static_cast<jlong>(usage.minorFaults),
+                    static_cast<jlong>(usage.majorFaults),
+                    static_cast<jlong>(usage.voluntarySwitches),
+                    static_cast<jlong>(usage.involuntarySwitches)
+            );
+            env->DeleteGlobalRef(listener);
+        });
+
+        if (!success) {
+            std::string error = os::getLastError();
+
+            env->DeleteGlobalRef(listener);
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+        }
+    }
+
+    static void jniWatchReadiness(
+            JNIEnv *env,
+            jclass clazz,
+            jlong handle,
+            jobject fdStdout,
+            jstring marker,
+            jint port,
+            jstring unixSocket,
+            jlong timeoutMillis,
+            jobject listener
+    ) {
+        readiness::Probes probes{
+                .marker = marker != nullptr ? jniutils::getString(env, marker) : "",
+                .port = port,
+                .unixSocket = unixSocket != nullptr ? jniutils::getString(env, unixSocket) : "",
+                .timeoutMillis = timeoutMillis,
+        };
+
+        ResourceHandle stdoutHandle = InvalidResourceHandle;
+        if (fdStdout != nullptr) {
+#if defined(__WIN32__)
+            stdoutHandle = fromJLong(env->GetLongField(fdStdout, fFileDescriptorHandle));
+#elif defined(__linux__)
+            stdoutHandle = env->GetIntField(fdStdout, fFileDescriptorFd);
+#endif
+        }
+
+        listener = env->NewGlobalRef(listener);
+
+        bool success = readiness::watch(fromJLong(handle), probes, &stdoutHandle, [listener](bool ready) {
+            jniutils::AttachedEnv env{jniutils::currentJavaVM()};
+
+            env->CallVoidMethod(listener, mOnReady, static_cast<jboolean>(ready));
+            env->DeleteGlobalRef(listener);
+        });
+
+        if (!success) {
+            std::string error = os::getLastError();
+
+            env->DeleteGlobalRef(listener);
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return;
+        }
+
+        if (fdStdout != nullptr) {
+#if defined(__WIN32__)
+            env->SetLongField(fdStdout, fFileDescriptorHandle, reinterpret_cast<jlong>(stdoutHandle));
+#elif defined(__linux__)
+            env->SetIntField(fdStdout, fFileDescriptorFd, stdoutHandle);
+#endif
+        }
+    }
+
+    static jboolean jniSampleProcess(JNIEnv *env, jclass clazz, jlong handle, jlongArray values) {
+        ResourceSample cSample{};
+        if (!sample(fromJLong(handle), &cSample)) {
+            return JNI_FALSE;
+        }
+
+        const jlong cValues[] = {
+                cSample.userTimeMicros,
+                cSample.systemTimeMicros,
+                cSample.residentKb,
+                cSample.voluntarySwitches,
+                cSample.involuntarySwitches,
+                cSample.readBytes,
+                cSample.writtenBytes,
+                cSample.threads,
+        };
+
+        env->SetLongArrayRegion(values, 0, sizeof(cValues) / sizeof(*cValues), cValues);
+
+        return JNI_TRUE;
     }
 
     static void jniTerminateProcess(JNIEnv *env, jclass clazz, jlong handle) {
         terminate(fromJLong(handle));
     }
 
+    static void jniTerminateProcessGracefully(JNIEnv *env, jclass clazz, jlong handle, jlong graceMillis) {
+        terminate(fromJLong(handle), graceMillis);
+    }
+
     static void jniReleaseProcess(JNIEnv *env, jclass clazz, jlong handle) {
         release(fromJLong(handle));
     }
 
+    ResourceHandle getFileDescriptor(JNIEnv *env, jobject fd) {
+#if defined(__WIN32__)
+        return fromJLong(env->GetLongField(fd, fFileDescriptorHandle));
+#elif defined(__linux__)
+        return env->GetIntField(fd, fFileDescriptorFd);
+#endif
+    }
+
+    void setFileDescriptor(JNIEnv *env, jobject fd, ResourceHandle handle) {
+#if defined(__WIN32__)
+        env->SetLongField(fd, fFileDescriptorHandle, reinterpret_cast<jlong>(handle));
+#elif defined(__linux__)
+        env->SetIntField(fd, fFileDescriptorFd, handle);
+#endif
+    }
+
     static void jniReleaseFileDescriptor(JNIEnv *env, jclass clazz, jobject fd) {
         env->CallVoidMethod(fd, mFileDescriptorClose);
     }
@@ -120,6 +424,26 @@ namespace process {
             return false;
         }
 
+        jclass exitListener = env->FindClass("com/github/kr328/clash/compat/ProcessCompat$NativeExitListener");
+        if (exitListener == nullptr) {
+            return false;
+        }
+
+        mOnExited = env->GetMethodID(exitListener, "onExited", "(IJJJJJJJ)V");
+        if (mOnExited == nullptr) {
+            return false;
+        }
+
+        jclass readinessListener = env->FindClass("com/github/kr328/clash/compat/ProcessCompat$NativeReadinessListener");
+        if (readinessListener == nullptr) {
+            return false;
+        }
+
+        mOnReady = env->GetMethodID(readinessListener, "onReady", "(Z)V");
+        if (mOnReady == nullptr) {
+            return false;
+        }
+
         jclass process = env->FindClass("com/github/kr328/clash/compat/ProcessCompat");
         if (process == nullptr) {
             return false;
@@ -128,19 +452,74 @@ namespace process {
         const JNINativeMethod methods[] = {
                 {
                         .name = const_cast<char *>("nativeCreateProcess"),
-                        .signature = const_cast<char *>("(Ljava/lang/String;[Ljava/lang/String;Ljava/lang/String;[Ljava/lang/String;Ljava/io/FileDescriptor;Ljava/io/FileDescriptor;Ljava/io/FileDescriptor;)J"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;[Ljava/lang/String;Ljava/lang/String;[Ljava/lang/String;[Ljava/io/FileDescriptor;[ILjava/io/FileDescriptor;Ljava/io/FileDescriptor;Ljava/io/FileDescriptor;)J"),
                         .fnPtr = reinterpret_cast<void *>(&jniCreateProcess),
                 },
                 {
-                        .name = const_cast<char *>("nativeWaitProcess"),
-                        .signature = const_cast<char *>("(J)I"),
-                        .fnPtr = reinterpret_cast<void *>(&jniWaitProcess),
+                        .name = const_cast<char *>("nativePrepareSpawn"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;[Ljava/lang/String;Ljava/lang/String;[Ljava/lang/String;[Ljava/io/FileDescriptor;[IZLjava/lang/String;[IZIIJIZ)J"),
+                        .fnPtr = reinterpret_cast<void *>(&jniPrepareSpawn),
+                },
+                {
+                        .name = const_cast<char *>("nativeSpawnPrepared"),
+                        .signature = const_cast<char *>("(JLjava/io/FileDescriptor;Ljava/io/FileDescriptor;Ljava/io/FileDescriptor;)J"),
+                        .fnPtr = reinterpret_cast<void *>(&jniSpawnPrepared),
+                },
+                {
+                        .name = const_cast<char *>("nativeReleasePrepared"),
+                        .signature = const_cast<char *>("(J)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniReleasePrepared),
+                },
+                {
+                        .name = const_cast<char *>("nativeAttachLogSink"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;JI[Ljava/io/FileDescriptor;)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniAttachLogSink),
+                },
+                {
+                        .name = const_cast<char *>("nativeCreateLogRing"),
+                        .signature = const_cast<char *>("(I)J"),
+                        .fnPtr = reinterpret_cast<void *>(&jniCreateLogRing),
+                },
+                {
+                        .name = const_cast<char *>("nativeLogRingBuffer"),
+                        .signature = const_cast<char *>("(J)Ljava/nio/ByteBuffer;"),
+                        .fnPtr = reinterpret_cast<void *>(&jniLogRingBuffer),
+                },
+                {
+                        .name = const_cast<char *>("nativeAttachLogRing"),
+                        .signature = const_cast<char *>("(J[Ljava/io/FileDescriptor;)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniAttachLogRing),
+                },
+                {
+                        .name = const_cast<char *>("nativeReleaseLogRing"),
+                        .signature = const_cast<char *>("(J)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniReleaseLogRing),
+                },
+                {
+                        .name = const_cast<char *>("nativeWatchProcess"),
+                        .signature = const_cast<char *>("(JLcom/github/kr328/clash/compat/ProcessCompat$NativeExitListener;)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniWatchProcess),
+                },
+                {
+                        .name = const_cast<char *>("nativeWatchReadiness"),
+                        .signature = const_cast<char *>("(JLjava/io/FileDescriptor;Ljava/lang/String;ILjava/lang/String;JLcom/github/kr328/clash/compat/ProcessCompat$NativeReadinessListener;)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniWatchReadiness),
+                },
+                {
+                        .name = const_cast<char *>("nativeSampleProcess"),
+                        .signature = const_cast<char *>("(J[J)Z"),
+                        .fnPtr = reinterpret_cast<void *>(&jniSampleProcess),
                 },
                 {
                         .name = const_cast<char *>("nativeTerminateProcess"),
                         .signature = const_cast<char *>("(J)V"),
                         .fnPtr = reinterpret_cast<void *>(&jniTerminateProcess),
                 },
+                {
+                        .name = const_cast<char *>("nativeTerminateProcess"),
+                        .signature = const_cast<char *>("(JJ)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniTerminateProcessGracefully),
+                },
                 {
                         .name = const_cast<char *>("nativeReleaseProcess"),
                         .signature = const_cast<char *>("(J)V"),
@@ -157,6 +536,30 @@ namespace process {
             return false;
         }
 
+        jclass system = env->FindClass("java/lang/System");
+        if (system == nullptr) {
+            return false;
+        }
+
+        jmethodID mGetProperty = env->GetStaticMethodID(system, "getProperty", "(Ljava/lang/String;)Ljava/lang/String;");
+        if (mGetProperty == nullptr) {
+            return false;
+        }
+
+        auto spawnHelper = reinterpret_cast<jstring>(env->CallStaticObjectMethod(
+                system,
+                mGetProperty,
+                jniutils::newString(env, "com.github.kr328.clash.compat.spawnHelper")
+        ));
+        if (env->ExceptionCheck()) {
+            return false;
+        }
+
+        // a missing helper only means spawning directly from the JVM
+        if (spawnHelper != nullptr && jniutils::getString(env, spawnHelper) == "true") {
+            startHelper();
+        }
+
         return true;
     }
 }
@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <functional>
 
 #if defined(__WIN32__)
 #include <windows.h>
@@ -25,18 +26,70 @@ namespace process {
     inline static ResourceHandle fromJLong(jlong value) { return static_cast<ResourceHandle>(value); }
 #endif
 
+    struct InheritedHandle {
+        ResourceHandle handle;
+        int target;
+    };
+
+    struct ResourceUsage {
+        int64_t userTimeMicros;
+        int64_t systemTimeMicros;
+        int64_t maxResidentKb;
+        int64_t minorFaults;
+        int64_t majorFaults;
+        int64_t voluntarySwitches;
+        int64_t involuntarySwitches;
+    };
+
     bool initialize(JNIEnv *env);
-    bool create(
+    bool startHelper();
+    // java.io.FileDescriptor access for the JNI glue of other modules, usable once initialize has run.
+    ResourceHandle getFileDescriptor(JNIEnv *env, jobject fd);
+    void setFileDescriptor(JNIEnv *env, jobject fd, ResourceHandle handle);
+    struct ResourceSample {
+        int64_t userTimeMicros;
+        int64_t systemTimeMicros;
+        int64_t residentKb;
+        int64_t voluntarySwitches;
+        int64_t involuntarySwitches;
+        int64_t readBytes;
+        int64_t writtenBytes;
+        int64_t threads;
+    };
+
+    struct Placement {
+        std::string cgroup;
+        std::vector<int> cpus;
+        bool hasNice;
+        int nice;
+        int ioPriority;
+        int64_t maxOpenFiles;
+        int transparentHugePages;
+        bool bindToParent;
+    };
+
+    struct Template;
+
+    Template *prepare(
             const std::string &path,
             const std::vector<std::string> &args,
             const std::string &workingDir,
             const std::vector<std::string> &environments,
+            const std::vector<InheritedHandle> &inherited,
+            const Placement *placement
+    );
+    bool create(
+            const Template *prepared,
             ResourceHandle *handle,
             ResourceHandle *fdStdin,
             ResourceHandle *fdStdout,
             ResourceHandle *fdStderr
     );
+    void release(Template *prepared);
     int wait(ResourceHandle handle);
+    bool watch(ResourceHandle handle, const std::function<void(int status, const ResourceUsage &usage)> &exited);
+    bool sample(ResourceHandle handle, ResourceSample *sample);
     void terminate(ResourceHandle handle);
+    void terminate(ResourceHandle handle, int64_t graceMillis);
     void release(ResourceHandle handle);
 }
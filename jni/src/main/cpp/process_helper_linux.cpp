@@ -0,0 +1,530 @@
+#include "process_linux.hpp"
+
+#include "utils.hpp"
+#include "looper.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/prctl.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#define HELPER_MESSAGE_SIZE (256 * 1024)
+#define HELPER_MAX_FDS 253
+#define HELPER_SOCKET 3
+
+#define HELPER_FD_PIDFD (1U << 0)
+#define HELPER_FD_STDIN (1U << 1)
+#define HELPER_FD_STDOUT (1U << 2)
+#define HELPER_FD_STDERR (1U << 3)
+
+#define HELPER_PLACEMENT (1U << 0)
+#define HELPER_PLACEMENT_CGROUP (1U << 1)
+
+namespace process {
+    struct HelperRequest {
+        uint32_t argsCount;
+        uint32_t environmentsCount;
+        uint32_t inheritedCount;
+        uint32_t pipes;
+        uint32_t placement;
+    };
+
+    struct HelperResponse {
+        int32_t error;
+        uint32_t fds;
+    };
+
+    static std::mutex helperLock;
+    static int helperSocket = -1;
+
+    static void closeFd(int fd) {
+        auto err = errno;
+        close(fd);
+        errno = err;
+    }
+
+    static void closeFds(const int *fds, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            closeFd(fds[i]);
+        }
+    }
+
+    static ssize_t sendMessage(int sock, const void *data, size_t length, const int *fds, size_t fdsCount) {
+        iovec iov{
+                .iov_base = const_cast<void *>(data),
+                .iov_len = length,
+        };
+
+        std::vector<char> control(CMSG_SPACE(sizeof(int) * fdsCount));
+
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+
+        if (fdsCount > 0) {
+            msg.msg_control = control.data();
+            msg.msg_controllen = control.size();
+
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fdsCount);
+            memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fdsCount);
+        }
+
+        ssize_t r;
+        do {
+            r = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        } while (r < 0 && errno == EINTR);
+
+        return r;
+    }
+
+    static ssize_t receiveMessage(int sock, void *data, size_t capacity, int *fds, size_t *fdsCount) {
+        iovec iov{
+                .iov_base = data,
+                .iov_len = capacity,
+        };
+
+        char control[CMSG_SPACE(sizeof(int) * HELPER_MAX_FDS)];
+
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t r;
+        do {
+            r = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        } while (r < 0 && errno == EINTR);
+
+        size_t capacityFds = *fdsCount;
+        *fdsCount = 0;
+
+        if (r < 0) {
+            return r;
+        }
+
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < count; i++) {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+
+                if (*fdsCount < capacityFds) {
+                    fds[(*fdsCount)++] = fd;
+                } else {
+                    close(fd);
+                }
+            }
+        }
+
+        if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+            closeFds(fds, *fdsCount);
+            *fdsCount = 0;
+
+            errno = EMSGSIZE;
+
+            return -1;
+        }
+
+        return r;
+    }
+
+    static bool parseStrings(char *&cursor, const char *end, uint32_t count, std::vector<char *> &out) {
+        for (uint32_t i = 0; i < count; i++) {
+            auto terminator = static_cast<char *>(memchr(cursor, 0, end - cursor));
+            if (terminator == nullptr) {
+                return false;
+            }
+
+            out.push_back(cursor);
+            cursor = terminator + 1;
+        }
+        out.push_back(nullptr);
+
+        return true;
+    }
+
+    static void helperServe(int sock, char *message, size_t length, const int *fds, size_t fdsCount) {
+        HelperResponse response{
+                .error = 0,
+                .fds = 0,
+        };
+
+        int replyFds[4];
+        size_t replyCount = 0;
+
+        HelperRequest header{};
+        SpawnPlacement placement{};
+        std::vector<InheritedHandle> inherited;
+        std::vector<char *> args;
+        std::vector<char *> environments;
+
+        size_t placementSize = 0;
+        size_t fdsBase = 2;
+
+        bool valid = length >= sizeof(header);
+        if (valid) {
+            memcpy(&header, message, sizeof(header));
+
+            if (header.placement & HELPER_PLACEMENT) {
+                placementSize = sizeof(placement);
+            }
+            if (header.placement & HELPER_PLACEMENT_CGROUP) {
+                fdsBase++;
+            }
+
+            valid = fdsCount == header.inheritedCount + fdsBase &&
+                    length >= sizeof(header) + placementSize + sizeof(int32_t) * header.inheritedCount;
+        }
+        if (valid) {
+            if (placementSize > 0) {
+                memcpy(&placement, message + sizeof(header), sizeof(placement));
+
+                placement.fdCgroupProcs = (header.placement & HELPER_PLACEMENT_CGROUP) ? fds[2] : -1;
+            }
+
+            char *targets = message + sizeof(header) + placementSize;
+            for (uint32_t i = 0; i < header.inheritedCount; i++) {
+                int32_t target;
+                memcpy(&target, targets + sizeof(int32_t) * i, sizeof(target));
+
+                inherited.push_back(InheritedHandle{
+                        .handle = fds[i + fdsBase],
+                        .target = target,
+                });
+            }
+
+            char *cursor = targets + sizeof(int32_t) * header.inheritedCount;
+            valid = parseStrings(cursor, message + length, header.argsCount, args) &&
+                    parseStrings(cursor, message + length, header.environmentsCount, environments);
+        }
+
+        int pipes[3][2] = {{-1, -1}, {-1, -1}, {-1, -1}};
+        int pidfd = -1;
+
+        if (!valid) {
+            response.error = EINVAL;
+        } else {
+            for (int i = 0; i < 3; i++) {
+                if ((header.pipes & (HELPER_FD_STDIN << i)) && pipe2(pipes[i], O_CLOEXEC) < 0) {
+                    response.error = errno;
+                }
+            }
+        }
+
+        if (response.error == 0) {
+            SpawnRequest request{
+                    .fdWorkingDir = fds[0],
+                    .fdExecutable = fds[1],
+                    .fdStdin = pipes[0][0],
+                    .fdStdout = pipes[1][1],
+                    .fdStderr = pipes[2][1],
+                    .args = args.data(),
+                    .environments = environments.data(),
+                    .inherited = inherited.data(),
+                    .inheritedCount = inherited.size(),
+                    .placement = placementSize > 0 ? &placement : nullptr,
+            };
+
+            if (!spawn(request, true, &pidfd)) {
+                response.error = errno;
+            }
+
+            // the failed child is a child of the JVM, which has to reap it through the pidfd
+            if (pidfd >= 0) {
+                response.fds |= HELPER_FD_PIDFD;
+                replyFds[replyCount++] = pidfd;
+            }
+        }
+
+        if (response.error == 0) {
+            int parentEnds[3] = {pipes[0][1], pipes[1][0], pipes[2][0]};
+
+            for (int i = 0; i < 3; i++) {
+                if (header.pipes & (HELPER_FD_STDIN << i)) {
+                    response.fds |= HELPER_FD_STDIN << i;
+                    replyFds[replyCount++] = parentEnds[i];
+                }
+            }
+        }
+
+        sendMessage(sock, &response, sizeof(response), replyFds, replyCount);
+
+        if (pidfd >= 0) {
+            close(pidfd);
+        }
+        for (auto &pipe: pipes) {
+            if (pipe[0] >= 0) {
+                close(pipe[0]);
+            }
+            if (pipe[1] >= 0) {
+                close(pipe[1]);
+            }
+        }
+    }
+
+    [[noreturn]] static void helperMain(int sock) {
+        std::vector<char> message(HELPER_MESSAGE_SIZE);
+        int fds[HELPER_MAX_FDS];
+
+        while (true) {
+            size_t fdsCount = HELPER_MAX_FDS;
+
+            ssize_t length = receiveMessage(sock, message.data(), message.size(), fds, &fdsCount);
+            if (length == 0) {
+                _exit(0);
+            } else if (length < 0) {
+                if (errno != EMSGSIZE) {
+                    _exit(1);
+                }
+
+                length = 0;
+            }
+
+            helperServe(sock, message.data(), static_cast<size_t>(length), fds, fdsCount);
+
+            closeFds(fds, fdsCount);
+        }
+    }
+
+    static void closeHelperFileDescriptors() {
+        if (syscall(SYS_close_range, HELPER_SOCKET + 1, ~0U, 0) == 0) {
+            return;
+        }
+
+        DIR *fds = opendir("/proc/self/fd");
+        if (fds == nullptr) {
+            return;
+        }
+
+        std::vector<int> opened;
+
+        struct dirent *entry;
+        while ((entry = readdir(fds)) != nullptr) {
+            int fd = (int) strtol(entry->d_name, nullptr, 10);
+            if (fd > HELPER_SOCKET && fd != dirfd(fds)) {
+                opened.push_back(fd);
+            }
+        }
+
+        closedir(fds);
+
+        for (int fd: opened) {
+            close(fd);
+        }
+    }
+
+    bool startHelper() {
+        int fds[2] = {-1, -1};
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+            return false;
+        }
+
+        int bufferSize = HELPER_MESSAGE_SIZE;
+        setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+        setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            struct sigaction defaultAction{};
+            defaultAction.sa_handler = SIG_DFL;
+            sigemptyset(&defaultAction.sa_mask);
+
+            for (int sig = 1; sig < _NSIG; sig++) {
+                sigaction(sig, &defaultAction, nullptr);
+            }
+
+            sigset_t noSignals;
+            sigemptyset(&noSignals);
+            sigprocmask(SIG_SETMASK, &noSignals, nullptr);
+
+            prctl(PR_SET_NAME, "compat-spawner");
+
+            if (fds[1] != HELPER_SOCKET && dup3(fds[1], HELPER_SOCKET, O_CLOEXEC) < 0) {
+                _exit(1);
+            }
+
+            closeHelperFileDescriptors();
+
+            helperMain(HELPER_SOCKET);
+        }
+
+        closeFd(fds[1]);
+
+        if (pid < 0) {
+            closeFd(fds[0]);
+
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard{helperLock};
+
+            helperSocket = fds[0];
+        }
+
+        int pidfd = pidfdOpen(pid);
+        if (pidfd < 0) {
+            return true;
+        }
+
+        bool watched = looper::watch(pidfd, EPOLLIN, [pidfd](uint32_t events) {
+            siginfo_t info{};
+            if (pidfdWait(pidfd, &info, WEXITED | WNOHANG, nullptr) == 0 && info.si_pid == 0) {
+                return;
+            }
+
+            looper::unwatch(pidfd);
+            close(pidfd);
+
+            std::lock_guard<std::mutex> guard{helperLock};
+
+            if (helperSocket >= 0) {
+                close(helperSocket);
+                helperSocket = -1;
+            }
+        });
+        if (!watched) {
+            closeFd(pidfd);
+        }
+
+        return true;
+    }
+
+    HelperResult spawnWithHelper(
+            const SpawnRequest &request,
+            int *pidfd,
+            int *fdStdin,
+            int *fdStdout,
+            int *fdStderr
+    ) {
+        std::lock_guard<std::mutex> guard{helperLock};
+
+        if (helperSocket < 0 || request.inheritedCount + 3 > HELPER_MAX_FDS) {
+            return HELPER_UNAVAILABLE;
+        }
+
+        HelperRequest header{
+                .argsCount = 0,
+                .environmentsCount = 0,
+                .inheritedCount = static_cast<uint32_t>(request.inheritedCount),
+                .pipes = (fdStdin ? HELPER_FD_STDIN : 0) | (fdStdout ? HELPER_FD_STDOUT : 0) | (fdStderr ? HELPER_FD_STDERR : 0),
+                .placement = 0,
+        };
+
+        std::vector<int> fds = {request.fdWorkingDir, request.fdExecutable};
+
+        size_t placementSize = 0;
+        if (request.placement != nullptr) {
+            header.placement |= HELPER_PLACEMENT;
+            placementSize = sizeof(SpawnPlacement);
+
+            if (request.placement->fdCgroupProcs >= 0) {
+                header.placement |= HELPER_PLACEMENT_CGROUP;
+                fds.push_back(request.placement->fdCgroupProcs);
+            }
+        }
+
+        std::vector<char> strings;
+        for (char *const *arg = request.args; *arg != nullptr; arg++) {
+            strings.insert(strings.end(), *arg, *arg + strlen(*arg) + 1);
+            header.argsCount++;
+        }
+        for (char *const *env = request.environments; *env != nullptr; env++) {
+            strings.insert(strings.end(), *env, *env + strlen(*env) + 1);
+            header.environmentsCount++;
+        }
+
+        std::vector<char> message(sizeof(header) + placementSize + sizeof(int32_t) * request.inheritedCount);
+        memcpy(message.data(), &header, sizeof(header));
+        if (placementSize > 0) {
+            memcpy(message.data() + sizeof(header), request.placement, placementSize);
+        }
+
+        char *targets = message.data() + sizeof(header) + placementSize;
+        for (size_t i = 0; i < request.inheritedCount; i++) {
+            int32_t target = request.inherited[i].target;
+            memcpy(targets + sizeof(int32_t) * i, &target, sizeof(target));
+
+            fds.push_back(request.inherited[i].handle);
+        }
+
+        message.insert(message.end(), strings.begin(), strings.end());
+        if (message.size() > HELPER_MESSAGE_SIZE) {
+            return HELPER_UNAVAILABLE;
+        }
+
+        if (sendMessage(helperSocket, message.data(), message.size(), fds.data(), fds.size()) < 0) {
+            if (errno != EMSGSIZE) {
+                close(helperSocket);
+                helperSocket = -1;
+            }
+
+            return HELPER_UNAVAILABLE;
+        }
+
+        HelperResponse response{};
+        int replyFds[4];
+        size_t replyCount = 4;
+
+        ssize_t length = receiveMessage(helperSocket, &response, sizeof(response), replyFds, &replyCount);
+        if (length != sizeof(response)) {
+            closeFds(replyFds, replyCount);
+
+            close(helperSocket);
+            helperSocket = -1;
+
+            return HELPER_UNAVAILABLE;
+        }
+
+        size_t index = 0;
+        int received[4] = {-1, -1, -1, -1};
+        for (int i = 0; i < 4; i++) {
+            if ((response.fds & (1U << i)) && index < replyCount) {
+                received[i] = replyFds[index++];
+            }
+        }
+
+        if (response.error != 0) {
+            if (received[0] >= 0) {
+                siginfo_t info{};
+                while (pidfdWait(received[0], &info, WEXITED, nullptr) < 0 && errno == EINTR);
+            }
+
+            closeFds(replyFds, replyCount);
+
+            errno = response.error;
+
+            return HELPER_FAILED;
+        }
+
+        *pidfd = received[0];
+        if (fdStdin) {
+            *fdStdin = received[1];
+        }
+        if (fdStdout) {
+            *fdStdout = received[2];
+        }
+        if (fdStderr) {
+            *fdStderr = received[3];
+        }
+
+        return HELPER_SPAWNED;
+    }
+}
@@ -1,20 +1,153 @@
-#include "process.hpp"
+#include "process_linux.hpp"
 
 #include "utils.hpp"
+#include "looper.hpp"
 
+#include <algorithm>
 #include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
-#include <sys/wait.h>
+#include <sched.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+
+#define SPAWN_STACK_SIZE (64 * 1024)
+#define LISTEN_PID_PREFIX "LISTEN_PID="
+#define WAIT_ID_PIDFD 3
+#define IOPRIO_WHO_PROCESS 1
+
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
 
 namespace process {
+    struct SpawnContext {
+        int fdWorkingDir;
+        int fdExecutable;
+        int fdStdin;
+        int fdStdout;
+        int fdStderr;
+        char *const *args;
+        char *const *environments;
+        const InheritedHandle *inherited;
+        int *inheritedDuplicates;
+        size_t inheritedCount;
+        int inheritedBase;
+        const SpawnPlacement *placement;
+        char *listenPid;
+        pid_t parent;
+        sigset_t signalMask;
+        int error;
+    };
+
+    static std::mutex boundGroupsLock;
+    static std::map<int, pid_t> boundGroups;
+
+    // Serializes flipping the THP switch of the JVM's own mm around a clone.
+    static std::mutex hugePagesLock;
+
     static void closeFd(int fd) {
         auto err = errno;
         close(fd);
         errno = err;
     }
 
+    struct Template {
+        int fdWorkingDir = -1;
+        int fdExecutable = -1;
+        std::vector<InheritedHandle> inherited;
+        std::vector<char *> args;
+        std::vector<char *> environments;
+        std::unique_ptr<char[]> arena;
+        bool hasPlacement = false;
+        SpawnPlacement placement{};
+
+        ~Template() {
+            if (hasPlacement && placement.fdCgroupProcs >= 0) {
+                closeFd(placement.fdCgroupProcs);
+            }
+            if (fdWorkingDir >= 0) {
+                closeFd(fdWorkingDir);
+            }
+            if (fdExecutable >= 0) {
+                closeFd(fdExecutable);
+            }
+            for (const auto &h: inherited) {
+                closeFd(h.handle);
+            }
+        }
+    };
+
+    int pidfdOpen(pid_t pid) {
+        return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    }
+
+    int pidfdSendSignal(int pidfd, int signal) {
+        return static_cast<int>(syscall(SYS_pidfd_send_signal, pidfd, signal, nullptr, 0));
+    }
+
+    int pidfdWait(int pidfd, siginfo_t *info, int options, struct rusage *usage) {
+        return static_cast<int>(syscall(SYS_waitid, WAIT_ID_PIDFD, pidfd, info, options, usage));
+    }
+
+    static void reapFailed(int pidfd) {
+        auto err = errno;
+
+        siginfo_t info{};
+        while (pidfdWait(pidfd, &info, WEXITED, nullptr) < 0 && errno == EINTR);
+        close(pidfd);
+
+        errno = err;
+    }
+
+    static pid_t boundGroupOf(int handle) {
+        std::lock_guard<std::mutex> guard{boundGroupsLock};
+
+        auto it = boundGroups.find(handle);
+
+        return it != boundGroups.end() ? it->second : 0;
+    }
+
+    // Takes down whatever a bound child left behind in its process group. Only while the leader is
+    // unreaped, until then its id cannot be reused. Callers hold boundGroupsLock, so that the leader
+    // is not reaped in between.
+    static void killBoundGroup(int pidfd, pid_t group) {
+        siginfo_t info{};
+
+        if (group > 0 && pidfdWait(pidfd, &info, WEXITED | WNOHANG | WNOWAIT, nullptr) == 0) {
+            kill(-group, SIGKILL);
+        }
+    }
+
+    static int toWaitStatus(const siginfo_t &info) {
+        switch (info.si_code) {
+            case CLD_EXITED:
+                return (info.si_status & 0xff) << 8;
+            case CLD_KILLED:
+                return info.si_status & 0x7f;
+            case CLD_DUMPED:
+                return (info.si_status & 0x7f) | 0x80;
+            default:
+                return -1;
+        }
+    }
+
     static bool createPipePair(utils::Scoped<int> &readable, utils::Scoped<int> &writable) {
         int pipeFds[2] = {-1, -1};
 
@@ -28,50 +161,364 @@ namespace process {
         return true;
     }
 
-    static void cleanFileDescriptors(int fdExecutable) {
-        DIR *fds = opendir("/proc/self/fd");
-        if (fds == nullptr) {
+    // Runs in the spawned child, which shares memory with the parent: must not allocate.
+    static void markFileDescriptorsCloseOnExec() {
+        if (syscall(SYS_close_range, 3, ~0U, CLOSE_RANGE_CLOEXEC) == 0) {
             return;
         }
 
-        struct dirent *entry;
-        while ((entry = readdir(fds)) != nullptr) {
-            int fd = (int) strtol(entry->d_name, nullptr, 10);
-            if (fd == dirfd(fds) || fd == fdExecutable ||
-                fd == STDIN_FILENO || fd == STDOUT_FILENO || fd == STDERR_FILENO) {
-                continue;
+        int fds = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fds < 0) {
+            return;
+        }
+
+        char buffer[4096];
+        long length;
+        while ((length = syscall(SYS_getdents64, fds, buffer, sizeof(buffer))) > 0) {
+            for (long offset = 0; offset < length;) {
+                auto entry = reinterpret_cast<struct dirent64 *>(buffer + offset);
+                offset += entry->d_reclen;
+
+                if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+                    continue;
+                }
+
+                int fd = (int) strtol(entry->d_name, nullptr, 10);
+                if (fd > STDERR_FILENO) {
+                    fcntl(fd, F_SETFD, FD_CLOEXEC);
+                }
             }
-            close(fd);
         }
 
-        closedir(fds);
+        close(fds);
     }
 
-    bool create(
-            const std::string &path,
-            const std::vector<std::string> &args,
-            const std::string &workingDir,
-            const std::vector<std::string> &environments,
-            ResourceHandle *handle,
-            ResourceHandle *fdStdin,
-            ResourceHandle *fdStdout,
-            ResourceHandle *fdStderr
-    ) {
-        utils::Scoped<int> fdWorkingDir{open(workingDir.data(), O_RDONLY | O_DIRECTORY | O_CLOEXEC), closeFd};
-        if (fdWorkingDir < 0) {
+    [[noreturn]] static void spawnFailed(SpawnContext *context) {
+        context->error = errno;
+
+        _exit(127);
+    }
+
+    static bool startsWith(const char *str, const char *prefix) {
+        return strncmp(str, prefix, strlen(prefix)) == 0;
+    }
+
+    // Runs in the child, so no snprintf.
+    static void formatListenPid(char *buffer, pid_t pid) {
+        char digits[16];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + pid % 10);
+            pid /= 10;
+        } while (pid > 0);
+
+        char *p = buffer + strlen(LISTEN_PID_PREFIX);
+        while (count > 0) {
+            *p++ = digits[--count];
+        }
+        *p = 0;
+    }
+
+    static bool applyPlacement(const SpawnPlacement *placement) {
+        if (placement->fdCgroupProcs >= 0 && write(placement->fdCgroupProcs, "0", 1) < 0) {
             return false;
         }
 
-        utils::Scoped<int> fdExecutable{open(path.data(), O_RDONLY | O_CLOEXEC), closeFd};
-        if (fdExecutable < 0) {
+        if (placement->hasAffinity && sched_setaffinity(0, sizeof(cpu_set_t), &placement->affinity) < 0) {
             return false;
         }
 
-        std::string fdExecutablePath = "/proc/self/fd/" + std::to_string(static_cast<int>(fdExecutable));
-        if (access(fdExecutablePath.data(), R_OK | X_OK) != 0) {
+        if (placement->hasNice && setpriority(PRIO_PROCESS, 0, placement->nice) < 0) {
+            return false;
+        }
+
+        if (placement->ioPriority >= 0 && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, placement->ioPriority) < 0) {
+            return false;
+        }
+
+        if (placement->maxOpenFiles >= 0) {
+            struct rlimit limit{};
+            if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+                return false;
+            }
+
+            // raising the hard limit needs CAP_SYS_RESOURCE, otherwise settle for the hard limit
+            auto requested = static_cast<rlim_t>(placement->maxOpenFiles);
+            struct rlimit raised{
+                    .rlim_cur = requested,
+                    .rlim_max = std::max(requested, limit.rlim_max),
+            };
+            if (setrlimit(RLIMIT_NOFILE, &raised) < 0) {
+                limit.rlim_cur = std::min(requested, limit.rlim_max);
+                if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    static int spawnChild(void *arg) {
+        auto context = static_cast<SpawnContext *>(arg);
+
+        struct sigaction defaultAction{};
+        defaultAction.sa_handler = SIG_DFL;
+        sigemptyset(&defaultAction.sa_mask);
+
+        for (int sig = 1; sig < _NSIG; sig++) {
+            struct sigaction action{};
+            if (sigaction(sig, nullptr, &action) == 0 && action.sa_handler != SIG_IGN) {
+                sigaction(sig, &defaultAction, nullptr);
+            }
+        }
+
+        if (pthread_sigmask(SIG_SETMASK, &context->signalMask, nullptr) != 0) {
+            spawnFailed(context);
+        }
+
+        if (fchdir(context->fdWorkingDir) < 0) {
+            spawnFailed(context);
+        }
+
+        if (context->placement != nullptr && !applyPlacement(context->placement)) {
+            spawnFailed(context);
+        }
+
+        // PDEATHSIG follows the spawning thread, so bound children must come from a thread that outlives them.
+        if (context->placement != nullptr && context->placement->bindToParent) {
+            if (setpgid(0, 0) < 0 || prctl(PR_SET_PDEATHSIG, SIGKILL) < 0) {
+                spawnFailed(context);
+            }
+
+            if (getppid() != context->parent) {
+                errno = ESRCH;
+
+                spawnFailed(context);
+            }
+        }
+
+        // Move inherited handles above every target first, so that placing one cannot clobber another.
+        int fdExecutable = context->fdExecutable;
+        if (context->inheritedCount > 0) {
+            fdExecutable = fcntl(fdExecutable, F_DUPFD_CLOEXEC, context->inheritedBase);
+            if (fdExecutable < 0) {
+                spawnFailed(context);
+            }
+        }
+
+        for (size_t i = 0; i < context->inheritedCount; i++) {
+            context->inheritedDuplicates[i] = fcntl(context->inherited[i].handle, F_DUPFD_CLOEXEC, context->inheritedBase);
+            if (context->inheritedDuplicates[i] < 0) {
+                spawnFailed(context);
+            }
+        }
+
+        int fdNull = open("/dev/null", O_RDWR | O_CLOEXEC);
+        if (fdNull < 0) {
+            spawnFailed(context);
+        }
+
+        if (dup3(context->fdStdin >= 0 ? context->fdStdin : fdNull, STDIN_FILENO, 0) < 0) {
+            spawnFailed(context);
+        }
+        if (dup3(context->fdStdout >= 0 ? context->fdStdout : fdNull, STDOUT_FILENO, 0) < 0) {
+            spawnFailed(context);
+        }
+        if (dup3(context->fdStderr >= 0 ? context->fdStderr : fdNull, STDERR_FILENO, 0) < 0) {
+            spawnFailed(context);
+        }
+
+        markFileDescriptorsCloseOnExec();
+
+        for (size_t i = 0; i < context->inheritedCount; i++) {
+            if (dup3(context->inheritedDuplicates[i], context->inherited[i].target, 0) < 0) {
+                spawnFailed(context);
+            }
+        }
+
+        if (context->listenPid != nullptr) {
+            formatListenPid(context->listenPid, getpid());
+        }
+
+        fexecve(fdExecutable, context->args, context->environments);
+
+        spawnFailed(context);
+    }
+
+    bool spawn(const SpawnRequest &request, bool reparent, int *pidfd) {
+        *pidfd = -1;
+
+        int inheritedBase = STDERR_FILENO + 1;
+        for (size_t i = 0; i < request.inheritedCount; i++) {
+            if (request.inherited[i].target < 0) {
+                errno = EBADF;
+
+                return false;
+            }
+
+            inheritedBase = std::max(inheritedBase, request.inherited[i].target + 1);
+        }
+
+        std::vector<int> inheritedDuplicates(request.inheritedCount, -1);
+
+        // Socket activation: LISTEN_PID must name the child, which is only known once it runs.
+        char listenPid[32] = LISTEN_PID_PREFIX;
+        std::vector<char *> activatedEnvironments;
+        for (char *const *env = request.environments; *env != nullptr; env++) {
+            if (startsWith(*env, "LISTEN_FDS=")) {
+                for (char *const *e = request.environments; *e != nullptr; e++) {
+                    if (!startsWith(*e, LISTEN_PID_PREFIX)) {
+                        activatedEnvironments.push_back(*e);
+                    }
+                }
+                activatedEnvironments.push_back(listenPid);
+                activatedEnvironments.push_back(nullptr);
+
+                break;
+            }
+        }
+
+        utils::Scoped<void *> stack{
+                mmap(nullptr, SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0),
+                [](void *&s) {
+                    if (s != MAP_FAILED) {
+                        munmap(s, SPAWN_STACK_SIZE);
+                    }
+                },
+        };
+        if (stack == MAP_FAILED) {
+            return false;
+        }
+
+        SpawnContext context{
+                .fdWorkingDir = request.fdWorkingDir,
+                .fdExecutable = request.fdExecutable,
+                .fdStdin = request.fdStdin,
+                .fdStdout = request.fdStdout,
+                .fdStderr = request.fdStderr,
+                .args = request.args,
+                .environments = activatedEnvironments.empty() ? request.environments : activatedEnvironments.data(),
+                .inherited = request.inherited,
+                .inheritedDuplicates = inheritedDuplicates.data(),
+                .inheritedCount = request.inheritedCount,
+                .inheritedBase = inheritedBase,
+                .placement = request.placement,
+                .listenPid = activatedEnvironments.empty() ? nullptr : listenPid,
+                .parent = getpid(),
+                .signalMask = {},
+                .error = 0,
+        };
+
+        int flags = CLONE_VM | CLONE_VFORK | SIGCHLD;
+        if (reparent) {
+            flags |= CLONE_PARENT;
+        }
+
+        // The THP switch belongs to the mm, which the child shares until exec, so flip it around the clone.
+        // In the helper that is its own mm. Bound children, and all when the helper is unavailable, are
+        // spawned from the JVM, whose policy then changes for the duration of the clone, serialized so that
+        // concurrent spawns restore it right.
+        std::unique_lock<std::mutex> hugePages{hugePagesLock, std::defer_lock};
+        int thpDisabled = -1;
+        if (request.placement != nullptr && request.placement->transparentHugePages >= 0) {
+            hugePages.lock();
+
+            thpDisabled = prctl(PR_GET_THP_DISABLE, 0, 0, 0, 0);
+            if (thpDisabled < 0 || prctl(PR_SET_THP_DISABLE, request.placement->transparentHugePages == 0, 0, 0, 0) < 0) {
+                return false;
+            }
+        }
+
+        // Block all signals so that no JVM handler runs on the child before it resets them.
+        sigset_t allSignals;
+        sigfillset(&allSignals);
+        pthread_sigmask(SIG_SETMASK, &allSignals, &context.signalMask);
+
+        int fd = -1;
+        pid_t pid = clone(
+                spawnChild,
+                static_cast<char *>(static_cast<void *>(stack)) + SPAWN_STACK_SIZE,
+                flags | CLONE_PIDFD,
+                &context,
+                &fd
+        );
+        if (pid < 0 && errno == EINVAL) { // kernel without CLONE_PIDFD
+            pid = clone(
+                    spawnChild,
+                    static_cast<char *>(static_cast<void *>(stack)) + SPAWN_STACK_SIZE,
+                    flags,
+                    &context
+            );
+        }
+        int cloneError = errno;
+
+        pthread_sigmask(SIG_SETMASK, &context.signalMask, nullptr);
+
+        if (thpDisabled >= 0) {
+            prctl(PR_SET_THP_DISABLE, thpDisabled, 0, 0, 0);
+        }
+        if (hugePages.owns_lock()) {
+            hugePages.unlock();
+        }
+
+        if (pid < 0) {
+            errno = cloneError;
+
             return false;
         }
 
+        if (fd < 0) {
+            fd = pidfdOpen(pid);
+        }
+
+        if (fd < 0) {
+            int err = errno;
+
+            kill(pid, SIGKILL);
+            if (!reparent) {
+                waitpid(pid, nullptr, 0);
+            }
+
+            errno = err;
+
+            return false;
+        }
+
+        *pidfd = fd;
+
+        if (context.error != 0) {
+            errno = context.error;
+
+            return false;
+        }
+
+        return true;
+    }
+
+    static bool launch(
+            SpawnRequest &request,
+            ResourceHandle *handle,
+            ResourceHandle *fdStdin,
+            ResourceHandle *fdStdout,
+            ResourceHandle *fdStderr
+    ) {
+        int pidfd = -1;
+
+        // The helper would become the parent a bound child dies with.
+        bool bound = request.placement != nullptr && request.placement->bindToParent;
+
+        switch (bound ? HELPER_UNAVAILABLE : spawnWithHelper(request, &pidfd, fdStdin, fdStdout, fdStderr)) {
+            case HELPER_SPAWNED:
+                *handle = pidfd;
+
+                return true;
+            case HELPER_FAILED:
+                return false;
+            case HELPER_UNAVAILABLE:
+                break;
+        }
+
         utils::Scoped<int> fdStdinReadable{-1, closeFd};
         utils::Scoped<int> fdStdinWritable{-1, closeFd};
         if (fdStdin && !createPipePair(fdStdinReadable, fdStdinWritable)) {
@@ -90,92 +537,352 @@ namespace process {
             return false;
         }
 
-        pid_t pid = fork();
-        if (pid > 0) { // parent
-            *handle = pid;
+        request.fdStdin = fdStdinReadable;
+        request.fdStdout = fdStdoutWritable;
+        request.fdStderr = fdStderrWritable;
 
-            if (fdStdin) {
-                *fdStdin = fdStdinWritable;
-                fdStdinWritable = -1;
-            }
-            if (fdStdout) {
-                *fdStdout = fdStdoutReadable;
-                fdStdoutReadable = -1;
-            }
-            if (fdStderr) {
-                *fdStderr = fdStderrReadable;
-                fdStderrReadable = -1;
+        if (!spawn(request, false, &pidfd)) {
+            if (pidfd >= 0) {
+                reapFailed(pidfd);
             }
 
-            return true;
-        } else if (pid == 0) { // child
-            if (fchdir(fdWorkingDir) < 0) {
-                abort();
-            }
+            return false;
+        }
 
-            int fdNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (bound) {
+            std::lock_guard<std::mutex> guard{boundGroupsLock};
 
-            if (!fdStdin) {
-                fdStdinReadable = fdNull;
-            }
-            if (!fdStdout) {
-                fdStdoutWritable = fdNull;
+            boundGroups[pidfd] = pidOf(pidfd);
+        }
+
+        *handle = pidfd;
+
+        if (fdStdin) {
+            *fdStdin = fdStdinWritable;
+            fdStdinWritable = -1;
+        }
+        if (fdStdout) {
+            *fdStdout = fdStdoutReadable;
+            fdStdoutReadable = -1;
+        }
+        if (fdStderr) {
+            *fdStderr = fdStderrReadable;
+            fdStderrReadable = -1;
+        }
+
+        return true;
+    }
+
+    Template *prepare(
+            const std::string &path,
+            const std::vector<std::string> &args,
+            const std::string &workingDir,
+            const std::vector<std::string> &environments,
+            const std::vector<InheritedHandle> &inherited,
+            const Placement *placement
+    ) {
+        std::unique_ptr<Template> prepared{new Template()};
+
+        prepared->fdWorkingDir = open(workingDir.data(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (prepared->fdWorkingDir < 0) {
+            return nullptr;
+        }
+
+        prepared->fdExecutable = open(path.data(), O_RDONLY | O_CLOEXEC);
+        if (prepared->fdExecutable < 0) {
+            return nullptr;
+        }
+
+        std::string fdExecutablePath = "/proc/self/fd/" + std::to_string(prepared->fdExecutable);
+        if (access(fdExecutablePath.data(), R_OK | X_OK) != 0) {
+            return nullptr;
+        }
+
+        for (const auto &h: inherited) {
+            int duplicated = fcntl(h.handle, F_DUPFD_CLOEXEC, 0);
+            if (duplicated < 0) {
+                return nullptr;
             }
-            if (!fdStderr) {
-                fdStderrWritable = fdNull;
+
+            prepared->inherited.push_back(InheritedHandle{
+                    .handle = duplicated,
+                    .target = h.target,
+            });
+        }
+
+        if (placement != nullptr) {
+            prepared->hasPlacement = true;
+
+            SpawnPlacement &spawnPlacement = prepared->placement;
+            spawnPlacement.fdCgroupProcs = -1;
+            spawnPlacement.hasNice = placement->hasNice;
+            spawnPlacement.nice = placement->nice;
+            spawnPlacement.ioPriority = placement->ioPriority;
+            spawnPlacement.maxOpenFiles = placement->maxOpenFiles;
+            spawnPlacement.transparentHugePages = placement->transparentHugePages;
+            spawnPlacement.bindToParent = placement->bindToParent;
+
+            if (!placement->cgroup.empty()) {
+                std::string procs = placement->cgroup + "/cgroup.procs";
+
+                spawnPlacement.fdCgroupProcs = open(procs.data(), O_WRONLY | O_CLOEXEC);
+                if (spawnPlacement.fdCgroupProcs < 0) {
+                    return nullptr;
+                }
             }
 
-            if (dup3(fdStdinReadable, STDIN_FILENO, 0) < 0) {
-                abort();
+            spawnPlacement.hasAffinity = !placement->cpus.empty();
+            CPU_ZERO(&spawnPlacement.affinity);
+            for (int cpu: placement->cpus) {
+                if (cpu < 0 || cpu >= CPU_SETSIZE) {
+                    errno = EINVAL;
+
+                    return nullptr;
+                }
+
+                CPU_SET(cpu, &spawnPlacement.affinity);
             }
-            if (dup3(fdStdoutWritable, STDOUT_FILENO, 0) < 0) {
-                abort();
+        }
+
+        size_t arenaSize = 0;
+        for (const auto &arg: args) {
+            arenaSize += arg.size() + 1;
+        }
+        for (const auto &env: environments) {
+            arenaSize += env.size() + 1;
+        }
+
+        prepared->arena.reset(new char[arenaSize]);
+
+        char *cursor = prepared->arena.get();
+        auto store = [&cursor](const std::string &s) {
+            char *stored = cursor;
+            memcpy(cursor, s.data(), s.size() + 1);
+            cursor += s.size() + 1;
+            return stored;
+        };
+
+        for (const auto &arg: args) {
+            prepared->args.push_back(store(arg));
+        }
+        prepared->args.push_back(nullptr);
+
+        for (const auto &env: environments) {
+            prepared->environments.push_back(store(env));
+        }
+        prepared->environments.push_back(nullptr);
+
+        return prepared.release();
+    }
+
+    bool create(
+            const Template *prepared,
+            ResourceHandle *handle,
+            ResourceHandle *fdStdin,
+            ResourceHandle *fdStdout,
+            ResourceHandle *fdStderr
+    ) {
+        SpawnRequest request{
+                .fdWorkingDir = prepared->fdWorkingDir,
+                .fdExecutable = prepared->fdExecutable,
+                .fdStdin = -1,
+                .fdStdout = -1,
+                .fdStderr = -1,
+                .args = prepared->args.data(),
+                .environments = prepared->environments.data(),
+                .inherited = prepared->inherited.data(),
+                .inheritedCount = prepared->inherited.size(),
+                .placement = prepared->hasPlacement ? &prepared->placement : nullptr,
+        };
+
+        return launch(request, handle, fdStdin, fdStdout, fdStderr);
+    }
+
+    void release(Template *prepared) {
+        delete prepared;
+    }
+
+    int wait(ResourceHandle handle) {
+        siginfo_t info{};
+
+        pid_t group = boundGroupOf(handle);
+        if (group > 0) {
+            while (pidfdWait(handle, &info, WEXITED | WNOWAIT, nullptr) < 0 && errno == EINTR) {
             }
-            if (dup3(fdStderrWritable, STDERR_FILENO, 0) < 0) {
-                abort();
+        }
+
+        std::unique_lock<std::mutex> guard{boundGroupsLock, std::defer_lock};
+        if (group > 0) {
+            guard.lock();
+
+            killBoundGroup(handle, group);
+        }
+
+        while (pidfdWait(handle, &info, WEXITED, nullptr) < 0) {
+            if (errno == ECHILD) {
+                // adopted, not our child: the pidfd still turns readable once it exits
+                pollfd fd{
+                        .fd = handle,
+                        .events = POLLIN,
+                        .revents = 0,
+                };
+
+                while (poll(&fd, 1, -1) < 0 && errno == EINTR) {
+                }
+
+                return -1;
+            } else if (errno != EINTR) {
+                return -1;
             }
+        }
+
+        return toWaitStatus(info);
+    }
+
+    bool watch(ResourceHandle handle, const std::function<void(int status, const ResourceUsage &usage)> &exited) {
+        int fd = fcntl(handle, F_DUPFD_CLOEXEC, 0);
+        if (fd < 0) {
+            return false;
+        }
+
+        pid_t group = boundGroupOf(handle);
 
-            cleanFileDescriptors(fdExecutable);
+        bool watched = looper::watch(fd, EPOLLIN, [fd, group, exited](uint32_t events) {
+            siginfo_t info{};
+            struct rusage usage{};
+            int status = -1;
 
-            std::vector<const char *> cArgs;
-            for (const auto &arg: args) {
-                cArgs.push_back(arg.data());
+            std::unique_lock<std::mutex> guard{boundGroupsLock, std::defer_lock};
+            if (group > 0) {
+                guard.lock();
+
+                killBoundGroup(fd, group);
             }
-            cArgs.push_back(nullptr);
 
-            std::vector<const char *> cEnvironments;
-            for (const auto &env: environments) {
-                cEnvironments.push_back(env.data());
+            if (pidfdWait(fd, &info, WEXITED | WNOHANG, &usage) == 0) {
+                if (info.si_pid == 0) {
+                    return;
+                }
+
+                status = toWaitStatus(info);
             }
-            cEnvironments.push_back(nullptr);
 
-            if (fexecve(
-                    fdExecutable,
-                    const_cast<char *const *>(cArgs.data()),
-                    const_cast<char *const *>(cEnvironments.data())
-            ) < 0) {
-                abort();
+            if (guard.owns_lock()) {
+                guard.unlock();
             }
 
-            return -1;
+            looper::unwatch(fd);
+            close(fd);
+
+            exited(status, ResourceUsage{
+                    .userTimeMicros = usage.ru_utime.tv_sec * 1000000LL + usage.ru_utime.tv_usec,
+                    .systemTimeMicros = usage.ru_stime.tv_sec * 1000000LL + usage.ru_stime.tv_usec,
+                    .maxResidentKb = usage.ru_maxrss,
+                    .minorFaults = usage.ru_minflt,
+                    .majorFaults = usage.ru_majflt,
+                    .voluntarySwitches = usage.ru_nvcsw,
+                    .involuntarySwitches = usage.ru_nivcsw,
+            });
+        });
+        if (!watched) {
+            closeFd(fd);
         }
 
-        return -1;
+        return watched;
     }
 
-    int wait(ResourceHandle handle) {
-        auto pid = static_cast<pid_t>(handle);
-        int r = -1;
-        waitpid(pid, &r, 0);
-        return r;
+    void terminate(ResourceHandle handle) {
+        pidfdSendSignal(handle, SIGKILL);
     }
 
-    void terminate(ResourceHandle handle) {
-        auto pid = static_cast<pid_t>(handle);
-        kill(pid, SIGKILL);
+    struct Termination {
+        int pidfd;
+        int timer;
+        bool finished;
+    };
+
+    static void finishTermination(Termination &termination) {
+        if (termination.finished) {
+            return;
+        }
+
+        termination.finished = true;
+
+        looper::unwatch(termination.pidfd);
+        looper::unwatch(termination.timer);
+        close(termination.pidfd);
+        close(termination.timer);
+    }
+
+    void terminate(ResourceHandle handle, int64_t graceMillis) {
+        if (graceMillis <= 0 || pidfdSendSignal(handle, SIGTERM) < 0) {
+            terminate(handle);
+
+            return;
+        }
+
+        // own a duplicate, the handle may be released before the deadline
+        int pidfd = fcntl(handle, F_DUPFD_CLOEXEC, 0);
+        int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+        itimerspec deadline{};
+        deadline.it_value.tv_sec = graceMillis / 1000;
+        deadline.it_value.tv_nsec = (graceMillis % 1000) * 1000000;
+
+        if (pidfd < 0 || timer < 0 || timerfd_settime(timer, 0, &deadline, nullptr) < 0) {
+            if (pidfd >= 0) {
+                close(pidfd);
+            }
+            if (timer >= 0) {
+                close(timer);
+            }
+
+            terminate(handle);
+
+            return;
+        }
+
+        auto termination = std::make_shared<Termination>(Termination{
+                .pidfd = pidfd,
+                .timer = timer,
+                .finished = false,
+        });
+
+        bool watched = looper::watch(timer, EPOLLIN, [termination](uint32_t events) {
+            pidfdSendSignal(termination->pidfd, SIGKILL);
+
+            finishTermination(*termination);
+        });
+        if (!watched) {
+            close(pidfd);
+            close(timer);
+
+            terminate(handle);
+
+            return;
+        }
+
+        // without this watch the timer still escalates at the deadline, only the cleanup comes later
+        looper::watch(pidfd, EPOLLIN, [termination](uint32_t events) {
+            finishTermination(*termination);
+        });
     }
 
     void release(ResourceHandle handle) {
-        // do nothing
+        forgetSamples(handle);
+
+        {
+            std::lock_guard<std::mutex> guard{boundGroupsLock};
+
+            // Once reaped, the group was taken down by whoever reaped the leader.
+            auto it = boundGroups.find(handle);
+            if (it != boundGroups.end()) {
+                killBoundGroup(handle, it->second);
+
+                boundGroups.erase(it);
+            }
+        }
+
+        close(handle);
     }
 }
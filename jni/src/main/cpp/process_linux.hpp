@@ -0,0 +1,57 @@
+#pragma once
+
+#include "process.hpp"
+
+#include <csignal>
+#include <sched.h>
+#include <sys/resource.h>
+
+namespace process {
+    // Applied by the child before exec. Plain data, so that it can be copied to the spawn helper.
+    struct SpawnPlacement {
+        int fdCgroupProcs;
+        bool hasAffinity;
+        cpu_set_t affinity;
+        bool hasNice;
+        int nice;
+        int ioPriority;
+        int64_t maxOpenFiles;
+        int transparentHugePages;
+        bool bindToParent;
+    };
+
+    struct SpawnRequest {
+        int fdWorkingDir;
+        int fdExecutable;
+        int fdStdin;
+        int fdStdout;
+        int fdStderr;
+        char *const *args;
+        char *const *environments;
+        const InheritedHandle *inherited;
+        size_t inheritedCount;
+        const SpawnPlacement *placement;
+    };
+
+    enum HelperResult {
+        HELPER_UNAVAILABLE,
+        HELPER_SPAWNED,
+        HELPER_FAILED,
+    };
+
+    int pidfdOpen(pid_t pid);
+    int pidfdSendSignal(int pidfd, int signal);
+    int pidfdWait(int pidfd, siginfo_t *info, int options, struct rusage *usage);
+
+    bool spawn(const SpawnRequest &request, bool reparent, int *pidfd);
+    pid_t pidOf(int pidfd);
+    void forgetSamples(ResourceHandle handle);
+
+    HelperResult spawnWithHelper(
+            const SpawnRequest &request,
+            int *pidfd,
+            int *fdStdin,
+            int *fdStdout,
+            int *fdStderr
+    );
+}
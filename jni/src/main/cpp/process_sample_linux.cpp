@@ -0,0 +1,222 @@
+#include "process_linux.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SAMPLE_BUFFER_SIZE 4096
+
+namespace process {
+    struct ProcFiles {
+        int stat;
+        int status;
+        int io;
+    };
+
+    static std::mutex procFilesLock;
+    static std::map<int, ProcFiles> procFiles;
+
+    static void closeProcFiles(const ProcFiles &files) {
+        close(files.stat);
+        close(files.status);
+        if (files.io >= 0) {
+            close(files.io);
+        }
+    }
+
+    static ssize_t readProcFile(int fd, char *buffer, size_t capacity) {
+        ssize_t n;
+        do {
+            n = pread(fd, buffer, capacity - 1, 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n >= 0) {
+            buffer[n] = 0;
+        }
+
+        return n;
+    }
+
+    // Value following "key" at the start of a line in a "key: value" file, -1 if missing.
+    static int64_t findValue(const char *buffer, const char *key) {
+        size_t keyLength = strlen(key);
+
+        for (const char *line = buffer; line != nullptr && *line != 0;) {
+            if (strncmp(line, key, keyLength) == 0) {
+                return strtoll(line + keyLength, nullptr, 10);
+            }
+
+            line = strchr(line, '\n');
+            if (line != nullptr) {
+                line++;
+            }
+        }
+
+        return -1;
+    }
+
+    pid_t pidOf(int pidfd) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", pidfd);
+
+        int fdinfo = open(path, O_RDONLY | O_CLOEXEC);
+        if (fdinfo < 0) {
+            return -1;
+        }
+
+        char buffer[SAMPLE_BUFFER_SIZE];
+        ssize_t n = readProcFile(fdinfo, buffer, sizeof(buffer));
+        close(fdinfo);
+        if (n < 0) {
+            return -1;
+        }
+
+        int64_t pid = findValue(buffer, "Pid:");
+        if (pid <= 0) {
+            errno = ESRCH;
+
+            return -1;
+        }
+
+        return static_cast<pid_t>(pid);
+    }
+
+    static bool openProcFiles(int pidfd, ProcFiles *files) {
+        pid_t pid = pidOf(pidfd);
+        if (pid < 0) {
+            return false;
+        }
+
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d", static_cast<int>(pid));
+
+        int dir = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir < 0) {
+            return false;
+        }
+
+        // the pid may have been recycled before the directory was opened
+        if (pidfdSendSignal(pidfd, 0) < 0) {
+            close(dir);
+
+            return false;
+        }
+
+        files->stat = openat(dir, "stat", O_RDONLY | O_CLOEXEC);
+        files->status = openat(dir, "status", O_RDONLY | O_CLOEXEC);
+        files->io = openat(dir, "io", O_RDONLY | O_CLOEXEC);
+
+        close(dir);
+
+        if (files->stat < 0 || files->status < 0) {
+            int err = errno;
+
+            if (files->stat >= 0) {
+                close(files->stat);
+            }
+            if (files->status >= 0) {
+                close(files->status);
+            }
+            if (files->io >= 0) {
+                close(files->io);
+            }
+
+            errno = err;
+
+            return false;
+        }
+
+        return true;
+    }
+
+    bool sample(ResourceHandle handle, ResourceSample *sample) {
+        long ticks = sysconf(_SC_CLK_TCK);
+
+        std::lock_guard<std::mutex> guard{procFilesLock};
+
+        auto it = procFiles.find(handle);
+        if (it == procFiles.end()) {
+            ProcFiles files{};
+            if (!openProcFiles(handle, &files)) {
+                return false;
+            }
+
+            it = procFiles.emplace(handle, files).first;
+        }
+
+        char buffer[SAMPLE_BUFFER_SIZE];
+
+        if (readProcFile(it->second.stat, buffer, sizeof(buffer)) < 0) {
+            return false;
+        }
+
+        // fields after the command name, which may itself contain spaces and parentheses
+        const char *fields = strrchr(buffer, ')');
+        if (fields == nullptr) {
+            errno = EINVAL;
+
+            return false;
+        }
+
+        int64_t userTicks = 0;
+        int64_t systemTicks = 0;
+        int64_t threads = 0;
+
+        char *cursor = const_cast<char *>(fields + 1);
+        for (int field = 3; field <= 20 && *cursor != 0; field++) {
+            int64_t value = strtoll(cursor, &cursor, 10);
+
+            if (field == 14) {
+                userTicks = value;
+            } else if (field == 15) {
+                systemTicks = value;
+            } else if (field == 20) {
+                threads = value;
+            }
+
+            // skip the state character, which strtoll cannot consume
+            if (field == 3) {
+                while (*cursor == ' ') {
+                    cursor++;
+                }
+                cursor++;
+            }
+        }
+
+        sample->userTimeMicros = userTicks * 1000000 / ticks;
+        sample->systemTimeMicros = systemTicks * 1000000 / ticks;
+        sample->threads = threads;
+
+        if (readProcFile(it->second.status, buffer, sizeof(buffer)) < 0) {
+            return false;
+        }
+
+        sample->residentKb = findValue(buffer, "VmRSS:");
+        sample->voluntarySwitches = findValue(buffer, "voluntary_ctxt_switches:");
+        sample->involuntarySwitches = findValue(buffer, "nonvoluntary_ctxt_switches:");
+
+        sample->readBytes = -1;
+        sample->writtenBytes = -1;
+        if (it->second.io >= 0 && readProcFile(it->second.io, buffer, sizeof(buffer)) >= 0) {
+            sample->readBytes = findValue(buffer, "read_bytes:");
+            sample->writtenBytes = findValue(buffer, "write_bytes:");
+        }
+
+        return true;
+    }
+
+    void forgetSamples(ResourceHandle handle) {
+        std::lock_guard<std::mutex> guard{procFilesLock};
+
+        auto it = procFiles.find(handle);
+        if (it != procFiles.end()) {
+            closeProcFiles(it->second);
+            procFiles.erase(it);
+        }
+    }
+}
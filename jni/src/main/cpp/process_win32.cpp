@@ -4,12 +4,29 @@
 
 #include <cstdlib>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <windows.h>
+#include <psapi.h>
 
 #define PIPE_BUFFER_SIZE 4096
 
 namespace process {
+    struct WatchContext {
+        std::mutex lock;
+        HANDLE process;
+        HANDLE wait;
+        std::function<void(int status, const ResourceUsage &usage)> exited;
+    };
+
+    static std::mutex boundJobsLock;
+    static std::map<HANDLE, HANDLE> boundJobs;
+
+    static int64_t fileTimeToMicros(const FILETIME &time) {
+        return ((static_cast<int64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10;
+    }
+
     static void closeHandle(HANDLE handle) {
         DWORD code = GetLastError();
         CloseHandle(handle);
@@ -65,27 +82,95 @@ namespace process {
         return true;
     }
 
-    bool create(
+    struct Template {
+        std::string path;
+        std::string commandLine;
+        std::string workingDir;
+        std::string environments;
+        std::vector<HANDLE> inherited;
+        DWORD priorityClass = 0;
+        DWORD_PTR affinity = 0;
+        bool bindToParent = false;
+
+        ~Template() {
+            for (HANDLE h: inherited) {
+                closeHandle(h);
+            }
+        }
+    };
+
+    Template *prepare(
             const std::string &path,
             const std::vector<std::string> &args,
             const std::string &workingDir,
             const std::vector<std::string> &environments,
-            ResourceHandle *handle,
-            ResourceHandle *fdStdin,
-            ResourceHandle *fdStdout,
-            ResourceHandle *fdStderr
+            const std::vector<InheritedHandle> &inherited,
+            const Placement *placement
     ) {
-        std::string joinedArgs;
+        std::unique_ptr<Template> prepared{new Template()};
+
+        prepared->path = path;
+        prepared->workingDir = workingDir;
+
         for (const auto &arg: args) {
-            joinedArgs += "\"" + arg + "\" ";
+            prepared->commandLine += "\"" + arg + "\" ";
         }
 
-        std::string joinedEnvs;
         for (const auto &env: environments) {
-            joinedEnvs += env;
-            joinedEnvs += std::string("\0", 1);
+            prepared->environments += env;
+            prepared->environments += std::string("\0", 1);
+        }
+
+        for (const auto &h: inherited) {
+            HANDLE duplicated;
+            if (!DuplicateHandle(GetCurrentProcess(), h.handle, GetCurrentProcess(), &duplicated, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+                return nullptr;
+            }
+
+            prepared->inherited.push_back(duplicated);
+        }
+
+        // cgroups, I/O priority, fd limits and THP have no Windows counterpart
+        if (placement != nullptr) {
+            prepared->bindToParent = placement->bindToParent;
+
+            if (placement->hasNice) {
+                if (placement->nice <= -15) {
+                    prepared->priorityClass = HIGH_PRIORITY_CLASS;
+                } else if (placement->nice <= -5) {
+                    prepared->priorityClass = ABOVE_NORMAL_PRIORITY_CLASS;
+                } else if (placement->nice < 5) {
+                    prepared->priorityClass = NORMAL_PRIORITY_CLASS;
+                } else if (placement->nice < 15) {
+                    prepared->priorityClass = BELOW_NORMAL_PRIORITY_CLASS;
+                } else {
+                    prepared->priorityClass = IDLE_PRIORITY_CLASS;
+                }
+            }
+
+            for (int cpu: placement->cpus) {
+                if (cpu < 0 || cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+                    SetLastError(ERROR_INVALID_PARAMETER);
+
+                    return nullptr;
+                }
+
+                prepared->affinity |= static_cast<DWORD_PTR>(1) << cpu;
+            }
         }
 
+        return prepared.release();
+    }
+
+    bool create(
+            const Template *prepared,
+            ResourceHandle *handle,
+            ResourceHandle *fdStdin,
+            ResourceHandle *fdStdout,
+            ResourceHandle *fdStderr
+    ) {
+        std::string commandLine = prepared->commandLine;
+
         utils::Scoped<HANDLE> stdinReadable{InvalidResourceHandle, closeHandle};
         utils::Scoped<HANDLE> stdinWritable{InvalidResourceHandle, closeHandle};
         if (fdStdin != nullptr) {
@@ -144,14 +229,26 @@ namespace process {
             childStderr = nul;
         }
 
-        HANDLE inheritHandles[3] = {childStdin, childStdout, childStderr};
+        std::vector<HANDLE> inheritHandles = {childStdin, childStdout, childStderr};
+
+        std::vector<utils::Scoped<HANDLE>> inheritedDuplicates;
+        inheritedDuplicates.reserve(prepared->inherited.size());
+        for (HANDLE h: prepared->inherited) {
+            HANDLE duplicated;
+            if (!DuplicateHandle(GetCurrentProcess(), h, GetCurrentProcess(), &duplicated, 0, TRUE, DUPLICATE_SAME_ACCESS)) {
+                return false;
+            }
+
+            inheritedDuplicates.emplace_back(duplicated, closeHandle);
+            inheritHandles.push_back(duplicated);
+        }
 
         WINBOOL attributeUpdated = UpdateProcThreadAttribute(
                 attributesList,
                 0,
                 PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
-                inheritHandles,
-                sizeof(inheritHandles),
+                inheritHandles.data(),
+                inheritHandles.size() * sizeof(HANDLE),
                 nullptr,
                 nullptr
         );
@@ -168,18 +265,36 @@ namespace process {
         si.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
         si.lpAttributeList = attributesList;
 
+        // A job that kills everything in it once its last handle is closed, the nearest thing to PDEATHSIG.
+        utils::Scoped<HANDLE> job{nullptr, closeHandle};
+        if (prepared->bindToParent) {
+            job = CreateJobObjectA(nullptr, nullptr);
+            if (job == nullptr) {
+                return false;
+            }
+
+            JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits;
+            memset(&limits, 0, sizeof(limits));
+            limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+            if (!SetInformationJobObject(job, JobObjectExtendedLimitInformation, &limits, sizeof(limits))) {
+                return false;
+            }
+        }
+
+        bool suspended = prepared->affinity != 0 || prepared->bindToParent;
+
         PROCESS_INFORMATION info;
         memset(&info, 0, sizeof(info));
 
         LRESULT r = CreateProcessA(
-                path.data(),
-                joinedArgs.data(),
+                prepared->path.data(),
+                commandLine.data(),
                 nullptr,
                 nullptr,
                 TRUE,
-                0,
-                joinedEnvs.data(),
-                workingDir.data(),
+                prepared->priorityClass | (suspended ? CREATE_SUSPENDED : 0),
+                const_cast<char *>(prepared->environments.data()),
+                prepared->workingDir.data(),
                 &si.StartupInfo,
                 &info
         );
@@ -187,6 +302,27 @@ namespace process {
             return false;
         }
 
+        if (suspended) {
+            bool placed = prepared->affinity == 0 || SetProcessAffinityMask(info.hProcess, prepared->affinity);
+            if (placed && prepared->bindToParent) {
+                placed = AssignProcessToJobObject(job, info.hProcess);
+            }
+
+            if (!placed) {
+                DWORD code = GetLastError();
+
+                TerminateProcess(info.hProcess, 255);
+                CloseHandle(info.hThread);
+                CloseHandle(info.hProcess);
+
+                SetLastError(code);
+
+                return false;
+            }
+
+            ResumeThread(info.hThread);
+        }
+
         if (fdStdin != nullptr) {
             *fdStdin = stdinWritable;
             stdinWritable = INVALID_HANDLE_VALUE;
@@ -201,6 +337,14 @@ namespace process {
         }
 
         CloseHandle(info.hThread);
+
+        if (prepared->bindToParent) {
+            std::lock_guard<std::mutex> guard{boundJobsLock};
+
+            boundJobs[info.hProcess] = job;
+            job = nullptr;
+        }
+
         SetLastError(ERROR_SUCCESS);
 
         *handle = info.hProcess;
@@ -217,11 +361,122 @@ namespace process {
         return (int) code;
     }
 
+    static VOID CALLBACK onProcessExited(PVOID parameter, BOOLEAN timedOut) {
+        auto context = static_cast<WatchContext *>(parameter);
+
+        std::unique_lock<std::mutex> guard{context->lock}; // wait for RegisterWaitForSingleObject to return
+
+        ResourceUsage usage{};
+
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if (GetProcessTimes(context->process, &creationTime, &exitTime, &kernelTime, &userTime)) {
+            usage.userTimeMicros = fileTimeToMicros(userTime);
+            usage.systemTimeMicros = fileTimeToMicros(kernelTime);
+        }
+
+        PROCESS_MEMORY_COUNTERS counters;
+        memset(&counters, 0, sizeof(counters));
+        counters.cb = sizeof(counters);
+        if (GetProcessMemoryInfo(context->process, &counters, sizeof(counters))) {
+            usage.maxResidentKb = static_cast<int64_t>(counters.PeakWorkingSetSize / 1024);
+            usage.minorFaults = counters.PageFaultCount;
+        }
+
+        int status = wait(context->process);
+
+        UnregisterWait(context->wait);
+        CloseHandle(context->process);
+
+        guard.unlock();
+
+        context->exited(status, usage);
+
+        delete context;
+    }
+
+    bool watch(ResourceHandle handle, const std::function<void(int status, const ResourceUsage &usage)> &exited) {
+        auto context = new WatchContext();
+        context->exited = exited;
+
+        std::unique_lock<std::mutex> guard{context->lock};
+
+        if (!DuplicateHandle(GetCurrentProcess(), handle, GetCurrentProcess(), &context->process, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+            guard.unlock();
+            delete context;
+
+            return false;
+        }
+
+        if (!RegisterWaitForSingleObject(&context->wait, context->process, onProcessExited, context, INFINITE, WT_EXECUTEONLYONCE)) {
+            guard.unlock();
+            closeHandle(context->process);
+            delete context;
+
+            return false;
+        }
+
+        return true;
+    }
+
+    void release(Template *prepared) {
+        delete prepared;
+    }
+
+    bool startHelper() {
+        return true;
+    }
+
+    bool sample(ResourceHandle handle, ResourceSample *sample) {
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if (!GetProcessTimes(handle, &creationTime, &exitTime, &kernelTime, &userTime)) {
+            return false;
+        }
+
+        PROCESS_MEMORY_COUNTERS memory{};
+        memory.cb = sizeof(memory);
+        if (!GetProcessMemoryInfo(handle, &memory, sizeof(memory))) {
+            return false;
+        }
+
+        IO_COUNTERS io{};
+        if (!GetProcessIoCounters(handle, &io)) {
+            return false;
+        }
+
+        // context switches and thread counts need a system-wide snapshot, too costly for sampling
+        sample->userTimeMicros = fileTimeToMicros(userTime);
+        sample->systemTimeMicros = fileTimeToMicros(kernelTime);
+        sample->residentKb = static_cast<int64_t>(memory.WorkingSetSize / 1024);
+        sample->voluntarySwitches = -1;
+        sample->involuntarySwitches = -1;
+        sample->readBytes = static_cast<int64_t>(io.ReadTransferCount);
+        sample->writtenBytes = static_cast<int64_t>(io.WriteTransferCount);
+        sample->threads = -1;
+
+        return true;
+    }
+
     void terminate(ResourceHandle handle) {
         TerminateProcess(handle, 255);
     }
 
+    void terminate(ResourceHandle handle, int64_t graceMillis) {
+        // a console-less child has no polite stop request that it is guaranteed to receive
+        terminate(handle);
+    }
+
     void release(ResourceHandle handle) {
+        {
+            std::lock_guard<std::mutex> guard{boundJobsLock};
+
+            auto it = boundJobs.find(handle);
+            if (it != boundJobs.end()) {
+                CloseHandle(it->second);
+
+                boundJobs.erase(it);
+            }
+        }
+
         CloseHandle(handle);
     }
 }
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "process.hpp"
+
+#include <string>
+#include <cstdint>
+#include <functional>
+
+namespace readiness {
+    // The core is ready once every configured probe has passed.
+    struct Probes {
+        std::string marker;     // stdout contains this, empty to skip
+        int port;               // the core listens on this TCP port, 0 for any port, -1 to skip
+        std::string unixSocket; // the core listens on this unix socket path, empty to skip
+        int64_t timeoutMillis;  // non-positive waits until the core exits
+    };
+
+    // Called exactly once: ready, or not ready because the core exited, timed out or a probe failed.
+    using Callback = std::function<void(bool ready)>;
+
+    // Never calls back when it fails.
+    // With a marker, *fdStdout is replaced by a pipe that receives the same bytes once they have been scanned.
+    bool watch(
+            process::ResourceHandle handle,
+            const Probes &probes,
+            process::ResourceHandle *fdStdout,
+            const Callback &callback
+    );
+}
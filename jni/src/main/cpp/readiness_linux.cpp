@@ -0,0 +1,553 @@
+#include "readiness.hpp"
+
+#include "looper.hpp"
+#include "process_linux.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+
+#define POLL_INTERVAL_MILLIS 20
+#define PUMP_CHUNK_SIZE (16 * 1024)
+#define DIAG_BUFFER_SIZE (16 * 1024)
+
+namespace readiness {
+    struct State {
+        std::mutex lock;
+        bool fired = false;
+        pid_t pid = -1;
+
+        std::string marker;
+        bool markerPending = false;
+        std::string markerTail;
+
+        int port = -1;
+        bool portPending = false;
+        int fdDiag = -1;
+
+        std::string unixSocket;
+        bool unixSocketPending = false;
+        int fdInotify = -1;
+
+        int fdExited = -1;
+        int fdTimeout = -1;
+        int fdPoll = -1;
+
+        Callback callback;
+    };
+
+    struct Pump {
+        std::shared_ptr<State> state;
+        int source;
+        int sink;
+        std::string pending;
+    };
+
+    static void closeWatched(int &fd) {
+        if (fd >= 0) {
+            looper::unwatch(fd);
+            close(fd);
+
+            fd = -1;
+        }
+    }
+
+    static void fire(const std::shared_ptr<State> &state, bool ready) {
+        Callback callback;
+        {
+            std::lock_guard<std::mutex> guard{state->lock};
+
+            if (state->fired) {
+                return;
+            }
+
+            state->fired = true;
+
+            closeWatched(state->fdExited);
+            closeWatched(state->fdTimeout);
+            closeWatched(state->fdPoll);
+            closeWatched(state->fdInotify);
+
+            if (state->fdDiag >= 0) {
+                close(state->fdDiag);
+                state->fdDiag = -1;
+            }
+
+            callback = std::move(state->callback);
+        }
+
+        callback(ready);
+    }
+
+    // Must be called with the lock held.
+    static bool passed(const State &state) {
+        return !state.fired && !state.markerPending && !state.portPending && !state.unixSocketPending;
+    }
+
+    static bool ownsSocket(pid_t pid, uint32_t inode) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/fd", static_cast<int>(pid));
+
+        DIR *dir = opendir(path);
+        if (dir == nullptr) {
+            return false;
+        }
+
+        char expected[32];
+        snprintf(expected, sizeof(expected), "socket:[%u]", inode);
+
+        bool owned = false;
+        while (dirent *entry = readdir(dir)) {
+            char target[32];
+            ssize_t n = readlinkat(dirfd(dir), entry->d_name, target, sizeof(target) - 1);
+            if (n > 0) {
+                target[n] = 0;
+
+                if (strcmp(target, expected) == 0) {
+                    owned = true;
+                    break;
+                }
+            }
+        }
+
+        closedir(dir);
+
+        return owned;
+    }
+
+    static bool queryListening(int fdDiag, uint8_t family, int port, std::vector<uint32_t> &inodes) {
+        struct {
+            nlmsghdr header;
+            inet_diag_req_v2 request;
+        } message{};
+
+        message.header.nlmsg_len = sizeof(message);
+        message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+        message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+        message.request.sdiag_family = family;
+        message.request.sdiag_protocol = IPPROTO_TCP;
+        message.request.idiag_states = 1u << TCP_LISTEN;
+
+        if (send(fdDiag, &message, sizeof(message), 0) < 0) {
+            return false;
+        }
+
+        alignas(nlmsghdr) char buffer[DIAG_BUFFER_SIZE];
+        while (true) {
+            ssize_t n = recv(fdDiag, buffer, sizeof(buffer), 0);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                return false;
+            }
+
+            auto header = reinterpret_cast<nlmsghdr *>(buffer);
+            for (auto remaining = static_cast<unsigned int>(n); NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+                if (header->nlmsg_type == NLMSG_DONE) {
+                    return true;
+                }
+
+                if (header->nlmsg_type == NLMSG_ERROR) {
+                    errno = -static_cast<nlmsgerr *>(NLMSG_DATA(header))->error;
+
+                    return false;
+                }
+
+                auto diag = static_cast<inet_diag_msg *>(NLMSG_DATA(header));
+                if (port == 0 || ntohs(diag->id.idiag_sport) == port) {
+                    inodes.push_back(diag->idiag_inode);
+                }
+            }
+        }
+    }
+
+    static bool probeListening(State &state) {
+        std::vector<uint32_t> inodes;
+        if (!queryListening(state.fdDiag, AF_INET, state.port, inodes) ||
+            !queryListening(state.fdDiag, AF_INET6, state.port, inodes)) {
+            return false;
+        }
+
+        for (uint32_t inode: inodes) {
+            if (ownsSocket(state.pid, inode)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static bool probeUnixSocket(const State &state) {
+        struct stat st{};
+        if (stat(state.unixSocket.data(), &st) < 0 || !S_ISSOCK(st.st_mode)) {
+            return false;
+        }
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, state.unixSocket.data(), sizeof(address.sun_path) - 1);
+
+        // a socket that is bound but not yet listening refuses connections
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd < 0) {
+            return false;
+        }
+
+        bool connected = connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 || errno == EAGAIN;
+
+        close(fd);
+
+        return connected;
+    }
+
+    static void probe(const std::shared_ptr<State> &state) {
+        bool ready;
+        {
+            std::lock_guard<std::mutex> guard{state->lock};
+
+            if (state->fired) {
+                return;
+            }
+
+            if (state->portPending && probeListening(*state)) {
+                state->portPending = false;
+            }
+
+            if (state->unixSocketPending && probeUnixSocket(*state)) {
+                state->unixSocketPending = false;
+            }
+
+            ready = passed(*state);
+        }
+
+        if (ready) {
+            fire(state, true);
+        }
+    }
+
+    static void scanMarker(const std::shared_ptr<State> &state, const char *data, size_t length) {
+        bool ready;
+        {
+            std::lock_guard<std::mutex> guard{state->lock};
+
+            if (!state->markerPending) {
+                return;
+            }
+
+            std::string &tail = state->markerTail;
+            tail.append(data, length);
+
+            if (tail.find(state->marker) != std::string::npos) {
+                state->markerPending = false;
+                tail.clear();
+                tail.shrink_to_fit();
+            } else if (tail.size() >= state->marker.size()) {
+                tail.erase(0, tail.size() - state->marker.size() + 1);
+            }
+
+            ready = passed(*state);
+        }
+
+        if (ready) {
+            fire(state, true);
+        }
+    }
+
+    static void finishPump(const std::shared_ptr<Pump> &pump) {
+        looper::unwatch(pump->source);
+        looper::unwatch(pump->sink);
+        close(pump->source);
+        close(pump->sink);
+    }
+
+    static void watchSource(const std::shared_ptr<Pump> &pump);
+
+    static void waitSink(const std::shared_ptr<Pump> &pump) {
+        looper::unwatch(pump->source);
+
+        bool watched = looper::watch(pump->sink, EPOLLOUT, [pump](uint32_t events) {
+            if (events & EPOLLERR) {
+                finishPump(pump);
+
+                return;
+            }
+
+            while (!pump->pending.empty()) {
+                ssize_t n = write(pump->sink, pump->pending.data(), pump->pending.size());
+                if (n < 0) {
+                    if (errno == EAGAIN) {
+                        return;
+                    }
+
+                    finishPump(pump);
+
+                    return;
+                }
+
+                pump->pending.erase(0, n);
+            }
+
+            looper::unwatch(pump->sink);
+
+            watchSource(pump);
+        });
+        if (!watched) {
+            finishPump(pump);
+        }
+    }
+
+    // Scans the output until the marker shows up and forwards it unchanged, zero-copy once scanning is over.
+    static void pumpSource(const std::shared_ptr<Pump> &pump) {
+        bool scanning;
+        {
+            std::lock_guard<std::mutex> guard{pump->state->lock};
+
+            scanning = pump->state->markerPending;
+        }
+
+        if (!scanning) {
+            ssize_t n = splice(pump->source, nullptr, pump->sink, nullptr, PUMP_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n == 0 || (n < 0 && errno != EAGAIN)) {
+                finishPump(pump);
+            } else if (n < 0) {
+                waitSink(pump); // the source is readable, so the sink is full
+            }
+
+            return;
+        }
+
+        char buffer[PUMP_CHUNK_SIZE];
+        ssize_t n = read(pump->source, buffer, sizeof(buffer));
+        if (n <= 0) {
+            if (n == 0 || errno != EAGAIN) {
+                finishPump(pump);
+
+                fire(pump->state, false); // the marker can no longer show up
+            }
+
+            return;
+        }
+
+        scanMarker(pump->state, buffer, n);
+
+        ssize_t written = write(pump->sink, buffer, n);
+        if (written < 0 && errno != EAGAIN) {
+            finishPump(pump);
+
+            return;
+        }
+
+        written = std::max<ssize_t>(written, 0);
+        if (written < n) {
+            pump->pending.assign(buffer + written, n - written);
+
+            waitSink(pump);
+        }
+    }
+
+    static void watchSource(const std::shared_ptr<Pump> &pump) {
+        if (!looper::watch(pump->source, EPOLLIN, [pump](uint32_t events) { pumpSource(pump); })) {
+            finishPump(pump);
+        }
+    }
+
+    static bool startPump(const std::shared_ptr<State> &state, int *fdStdout) {
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) < 0) {
+            return false;
+        }
+
+        int flags = fcntl(*fdStdout, F_GETFL);
+        fcntl(*fdStdout, F_SETFL, flags | O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+        auto pump = std::make_shared<Pump>();
+        pump->state = state;
+        pump->source = *fdStdout;
+        pump->sink = fds[1];
+
+        // on failure stdout is left as it was
+        if (!looper::watch(pump->source, EPOLLIN, [pump](uint32_t events) { pumpSource(pump); })) {
+            int err = errno;
+
+            fcntl(*fdStdout, F_SETFL, flags);
+            close(fds[0]);
+            close(fds[1]);
+
+            errno = err;
+
+            return false;
+        }
+
+        *fdStdout = fds[0];
+
+        return true;
+    }
+
+    // Expires after millis, or right away when immediate, then every millis when periodic.
+    static int createTimer(int64_t millis, bool periodic, bool immediate) {
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (fd < 0) {
+            return -1;
+        }
+
+        itimerspec spec{};
+        spec.it_value.tv_sec = millis / 1000;
+        spec.it_value.tv_nsec = (millis % 1000) * 1000000;
+        if (periodic) {
+            spec.it_interval = spec.it_value;
+        }
+        if (immediate) {
+            spec.it_value.tv_sec = 0;
+            spec.it_value.tv_nsec = 1; // zero would disarm it
+        }
+
+        if (timerfd_settime(fd, 0, &spec, nullptr) < 0) {
+            close(fd);
+
+            return -1;
+        }
+
+        return fd;
+    }
+
+    static bool arm(const std::shared_ptr<State> &state, int handle, const Probes &probes) {
+        state->fdExited = fcntl(handle, F_DUPFD_CLOEXEC, 0);
+        if (state->fdExited < 0 || !looper::watch(state->fdExited, EPOLLIN, [state](uint32_t) { fire(state, false); })) {
+            return false;
+        }
+
+        if (probes.timeoutMillis > 0) {
+            state->fdTimeout = createTimer(probes.timeoutMillis, false, false);
+            if (state->fdTimeout < 0 || !looper::watch(state->fdTimeout, EPOLLIN, [state](uint32_t) { fire(state, false); })) {
+                return false;
+            }
+        }
+
+        if (state->portPending) {
+            state->fdDiag = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+            if (state->fdDiag < 0) {
+                return false;
+            }
+        }
+
+        if (state->unixSocketPending) {
+            std::string dir = probes.unixSocket.substr(0, probes.unixSocket.find_last_of('/') + 1);
+
+            state->fdInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (state->fdInotify < 0 || inotify_add_watch(state->fdInotify, dir.empty() ? "." : dir.data(), IN_CREATE | IN_MOVED_TO) < 0) {
+                return false;
+            }
+
+            bool watched = looper::watch(state->fdInotify, EPOLLIN, [state](uint32_t) {
+                char events[4096];
+                {
+                    std::lock_guard<std::mutex> guard{state->lock};
+
+                    while (state->fdInotify >= 0 && read(state->fdInotify, events, sizeof(events)) > 0);
+                }
+
+                probe(state);
+            });
+            if (!watched) {
+                return false;
+            }
+        }
+
+        // No notification covers listen() itself, so both are also polled. The first check runs right away,
+        // the core may already be up, but on the looper: the callback must not run on the caller's thread.
+        state->fdPoll = createTimer(POLL_INTERVAL_MILLIS, state->portPending || state->unixSocketPending, true);
+
+        bool watched = state->fdPoll >= 0 && looper::watch(state->fdPoll, EPOLLIN, [state](uint32_t) {
+            uint64_t expirations;
+            {
+                std::lock_guard<std::mutex> guard{state->lock};
+
+                if (state->fdPoll >= 0 && read(state->fdPoll, &expirations, sizeof(expirations)) < 0) {
+                    return;
+                }
+            }
+
+            probe(state);
+        });
+        if (!watched) {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool watch(
+            process::ResourceHandle handle,
+            const Probes &probes,
+            process::ResourceHandle *fdStdout,
+            const Callback &callback
+    ) {
+        auto state = std::make_shared<State>();
+        state->pid = process::pidOf(handle);
+        state->marker = probes.marker;
+        state->markerPending = !probes.marker.empty();
+        state->port = probes.port;
+        state->portPending = probes.port >= 0;
+        state->unixSocket = probes.unixSocket;
+        state->unixSocketPending = !probes.unixSocket.empty();
+        state->callback = callback;
+
+        if (state->pid < 0) {
+            return false;
+        }
+
+        if (state->markerPending && (fdStdout == nullptr || *fdStdout < 0)) {
+            errno = EBADF;
+
+            return false;
+        }
+
+        bool armed;
+        {
+            std::lock_guard<std::mutex> guard{state->lock};
+
+            // Interposed last, so that nothing is left to undo on stdout. Nothing fires before the lock is released.
+            armed = arm(state, handle, probes) && (!state->markerPending || startPump(state, fdStdout));
+            if (!armed) {
+                int err = errno;
+
+                state->fired = true;
+
+                closeWatched(state->fdExited);
+                closeWatched(state->fdTimeout);
+                closeWatched(state->fdPoll);
+                closeWatched(state->fdInotify);
+
+                if (state->fdDiag >= 0) {
+                    close(state->fdDiag);
+                }
+
+                errno = err;
+            }
+        }
+
+        return armed;
+    }
+}
@@ -0,0 +1,137 @@
+#include "readiness.hpp"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <windows.h>
+
+#define PUMP_BUFFER_SIZE 4096
+
+namespace readiness {
+    struct State {
+        std::mutex lock;
+        bool fired = false;
+        std::string marker;
+        std::string markerTail;
+        HANDLE process = nullptr;
+        HANDLE wait = nullptr;
+        Callback callback;
+
+        ~State() {
+            if (wait != nullptr) {
+                UnregisterWait(wait);
+            }
+            if (process != nullptr) {
+                CloseHandle(process);
+            }
+        }
+    };
+
+    static void fire(const std::shared_ptr<State> &state, bool ready) {
+        Callback callback;
+        {
+            std::lock_guard<std::mutex> guard{state->lock};
+
+            if (state->fired) {
+                return;
+            }
+
+            state->fired = true;
+            callback = std::move(state->callback);
+        }
+
+        callback(ready);
+    }
+
+    static void pump(std::shared_ptr<State> state, HANDLE source, HANDLE sink) {
+        std::unique_ptr<char[]> buffer{new char[PUMP_BUFFER_SIZE]};
+
+        bool scanning = true;
+
+        DWORD n = 0;
+        while (ReadFile(source, buffer.get(), PUMP_BUFFER_SIZE, &n, nullptr) && n > 0) {
+            if (scanning) {
+                std::string &tail = state->markerTail;
+                tail.append(buffer.get(), n);
+
+                if (tail.find(state->marker) != std::string::npos) {
+                    scanning = false;
+                    tail.clear();
+
+                    fire(state, true);
+                } else if (tail.size() >= state->marker.size()) {
+                    tail.erase(0, tail.size() - state->marker.size() + 1);
+                }
+            }
+
+            DWORD written = 0;
+            if (!WriteFile(sink, buffer.get(), n, &written, nullptr)) {
+                break;
+            }
+        }
+
+        CloseHandle(source);
+        CloseHandle(sink);
+
+        fire(state, false);
+    }
+
+    static VOID CALLBACK onExitedOrTimeout(PVOID parameter, BOOLEAN timedOut) {
+        auto state = static_cast<std::shared_ptr<State> *>(parameter);
+
+        fire(*state, false);
+
+        delete state; // runs once, the process either exits or the timeout elapses
+    }
+
+    bool watch(
+            process::ResourceHandle handle,
+            const Probes &probes,
+            process::ResourceHandle *fdStdout,
+            const Callback &callback
+    ) {
+        // the TCP table and named pipes would need their own probes, the marker covers the core
+        if (probes.port >= 0 || !probes.unixSocket.empty() || probes.marker.empty()) {
+            SetLastError(ERROR_NOT_SUPPORTED);
+
+            return false;
+        }
+
+        if (fdStdout == nullptr || *fdStdout == INVALID_HANDLE_VALUE) {
+            SetLastError(ERROR_INVALID_HANDLE);
+
+            return false;
+        }
+
+        auto state = std::make_shared<State>();
+        state->marker = probes.marker;
+        state->callback = callback;
+
+        if (!DuplicateHandle(GetCurrentProcess(), handle, GetCurrentProcess(), &state->process, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+            return false;
+        }
+
+        HANDLE readable, writable;
+        if (!CreatePipe(&readable, &writable, nullptr, PUMP_BUFFER_SIZE)) {
+            return false;
+        }
+
+        auto reference = new std::shared_ptr<State>(state);
+
+        DWORD timeout = probes.timeoutMillis > 0 ? static_cast<DWORD>(probes.timeoutMillis) : INFINITE;
+        if (!RegisterWaitForSingleObject(&state->wait, state->process, onExitedOrTimeout, reference, timeout, WT_EXECUTEONLYONCE)) {
+            CloseHandle(readable);
+            CloseHandle(writable);
+
+            delete reference;
+
+            return false;
+        }
+
+        std::thread{pump, state, *fdStdout, writable}.detach();
+
+        *fdStdout = readable;
+
+        return true;
+    }
+}
@@ -0,0 +1,210 @@
+#include "routes.hpp"
+
+#include "jniutils.hpp"
+#include "os.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#define MAIN_TABLE 254
+#define INET6_DEFAULT_METRIC 1024
+
+namespace routes {
+    // Only the fields that apply to the kind, with the defaults the kernel fills in, so that
+    // a planned entry compares equal to what reading it back returns.
+    static Entry canonical(const Entry &entry) {
+        Entry result{};
+        result.kind = entry.kind;
+
+        if (entry.kind == KIND_LINK) {
+            result.interface = entry.interface;
+
+            return result;
+        }
+
+        result.family = entry.family;
+        size_t addressLength = entry.family == FAMILY_INET6 ? 16 : 4;
+
+        switch (entry.kind) {
+            case KIND_ADDRESS:
+                result.prefixLength = entry.prefixLength;
+                result.interface = entry.interface;
+                memcpy(result.address, entry.address, addressLength);
+                break;
+            case KIND_ROUTE:
+                result.prefixLength = entry.prefixLength;
+                result.type = entry.type != 0 ? entry.type : TYPE_UNICAST;
+                result.table = entry.table != 0 ? entry.table : MAIN_TABLE;
+                result.priority = entry.priority;
+                if (result.priority == 0 && entry.family == FAMILY_INET6) {
+                    result.priority = INET6_DEFAULT_METRIC;
+                }
+                memcpy(result.address, entry.address, addressLength);
+
+                // rejecting routes have no next hop, IPv6 reports them on the loopback
+                if (result.type == TYPE_UNICAST) {
+                    result.interface = entry.interface;
+                    memcpy(result.gateway, entry.gateway, addressLength);
+                }
+                break;
+            case KIND_RULE:
+                result.prefixLength = entry.prefixLength;
+                result.type = entry.type != 0 ? entry.type : TYPE_LOOKUP;
+                result.flags = entry.flags & FLAG_INVERT;
+                result.priority = entry.priority;
+                result.fwmark = entry.fwmark;
+                result.fwmask = entry.fwmark != 0 && entry.fwmask == 0 ? UINT32_MAX : entry.fwmask;
+                result.suppressPrefixLength = entry.suppressPrefixLength;
+                memcpy(result.address, entry.address, addressLength);
+
+                if (result.type == TYPE_LOOKUP) {
+                    result.table = entry.table != 0 ? entry.table : MAIN_TABLE;
+                }
+                break;
+            default:
+                break;
+        }
+
+        return result;
+    }
+
+    static bool less(const Entry &a, const Entry &b) {
+        return memcmp(&a, &b, sizeof(Entry)) < 0;
+    }
+
+    static bool equal(const Entry &a, const Entry &b) {
+        return memcmp(&a, &b, sizeof(Entry)) == 0;
+    }
+
+    // Sorted and unique, plans with thousands of bypass routes are common. Unknown kinds are left out.
+    static std::vector<Entry> canonicalSet(const std::vector<Entry> &entries) {
+        std::vector<Entry> result;
+        result.reserve(entries.size());
+        for (const Entry &entry: entries) {
+            if (entry.kind >= KIND_LINK && entry.kind <= KIND_RULE) {
+                result.push_back(canonical(entry));
+            }
+        }
+
+        std::sort(result.begin(), result.end(), less);
+        result.erase(std::unique(result.begin(), result.end(), equal), result.end());
+
+        return result;
+    }
+
+    static bool contains(const std::vector<Entry> &set, const Entry &entry) {
+        return std::binary_search(set.begin(), set.end(), entry, less);
+    }
+
+    std::vector<Entry> diff(const std::vector<Entry> &current, const std::vector<Entry> &plan) {
+        std::vector<Entry> currentSet = canonicalSet(current);
+        std::vector<Entry> planSet = canonicalSet(plan);
+
+        std::vector<Entry> changes;
+
+        // links are never taken down, they only show up in current when planned
+        for (Kind kind: {KIND_RULE, KIND_ROUTE, KIND_ADDRESS}) {
+            for (const Entry &entry: currentSet) {
+                if (entry.kind == kind && !contains(planSet, entry)) {
+                    changes.push_back(entry);
+                    changes.back().operation = OPERATION_DELETE;
+                }
+            }
+        }
+
+        for (Kind kind: {KIND_LINK, KIND_ADDRESS, KIND_ROUTE, KIND_RULE}) {
+            for (const Entry &entry: planSet) {
+                if (entry.kind == kind && !contains(currentSet, entry)) {
+                    changes.push_back(entry);
+                    changes.back().operation = OPERATION_ADD;
+                }
+            }
+        }
+
+        return changes;
+    }
+
+    static std::vector<Entry> entriesFromJava(JNIEnv *env, jbyteArray entries) {
+        std::vector<Entry> result(static_cast<size_t>(env->GetArrayLength(entries)) / sizeof(Entry));
+
+        env->GetByteArrayRegion(
+                entries,
+                0,
+                static_cast<jsize>(result.size() * sizeof(Entry)),
+                reinterpret_cast<jbyte *>(result.data())
+        );
+
+        return result;
+    }
+
+    static jbyteArray entriesToJava(JNIEnv *env, const std::vector<Entry> &entries) {
+        auto length = static_cast<jsize>(entries.size() * sizeof(Entry));
+
+        jbyteArray result = env->NewByteArray(length);
+        env->SetByteArrayRegion(result, 0, length, reinterpret_cast<const jbyte *>(entries.data()));
+
+        return result;
+    }
+
+    static jbyteArray jniReadRoutes(JNIEnv *env, jclass clazz, jbyteArray plan, jint protocol) {
+        std::vector<Entry> current;
+        if (!routes::read(static_cast<uint8_t>(protocol), entriesFromJava(env, plan), &current)) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return nullptr;
+        }
+
+        return entriesToJava(env, current);
+    }
+
+    static jbyteArray jniApplyRoutes(JNIEnv *env, jclass clazz, jbyteArray plan, jint protocol, jboolean dryRun) {
+        std::vector<Entry> cPlan = entriesFromJava(env, plan);
+
+        std::vector<Entry> current;
+        bool applied = routes::read(static_cast<uint8_t>(protocol), cPlan, &current);
+
+        std::vector<Entry> changes;
+        if (applied) {
+            changes = routes::diff(current, cPlan);
+            applied = dryRun || routes::apply(static_cast<uint8_t>(protocol), changes);
+        }
+
+        if (!applied) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return nullptr;
+        }
+
+        return entriesToJava(env, changes);
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cRoutes = env->FindClass("com/github/kr328/clash/compat/RoutesCompat");
+        if (cRoutes == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeReadRoutes"),
+                        .signature = const_cast<char *>("([BI)[B"),
+                        .fnPtr = reinterpret_cast<void *>(&jniReadRoutes),
+                },
+                {
+                        .name = const_cast<char *>("nativeApplyRoutes"),
+                        .signature = const_cast<char *>("([BIZ)[B"),
+                        .fnPtr = reinterpret_cast<void *>(&jniApplyRoutes),
+                },
+        };
+
+        if (env->RegisterNatives(cRoutes, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
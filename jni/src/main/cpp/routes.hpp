@@ -0,0 +1,70 @@
+#pragma once
+
+#include <jni.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace routes {
+    enum Kind : uint8_t {
+        KIND_LINK = 1,    // interface is up
+        KIND_ADDRESS = 2,
+        KIND_ROUTE = 3,
+        KIND_RULE = 4,
+    };
+
+    enum Operation : uint8_t {
+        OPERATION_NONE = 0,
+        OPERATION_ADD = 1,
+        OPERATION_DELETE = 2,
+    };
+
+    static const uint8_t FAMILY_INET4 = 4;
+    static const uint8_t FAMILY_INET6 = 6;
+
+    // Route types and rule actions share their numbers in the kernel.
+    static const uint8_t TYPE_UNICAST = 1;     // routes only, rules look up table instead
+    static const uint8_t TYPE_LOOKUP = 1;
+    static const uint8_t TYPE_BLACKHOLE = 6;
+    static const uint8_t TYPE_UNREACHABLE = 7;
+    static const uint8_t TYPE_PROHIBIT = 8;
+    static const uint8_t TYPE_THROW = 9;       // routes only
+
+    static const uint8_t FLAG_INVERT = 1;      // rules match when their selectors do not
+
+    // One step of a routing plan, also used for changes and read back state. Fields that do not apply
+    // to a kind are ignored. Shared with Java as is.
+    struct Entry {
+        uint8_t kind;
+        uint8_t operation;            // changes only
+        uint8_t family;               // FAMILY_*, unused for links
+        uint8_t prefixLength;         // address, route destination, rule source
+        uint8_t type;                 // TYPE_*, routes and rules
+        uint8_t flags;                // FLAG_*, rules
+        uint16_t reserved;
+        int32_t interface;            // ifindex of links, addresses and unicast routes, 0 for none
+        uint32_t table;               // routes and rules, 0 for main
+        uint32_t priority;            // route metric, rule priority
+        uint32_t fwmark;              // rules
+        uint32_t fwmask;              // rules, 0 with a fwmark matches all bits
+        int32_t suppressPrefixLength; // rules, -1 for none
+        uint8_t address[16];          // address, route destination, rule source
+        uint8_t gateway[16];          // routes, all zero for none
+    };
+
+    static_assert(sizeof(Entry) == 64, "entry layout is shared with Java");
+
+    bool initialize(JNIEnv *env);
+
+    // Reads what a plan would change: routes and rules tagged with protocol, addresses on the interfaces
+    // plan assigns addresses to, and the state of the interfaces plan brings up.
+    bool read(uint8_t protocol, const std::vector<Entry> &plan, std::vector<Entry> *current);
+    // The changes turning current into plan, deletions first and rules last, so that traffic is only
+    // steered into a table once its routes exist.
+    std::vector<Entry> diff(const std::vector<Entry> &current, const std::vector<Entry> &plan);
+    // Sends all changes in as few writes as possible, routes and rules tagged with protocol. Changes that
+    // are already in place count as applied. If one fails, the applied ones are rolled back. Unknown kinds
+    // and operations fail with EINVAL before anything is sent.
+    bool apply(uint8_t protocol, const std::vector<Entry> &changes);
+}
@@ -0,0 +1,554 @@
+#include "routes.hpp"
+
+#include <algorithm>
+#include <set>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/fib_rules.h>
+#include <linux/if_addr.h>
+
+#define MAX_BATCH_SIZE (32 * 1024)
+#define MAX_BATCH_MESSAGES 128
+#define RECEIVE_BUFFER_SIZE (64 * 1024)
+#define SOCKET_RECEIVE_BUFFER_SIZE (1024 * 1024)
+#define MIN_PROTOCOL (RTPROT_STATIC + 1)
+
+namespace routes {
+    static int socketFamily(uint8_t family) {
+        return family == FAMILY_INET6 ? AF_INET6 : AF_INET;
+    }
+
+    static size_t addressLength(uint8_t family) {
+        return family == FAMILY_INET6 ? 16 : 4;
+    }
+
+    static bool isZero(const uint8_t *address, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            if (address[i] != 0) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static int openSocket() {
+        int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (fd < 0) {
+            return -1;
+        }
+
+        // errors come back without the request they answer
+        int enabled = 1;
+        setsockopt(fd, SOL_NETLINK, NETLINK_CAP_ACK, &enabled, sizeof(enabled));
+
+        // every acknowledgement of a batch is queued before the first is read, the kernel caps this
+        int receiveBuffer = SOCKET_RECEIVE_BUFFER_SIZE;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+
+        sockaddr_nl address{};
+        address.nl_family = AF_NETLINK;
+        if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            int err = errno;
+            close(fd);
+            errno = err;
+
+            return -1;
+        }
+
+        return fd;
+    }
+
+    // Appends a message with header and body, returns its offset for attribute and finish.
+    static size_t begin(std::vector<char> &batch, uint16_t type, uint16_t flags, uint32_t seq, const void *body, size_t length) {
+        size_t offset = batch.size();
+        batch.resize(offset + NLMSG_SPACE(length));
+
+        auto header = reinterpret_cast<nlmsghdr *>(batch.data() + offset);
+        header->nlmsg_type = type;
+        header->nlmsg_flags = flags;
+        header->nlmsg_seq = seq;
+        memcpy(NLMSG_DATA(header), body, length);
+
+        return offset;
+    }
+
+    static void attribute(std::vector<char> &batch, uint16_t type, const void *data, size_t length) {
+        size_t offset = batch.size();
+        batch.resize(offset + RTA_SPACE(length));
+
+        auto attr = reinterpret_cast<rtattr *>(batch.data() + offset);
+        attr->rta_type = type;
+        attr->rta_len = static_cast<unsigned short>(RTA_LENGTH(length));
+        memcpy(RTA_DATA(attr), data, length);
+    }
+
+    static void attribute32(std::vector<char> &batch, uint16_t type, uint32_t value) {
+        attribute(batch, type, &value, sizeof(value));
+    }
+
+    static void finish(std::vector<char> &batch, size_t offset) {
+        reinterpret_cast<nlmsghdr *>(batch.data() + offset)->nlmsg_len = static_cast<uint32_t>(batch.size() - offset);
+    }
+
+    // Every attribute of a message, indexed by type, nullptr where absent.
+    template<size_t N>
+    static void attributes(rtattr *attr, int length, const rtattr *(&found)[N]) {
+        for (const rtattr *&f: found) {
+            f = nullptr;
+        }
+
+        for (; RTA_OK(attr, length); attr = RTA_NEXT(attr, length)) {
+            if (attr->rta_type < N) {
+                found[attr->rta_type] = attr;
+            }
+        }
+    }
+
+    static uint32_t read32(const rtattr *attr, uint32_t fallback) {
+        if (attr == nullptr || RTA_PAYLOAD(attr) < sizeof(uint32_t)) {
+            return fallback;
+        }
+
+        uint32_t value;
+        memcpy(&value, RTA_DATA(attr), sizeof(value));
+
+        return value;
+    }
+
+    static void readAddress(const rtattr *attr, uint8_t family, uint8_t *address) {
+        if (attr != nullptr && RTA_PAYLOAD(attr) >= addressLength(family)) {
+            memcpy(address, RTA_DATA(attr), addressLength(family));
+        }
+    }
+
+    static bool receiveAll(int fd, std::vector<char> &buffer, size_t *length) {
+        while (true) {
+            ssize_t r = recv(fd, buffer.data(), buffer.size(), 0);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            } else if (r < 0) {
+                return false;
+            }
+
+            *length = static_cast<size_t>(r);
+
+            return true;
+        }
+    }
+
+    // Sends a dump request and calls parse with every reply until the dump is done.
+    template<typename Body, typename Parse>
+    static bool dump(int fd, uint16_t type, const Body &body, uint32_t seq, Parse parse) {
+        std::vector<char> request;
+        size_t offset = begin(request, type, NLM_F_REQUEST | NLM_F_DUMP, seq, &body, sizeof(body));
+        finish(request, offset);
+
+        if (::send(fd, request.data(), request.size(), 0) < 0) {
+            return false;
+        }
+
+        std::vector<char> buffer(RECEIVE_BUFFER_SIZE);
+        while (true) {
+            size_t length = 0;
+            if (!receiveAll(fd, buffer, &length)) {
+                return false;
+            }
+
+            auto header = reinterpret_cast<nlmsghdr *>(buffer.data());
+            int remaining = static_cast<int>(length);
+            for (; NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+                if (header->nlmsg_seq != seq) {
+                    continue;
+                }
+
+                if (header->nlmsg_type == NLMSG_DONE) {
+                    return true;
+                } else if (header->nlmsg_type == NLMSG_ERROR) {
+                    errno = -reinterpret_cast<nlmsgerr *>(NLMSG_DATA(header))->error;
+
+                    return errno == 0;
+                }
+
+                parse(header);
+            }
+        }
+    }
+
+    bool read(uint8_t protocol, const std::vector<Entry> &plan, std::vector<Entry> *current) {
+        if (protocol < MIN_PROTOCOL) {
+            errno = EINVAL;
+
+            return false;
+        }
+
+        std::set<int32_t> links;
+        std::set<int32_t> addressed;
+        for (const Entry &entry: plan) {
+            if (entry.kind == KIND_LINK) {
+                links.insert(entry.interface);
+            } else if (entry.kind == KIND_ADDRESS) {
+                addressed.insert(entry.interface);
+            }
+        }
+
+        int fd = openSocket();
+        if (fd < 0) {
+            return false;
+        }
+
+        current->clear();
+
+        bool ok = true;
+
+        if (ok && !links.empty()) {
+            ifinfomsg body{};
+            body.ifi_family = AF_UNSPEC;
+
+            ok = dump(fd, RTM_GETLINK, body, 1, [&](nlmsghdr *header) {
+                auto info = reinterpret_cast<ifinfomsg *>(NLMSG_DATA(header));
+                if (links.count(info->ifi_index) > 0 && (info->ifi_flags & IFF_UP) != 0) {
+                    Entry entry{};
+                    entry.kind = KIND_LINK;
+                    entry.interface = info->ifi_index;
+
+                    current->push_back(entry);
+                }
+            });
+        }
+
+        if (ok && !addressed.empty()) {
+            ifaddrmsg body{};
+            body.ifa_family = AF_UNSPEC;
+
+            ok = dump(fd, RTM_GETADDR, body, 2, [&](nlmsghdr *header) {
+                auto message = reinterpret_cast<ifaddrmsg *>(NLMSG_DATA(header));
+                if (addressed.count(static_cast<int32_t>(message->ifa_index)) == 0) {
+                    return;
+                } else if (message->ifa_family != AF_INET && message->ifa_family != AF_INET6) {
+                    return;
+                }
+
+                const rtattr *found[IFA_MAX + 1];
+                attributes(IFA_RTA(message), static_cast<int>(IFA_PAYLOAD(header)), found);
+
+                Entry entry{};
+                entry.kind = KIND_ADDRESS;
+                entry.family = message->ifa_family == AF_INET6 ? FAMILY_INET6 : FAMILY_INET4;
+                entry.prefixLength = message->ifa_prefixlen;
+                entry.interface = static_cast<int32_t>(message->ifa_index);
+                readAddress(found[IFA_LOCAL] != nullptr ? found[IFA_LOCAL] : found[IFA_ADDRESS], entry.family, entry.address);
+
+                // the kernel assigns these itself
+                if (entry.family == FAMILY_INET6 && entry.address[0] == 0xfe && (entry.address[1] & 0xc0) == 0x80) {
+                    return;
+                }
+
+                current->push_back(entry);
+            });
+        }
+
+        if (ok) {
+            rtmsg body{};
+            body.rtm_family = AF_UNSPEC;
+
+            ok = dump(fd, RTM_GETROUTE, body, 3, [&](nlmsghdr *header) {
+                auto message = reinterpret_cast<rtmsg *>(NLMSG_DATA(header));
+                if (message->rtm_protocol != protocol || (message->rtm_flags & RTM_F_CLONED) != 0) {
+                    return;
+                } else if (message->rtm_family != AF_INET && message->rtm_family != AF_INET6) {
+                    return;
+                }
+
+                const rtattr *found[RTA_MAX + 1];
+                attributes(RTM_RTA(message), static_cast<int>(RTM_PAYLOAD(header)), found);
+
+                Entry entry{};
+                entry.kind = KIND_ROUTE;
+                entry.family = message->rtm_family == AF_INET6 ? FAMILY_INET6 : FAMILY_INET4;
+                entry.prefixLength = message->rtm_dst_len;
+                entry.type = message->rtm_type;
+                entry.interface = static_cast<int32_t>(read32(found[RTA_OIF], 0));
+                entry.table = read32(found[RTA_TABLE], message->rtm_table);
+                entry.priority = read32(found[RTA_PRIORITY], 0);
+                readAddress(found[RTA_DST], entry.family, entry.address);
+                readAddress(found[RTA_GATEWAY], entry.family, entry.gateway);
+
+                current->push_back(entry);
+            });
+        }
+
+        if (ok) {
+            fib_rule_hdr body{};
+            body.family = AF_UNSPEC;
+
+            ok = dump(fd, RTM_GETRULE, body, 4, [&](nlmsghdr *header) {
+                auto message = reinterpret_cast<fib_rule_hdr *>(NLMSG_DATA(header));
+                if (message->family != AF_INET && message->family != AF_INET6) {
+                    return;
+                }
+
+                const rtattr *found[FRA_MAX + 1];
+                attributes(
+                        reinterpret_cast<rtattr *>(reinterpret_cast<char *>(message) + NLMSG_ALIGN(sizeof(fib_rule_hdr))),
+                        static_cast<int>(header->nlmsg_len - NLMSG_SPACE(sizeof(fib_rule_hdr))),
+                        found
+                );
+
+                // kernels before 4.17 drop the protocol, their rules are never ours
+                if (found[FRA_PROTOCOL] == nullptr || *static_cast<uint8_t *>(RTA_DATA(found[FRA_PROTOCOL])) != protocol) {
+                    return;
+                }
+
+                Entry entry{};
+                entry.kind = KIND_RULE;
+                entry.family = message->family == AF_INET6 ? FAMILY_INET6 : FAMILY_INET4;
+                entry.prefixLength = message->src_len;
+                entry.type = message->action;
+                entry.flags = (message->flags & FIB_RULE_INVERT) != 0 ? FLAG_INVERT : 0;
+                entry.table = read32(found[FRA_TABLE], message->table);
+                entry.priority = read32(found[FRA_PRIORITY], 0);
+                entry.fwmark = read32(found[FRA_FWMARK], 0);
+                entry.fwmask = read32(found[FRA_FWMASK], 0);
+                entry.suppressPrefixLength = static_cast<int32_t>(read32(found[FRA_SUPPRESS_PREFIXLEN], UINT32_MAX));
+                readAddress(found[FRA_SRC], entry.family, entry.address);
+
+                current->push_back(entry);
+            });
+        }
+
+        int err = errno;
+        close(fd);
+        errno = err;
+
+        return ok;
+    }
+
+    static void encode(std::vector<char> &batch, uint8_t protocol, const Entry &entry, bool add, uint32_t seq) {
+        uint16_t flags = NLM_F_REQUEST | NLM_F_ACK;
+        if (add) {
+            flags |= NLM_F_CREATE | NLM_F_EXCL;
+        }
+
+        size_t length = addressLength(entry.family);
+        size_t offset;
+
+        switch (entry.kind) {
+            case KIND_LINK: {
+                ifinfomsg body{};
+                body.ifi_family = AF_UNSPEC;
+                body.ifi_index = entry.interface;
+                body.ifi_flags = IFF_UP;
+                body.ifi_change = IFF_UP;
+
+                offset = begin(batch, RTM_NEWLINK, NLM_F_REQUEST | NLM_F_ACK, seq, &body, sizeof(body));
+                break;
+            }
+            case KIND_ADDRESS: {
+                ifaddrmsg body{};
+                body.ifa_family = socketFamily(entry.family);
+                body.ifa_prefixlen = entry.prefixLength;
+                body.ifa_scope = RT_SCOPE_UNIVERSE;
+                body.ifa_index = static_cast<uint32_t>(entry.interface);
+
+                offset = begin(batch, add ? RTM_NEWADDR : RTM_DELADDR, flags, seq, &body, sizeof(body));
+                if (entry.family == FAMILY_INET4) {
+                    attribute(batch, IFA_LOCAL, entry.address, length);
+                }
+                attribute(batch, IFA_ADDRESS, entry.address, length);
+                if (add && entry.family == FAMILY_INET6) {
+                    // nobody else is on a tunnel, waiting for duplicate detection only delays the address
+                    attribute32(batch, IFA_FLAGS, IFA_F_NODAD);
+                }
+                break;
+            }
+            case KIND_ROUTE: {
+                bool hasGateway = !isZero(entry.gateway, length);
+
+                rtmsg body{};
+                body.rtm_family = socketFamily(entry.family);
+                body.rtm_dst_len = entry.prefixLength;
+                body.rtm_table = entry.table < 256 ? static_cast<uint8_t>(entry.table) : static_cast<uint8_t>(RT_TABLE_UNSPEC);
+                body.rtm_protocol = protocol;
+                body.rtm_type = entry.type;
+                if (!add) {
+                    body.rtm_scope = RT_SCOPE_NOWHERE;
+                } else if (entry.type == TYPE_UNICAST && !hasGateway) {
+                    body.rtm_scope = RT_SCOPE_LINK;
+                } else {
+                    body.rtm_scope = RT_SCOPE_UNIVERSE;
+                }
+
+                offset = begin(batch, add ? RTM_NEWROUTE : RTM_DELROUTE, flags, seq, &body, sizeof(body));
+                attribute32(batch, RTA_TABLE, entry.table);
+                if (entry.prefixLength > 0) {
+                    attribute(batch, RTA_DST, entry.address, length);
+                }
+                if (entry.interface != 0) {
+                    attribute32(batch, RTA_OIF, static_cast<uint32_t>(entry.interface));
+                }
+                if (hasGateway) {
+                    attribute(batch, RTA_GATEWAY, entry.gateway, length);
+                }
+                if (entry.priority != 0) {
+                    attribute32(batch, RTA_PRIORITY, entry.priority);
+                }
+                break;
+            }
+            case KIND_RULE: {
+                fib_rule_hdr body{};
+                body.family = socketFamily(entry.family);
+                body.src_len = entry.prefixLength;
+                body.table = entry.table < 256 ? static_cast<uint8_t>(entry.table) : static_cast<uint8_t>(RT_TABLE_UNSPEC);
+                body.action = entry.type;
+                body.flags = (entry.flags & FLAG_INVERT) != 0 ? FIB_RULE_INVERT : 0;
+
+                offset = begin(batch, add ? RTM_NEWRULE : RTM_DELRULE, flags, seq, &body, sizeof(body));
+                attribute32(batch, FRA_PRIORITY, entry.priority);
+                if (entry.type == TYPE_LOOKUP) {
+                    attribute32(batch, FRA_TABLE, entry.table);
+                }
+                if (entry.fwmark != 0 || entry.fwmask != 0) {
+                    attribute32(batch, FRA_FWMARK, entry.fwmark);
+                    attribute32(batch, FRA_FWMASK, entry.fwmask);
+                }
+                if (entry.prefixLength > 0) {
+                    attribute(batch, FRA_SRC, entry.address, length);
+                }
+                if (entry.suppressPrefixLength >= 0) {
+                    attribute32(batch, FRA_SUPPRESS_PREFIXLEN, static_cast<uint32_t>(entry.suppressPrefixLength));
+                }
+                attribute(batch, FRA_PROTOCOL, &protocol, sizeof(protocol));
+                break;
+            }
+            default:
+                return;
+        }
+
+        finish(batch, offset);
+    }
+
+    // Errors meaning the change was already in place.
+    static bool alreadyApplied(const Entry &entry, bool add, int err) {
+        if (add) {
+            return err == EEXIST;
+        }
+
+        return err == ENOENT || err == ESRCH || err == EADDRNOTAVAIL;
+    }
+
+    // Every change has to encode to exactly one message, transmit waits for an acknowledgement of each.
+    static bool valid(const Entry &change) {
+        if (change.kind < KIND_LINK || change.kind > KIND_RULE) {
+            return false;
+        }
+
+        return change.operation == OPERATION_ADD || change.operation == OPERATION_DELETE;
+    }
+
+    // Sends changes in batches of whole messages and collects the outcome of each, 0 or an errno.
+    static bool transmit(int fd, uint8_t protocol, const std::vector<Entry> &changes, bool invert, std::vector<int> *results) {
+        results->assign(changes.size(), 0);
+
+        std::vector<char> batch;
+        std::vector<char> buffer(RECEIVE_BUFFER_SIZE);
+
+        size_t next = 0;
+        while (next < changes.size()) {
+            size_t first = next;
+
+            batch.clear();
+            while (next < changes.size() && next - first < MAX_BATCH_MESSAGES && batch.size() < MAX_BATCH_SIZE) {
+                bool add = (changes[next].operation == OPERATION_ADD) != invert;
+
+                encode(batch, protocol, changes[next], add, static_cast<uint32_t>(next + 1));
+                next++;
+            }
+
+            ssize_t sent;
+            do {
+                sent = ::send(fd, batch.data(), batch.size(), 0);
+            } while (sent < 0 && errno == EINTR);
+            if (sent < 0) {
+                return false;
+            }
+
+            // one acknowledgement per message, all of them come back even if some fail
+            size_t pending = next - first;
+            while (pending > 0) {
+                size_t length = 0;
+                if (!receiveAll(fd, buffer, &length)) {
+                    return false;
+                }
+
+                auto header = reinterpret_cast<nlmsghdr *>(buffer.data());
+                int remaining = static_cast<int>(length);
+                for (; NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+                    if (header->nlmsg_type != NLMSG_ERROR || header->nlmsg_seq <= first || header->nlmsg_seq > next) {
+                        continue;
+                    }
+
+                    size_t index = header->nlmsg_seq - 1;
+                    (*results)[index] = -reinterpret_cast<nlmsgerr *>(NLMSG_DATA(header))->error;
+                    pending--;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool apply(uint8_t protocol, const std::vector<Entry> &changes) {
+        if (protocol < MIN_PROTOCOL || !std::all_of(changes.begin(), changes.end(), valid)) {
+            errno = EINVAL;
+
+            return false;
+        }
+
+        int fd = openSocket();
+        if (fd < 0) {
+            return false;
+        }
+
+        std::vector<int> results;
+        if (!transmit(fd, protocol, changes, false, &results)) {
+            int err = errno;
+            close(fd);
+            errno = err;
+
+            return false;
+        }
+
+        int failure = 0;
+        std::vector<Entry> applied;
+        for (size_t i = 0; i < changes.size(); i++) {
+            bool add = changes[i].operation == OPERATION_ADD;
+
+            if (results[i] == 0) {
+                // links are never taken down again
+                if (changes[i].kind != KIND_LINK) {
+                    applied.push_back(changes[i]);
+                }
+            } else if (failure == 0 && !alreadyApplied(changes[i], add, results[i])) {
+                failure = results[i];
+            }
+        }
+
+        if (failure != 0) {
+            // best effort, in reverse so that rules go before the routes they point at
+            std::vector<Entry> rollback(applied.rbegin(), applied.rend());
+            transmit(fd, protocol, rollback, true, &results);
+        }
+
+        close(fd);
+
+        errno = failure;
+
+        return failure == 0;
+    }
+}
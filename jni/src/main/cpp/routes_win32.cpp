@@ -0,0 +1,18 @@
+#include "routes.hpp"
+
+#include <windows.h>
+
+namespace routes {
+    bool read(uint8_t protocol, const std::vector<Entry> &plan, std::vector<Entry> *current) {
+        // the IP helper routing table has neither policy rules nor a way to tag our routes
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return false;
+    }
+
+    bool apply(uint8_t protocol, const std::vector<Entry> &changes) {
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return false;
+    }
+}
@@ -0,0 +1,62 @@
+#include "sockets.hpp"
+
+#include "jniutils.hpp"
+#include "os.hpp"
+
+namespace sockets {
+    static jint jniCreateListeningSocket(JNIEnv *env, jclass clazz, jstring host, jint port, jint backlog, jobject fd) {
+        int boundPort = 0;
+
+        process::ResourceHandle h = listen(jniutils::getString(env, host), port, backlog, &boundPort);
+        if (h == process::InvalidResourceHandle) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return -1;
+        }
+
+        process::setFileDescriptor(env, fd, h);
+
+        return boundPort;
+    }
+
+    static void jniCreateUnixListeningSocket(JNIEnv *env, jclass clazz, jstring path, jint backlog, jobject fd) {
+        process::ResourceHandle h = listenUnix(jniutils::getString(env, path), backlog);
+        if (h == process::InvalidResourceHandle) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return;
+        }
+
+        process::setFileDescriptor(env, fd, h);
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cSocket = env->FindClass("com/github/kr328/clash/compat/SocketCompat");
+        if (cSocket == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeCreateListeningSocket"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;IILjava/io/FileDescriptor;)I"),
+                        .fnPtr = reinterpret_cast<void *>(&jniCreateListeningSocket),
+                },
+                {
+                        .name = const_cast<char *>("nativeCreateUnixListeningSocket"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;ILjava/io/FileDescriptor;)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniCreateUnixListeningSocket),
+                },
+        };
+
+        if (env->RegisterNatives(cSocket, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <jni.h>
+
+#include "process.hpp"
+
+#include <string>
+
+namespace sockets {
+    bool initialize(JNIEnv *env);
+
+    // A TCP socket already listening on a numeric host, meant to be inherited by cores.
+    // Connections queue in the kernel whenever no core is accepting them.
+    process::ResourceHandle listen(const std::string &host, int port, int backlog, int *boundPort);
+    // Same for a unix socket at path, replacing a stale one, reachable by this user only.
+    process::ResourceHandle listenUnix(const std::string &path, int backlog);
+}
@@ -0,0 +1,96 @@
+#include "sockets.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+namespace sockets {
+    process::ResourceHandle listen(const std::string &host, int port, int backlog, int *boundPort) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;
+
+        addrinfo *address = nullptr;
+        std::string service = std::to_string(port);
+        int r = getaddrinfo(host.empty() ? nullptr : host.data(), service.data(), &hints, &address);
+        if (r != 0) {
+            errno = r == EAI_SYSTEM ? errno : EINVAL;
+
+            return -1;
+        }
+
+        int fd = socket(address->ai_family, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+        if (fd < 0) {
+            freeaddrinfo(address);
+
+            return -1;
+        }
+
+        int enabled = 1;
+        bool listening = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) == 0 &&
+                         bind(fd, address->ai_addr, address->ai_addrlen) == 0 &&
+                         ::listen(fd, backlog > 0 ? backlog : SOMAXCONN) == 0;
+
+        freeaddrinfo(address);
+
+        sockaddr_storage bound{};
+        socklen_t boundLength = sizeof(bound);
+        if (!listening || getsockname(fd, reinterpret_cast<sockaddr *>(&bound), &boundLength) < 0) {
+            int err = errno;
+            close(fd);
+            errno = err;
+
+            return -1;
+        }
+
+        if (bound.ss_family == AF_INET6) {
+            *boundPort = ntohs(reinterpret_cast<sockaddr_in6 *>(&bound)->sin6_port);
+        } else {
+            *boundPort = ntohs(reinterpret_cast<sockaddr_in *>(&bound)->sin_port);
+        }
+
+        return fd;
+    }
+
+    process::ResourceHandle listenUnix(const std::string &path, int backlog) {
+        sockaddr_un address{};
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            errno = ENAMETOOLONG;
+
+            return -1;
+        }
+
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.data(), path.size());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+
+        // bind() refuses an existing path, a socket left by a previous run is stale by now
+        struct stat st{};
+        if (lstat(path.data(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(path.data());
+        }
+
+        bool listening = bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 &&
+                         chmod(path.data(), 0600) == 0 &&
+                         ::listen(fd, backlog > 0 ? backlog : SOMAXCONN) == 0;
+        if (!listening) {
+            int err = errno;
+            close(fd);
+            errno = err;
+
+            return -1;
+        }
+
+        return fd;
+    }
+}
@@ -0,0 +1,16 @@
+#include "sockets.hpp"
+
+namespace sockets {
+    process::ResourceHandle listen(const std::string &host, int port, int backlog, int *boundPort) {
+        // cores on Windows have no way to pick up an inherited listener
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return INVALID_HANDLE_VALUE;
+    }
+
+    process::ResourceHandle listenUnix(const std::string &path, int backlog) {
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return INVALID_HANDLE_VALUE;
+    }
+}
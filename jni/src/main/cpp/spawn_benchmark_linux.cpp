@@ -0,0 +1,365 @@
+// Spawn latency benchmark, runs without a JVM:
+//
+//   spawn_benchmark [--iterations N] [--memory-mb N] [--threads N] [--fds N] [--max-p99-us N] [executable]
+//
+// Every strategy runs in a fresh child of the benchmark, once as a bare process and once inflated to
+// roughly the size of a busy JVM, so that costs growing with the parent show up as a gap between the two.
+// Exits non-zero when a spawn fails or a round trip p99 exceeds --max-p99-us.
+
+#include "process_linux.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define DEFAULT_ITERATIONS 200
+#define DEFAULT_MEMORY_MB 2048
+#define DEFAULT_THREADS 200
+#define DEFAULT_FDS 4000
+#define WARMUP_ITERATIONS 10
+#define THREAD_STACK_SIZE (64 * 1024)
+
+extern char **environ;
+
+namespace benchmark {
+    enum Strategy {
+        STRATEGY_CLONE,
+        STRATEGY_HELPER,
+        STRATEGY_FORK,
+        STRATEGY_POSIX_SPAWN,
+    };
+
+    static const char *const strategyNames[] = {"clone", "helper", "fork", "posix_spawn"};
+
+    struct Options {
+        int iterations = DEFAULT_ITERATIONS;
+        int64_t memoryMb = DEFAULT_MEMORY_MB;
+        int threads = DEFAULT_THREADS;
+        int fds = DEFAULT_FDS;
+        int64_t maxP99Micros = 0;
+        std::string executable = "/bin/true";
+    };
+
+    struct Inflation {
+        int64_t memoryMb;
+        int threads;
+        int fds;
+    };
+
+    static int64_t nowNanos() {
+        struct timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    static void *park(void *arg) {
+        char c;
+        while (read(static_cast<int>(reinterpret_cast<intptr_t>(arg)), &c, 1) < 0 && errno == EINTR) {
+        }
+
+        return nullptr;
+    }
+
+    // Everything is left in place until the measuring child exits.
+    static bool inflate(const Inflation &inflation) {
+        if (inflation.memoryMb > 0) {
+            size_t size = static_cast<size_t>(inflation.memoryMb) * 1024 * 1024;
+
+            void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                return false;
+            }
+
+            // touch every page, untouched mappings cost a fork almost nothing
+            long pageSize = sysconf(_SC_PAGESIZE);
+            for (size_t offset = 0; offset < size; offset += pageSize) {
+                static_cast<volatile char *>(memory)[offset] = 1;
+            }
+        }
+
+        if (inflation.fds > 0) {
+            struct rlimit limit{};
+            getrlimit(RLIMIT_NOFILE, &limit);
+            if (limit.rlim_cur < static_cast<rlim_t>(inflation.fds) + 64) {
+                limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, static_cast<rlim_t>(inflation.fds) + 64);
+                setrlimit(RLIMIT_NOFILE, &limit);
+            }
+
+            int null = open("/dev/null", O_RDONLY);
+            if (null < 0) {
+                return false;
+            }
+
+            // without O_CLOEXEC, like the descriptors a JVM leaks to naive spawns
+            for (int i = 1; i < inflation.fds; i++) {
+                if (dup(null) < 0) {
+                    return false;
+                }
+            }
+        }
+
+        if (inflation.threads > 0) {
+            int fds[2];
+            if (pipe(fds) < 0) {
+                return false;
+            }
+
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+
+            for (int i = 0; i < inflation.threads; i++) {
+                pthread_t thread;
+                if (pthread_create(&thread, &attr, park, reinterpret_cast<void *>(static_cast<intptr_t>(fds[0]))) != 0) {
+                    pthread_attr_destroy(&attr);
+
+                    return false;
+                }
+            }
+
+            pthread_attr_destroy(&attr);
+        }
+
+        return true;
+    }
+
+    // Spawns the executable and returns the nanoseconds until the spawn call returned, or -1.
+    static int64_t spawnOnce(Strategy strategy, const process::Template *prepared, char *const *args, pid_t *pid, int *pidfd) {
+        int64_t start = nowNanos();
+
+        switch (strategy) {
+            case STRATEGY_CLONE:
+            case STRATEGY_HELPER:
+                if (!process::create(prepared, pidfd, nullptr, nullptr, nullptr)) {
+                    return -1;
+                }
+                break;
+            case STRATEGY_FORK:
+                *pid = fork();
+                if (*pid == 0) {
+                    execve(args[0], args, environ);
+                    _exit(127);
+                } else if (*pid < 0) {
+                    return -1;
+                }
+                break;
+            case STRATEGY_POSIX_SPAWN:
+                if ((errno = posix_spawn(pid, args[0], nullptr, nullptr, args, environ)) != 0) {
+                    return -1;
+                }
+                break;
+        }
+
+        return nowNanos() - start;
+    }
+
+    static int reap(Strategy strategy, pid_t pid, int pidfd) {
+        if (strategy == STRATEGY_CLONE || strategy == STRATEGY_HELPER) {
+            int status = process::wait(pidfd);
+            process::release(pidfd);
+
+            return status;
+        }
+
+        int status = -1;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+
+        return status;
+    }
+
+    static int64_t percentile(std::vector<int64_t> &samples, double p) {
+        std::sort(samples.begin(), samples.end());
+
+        size_t index = static_cast<size_t>(std::ceil(p * static_cast<double>(samples.size())));
+
+        return samples[std::min(std::max<size_t>(index, 1), samples.size()) - 1];
+    }
+
+    // Runs in a child of its own, the exit code reports the outcome.
+    static int measure(Strategy strategy, const char *label, const Inflation &inflation, const Options &options) {
+        // the helper forks while the parent is still small, as it does on library load
+        if (strategy == STRATEGY_HELPER && !process::startHelper()) {
+            fprintf(stderr, "%s: start helper: %s\n", strategyNames[strategy], strerror(errno));
+
+            return 1;
+        }
+
+        if (!inflate(inflation)) {
+            fprintf(stderr, "%s: inflate: %s\n", strategyNames[strategy], strerror(errno));
+
+            return 1;
+        }
+
+        std::vector<std::string> argStrings{options.executable};
+        char *args[] = {const_cast<char *>(options.executable.data()), nullptr};
+
+        std::vector<std::string> environments;
+        for (char **env = environ; *env != nullptr; env++) {
+            environments.emplace_back(*env);
+        }
+
+        process::Template *prepared = process::prepare(options.executable, argStrings, "/", environments, {}, nullptr);
+        if (prepared == nullptr) {
+            fprintf(stderr, "%s: prepare: %s\n", strategyNames[strategy], strerror(errno));
+
+            return 1;
+        }
+
+        std::vector<int64_t> spawnNanos;
+        std::vector<int64_t> roundTripNanos;
+
+        for (int i = 0; i < WARMUP_ITERATIONS + options.iterations; i++) {
+            pid_t pid = -1;
+            int pidfd = -1;
+
+            int64_t start = nowNanos();
+            int64_t spawned = spawnOnce(strategy, prepared, args, &pid, &pidfd);
+            if (spawned < 0) {
+                fprintf(stderr, "%s: spawn: %s\n", strategyNames[strategy], strerror(errno));
+
+                return 1;
+            }
+
+            int status = reap(strategy, pid, pidfd);
+            int64_t roundTrip = nowNanos() - start;
+
+            if (status < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "%s: %s exited with status %d\n", strategyNames[strategy], options.executable.data(), status);
+
+                return 1;
+            }
+
+            if (i >= WARMUP_ITERATIONS) {
+                spawnNanos.push_back(spawned);
+                roundTripNanos.push_back(roundTrip);
+            }
+        }
+
+        process::release(prepared);
+
+        int64_t roundTripP99 = percentile(roundTripNanos, 0.99) / 1000;
+
+        printf(
+                "%-12s %-9s %10lld %10lld %10lld %10lld %10lld\n",
+                strategyNames[strategy],
+                label,
+                static_cast<long long>(percentile(spawnNanos, 0.50) / 1000),
+                static_cast<long long>(percentile(spawnNanos, 0.99) / 1000),
+                static_cast<long long>(percentile(roundTripNanos, 0.50) / 1000),
+                static_cast<long long>(roundTripP99),
+                static_cast<long long>(roundTripNanos.back() / 1000)
+        );
+        fflush(stdout);
+
+        if (options.maxP99Micros > 0 && roundTripP99 > options.maxP99Micros) {
+            return 2;
+        }
+
+        return 0;
+    }
+
+    static bool parseOptions(int argc, char *argv[], Options *options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+
+            if (arg.rfind("--", 0) != 0) {
+                options->executable = arg;
+
+                continue;
+            }
+
+            if (i + 1 >= argc) {
+                return false;
+            }
+
+            long long value = strtoll(argv[++i], nullptr, 10);
+            if (value < 0) {
+                return false;
+            }
+
+            if (arg == "--iterations" && value > 0) {
+                options->iterations = static_cast<int>(value);
+            } else if (arg == "--memory-mb") {
+                options->memoryMb = value;
+            } else if (arg == "--threads") {
+                options->threads = static_cast<int>(value);
+            } else if (arg == "--fds") {
+                options->fds = static_cast<int>(value);
+            } else if (arg == "--max-p99-us") {
+                options->maxP99Micros = value;
+            } else {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    using namespace benchmark;
+
+    Options options;
+    if (!parseOptions(argc, argv, &options)) {
+        fprintf(
+                stderr,
+                "usage: %s [--iterations N] [--memory-mb N] [--threads N] [--fds N] [--max-p99-us N] [executable]\n",
+                argv[0]
+        );
+
+        return 1;
+    }
+
+    const Inflation bare{0, 0, 0};
+    const Inflation inflated{options.memoryMb, options.threads, options.fds};
+
+    printf(
+            "inflated: %lld MiB touched, %d threads, %d fds; %d iterations; microseconds\n",
+            static_cast<long long>(options.memoryMb),
+            options.threads,
+            options.fds,
+            options.iterations
+    );
+    printf("%-12s %-9s %10s %10s %10s %10s %10s\n", "strategy", "parent", "spawn p50", "spawn p99", "trip p50", "trip p99", "trip max");
+    fflush(stdout);
+
+    int result = 0;
+
+    for (Strategy strategy: {STRATEGY_CLONE, STRATEGY_HELPER, STRATEGY_FORK, STRATEGY_POSIX_SPAWN}) {
+        for (const Inflation *inflation: {&bare, &inflated}) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                _exit(measure(strategy, inflation == &bare ? "bare" : "inflated", *inflation, options));
+            } else if (pid < 0) {
+                perror("fork");
+
+                return 1;
+            }
+
+            int status = 0;
+            while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+            }
+
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                result = WIFEXITED(status) ? std::max(result, WEXITSTATUS(status)) : 1;
+            }
+        }
+    }
+
+    return result;
+}
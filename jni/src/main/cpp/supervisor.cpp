@@ -0,0 +1,375 @@
+#include "supervisor.hpp"
+
+#include "jniutils.hpp"
+#include "logring.hpp"
+#include "logsink.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace supervisor {
+    using Clock = std::chrono::steady_clock;
+
+    static jmethodID mOnEvent;
+
+    struct State {
+        process::Template *prepared;
+        Policy policy;
+        OutputHandler output;
+        Listener listener;
+
+        process::ResourceHandle handle = process::InvalidResourceHandle;
+        bool running = false;
+        bool stopping = false;
+        bool finished = false;
+        int restarts = 0;
+        int failures = 0;
+        int lastStatus = 0;
+        Clock::time_point startedAt;
+        std::deque<Clock::time_point> exits;
+
+        ~State() {
+            process::release(prepared);
+        }
+    };
+
+    struct Supervisor {
+        std::shared_ptr<State> state;
+    };
+
+    // Every transition runs on this thread. It never exits, so the parent-death signal
+    // of the children it spawns only fires when the whole process goes away.
+    static std::mutex lock;
+    static std::condition_variable wakeup;
+    static std::multimap<Clock::time_point, std::function<void()>> tasks;
+    static bool workerStarted = false;
+
+    static void work() {
+        std::unique_lock<std::mutex> guard{lock};
+
+        while (true) {
+            if (tasks.empty()) {
+                wakeup.wait(guard);
+
+                continue;
+            }
+
+            auto next = tasks.begin();
+            if (next->first > Clock::now()) {
+                wakeup.wait_until(guard, next->first);
+
+                continue;
+            }
+
+            std::function<void()> task = std::move(next->second);
+            tasks.erase(next);
+
+            guard.unlock();
+            task();
+            guard.lock();
+        }
+    }
+
+    static void post(Clock::time_point at, const std::function<void()> &task) {
+        std::lock_guard<std::mutex> guard{lock};
+
+        if (!workerStarted) {
+            std::thread{work}.detach();
+
+            workerStarted = true;
+        }
+
+        tasks.emplace(at, task);
+        wakeup.notify_one();
+    }
+
+    static int lastError() {
+#if defined(__WIN32__)
+        return static_cast<int>(GetLastError());
+#else
+        return errno;
+#endif
+    }
+
+    static void finish(const std::shared_ptr<State> &state, Event event, int64_t value) {
+        state->finished = true;
+        state->listener(event, value, 0);
+        state->listener = nullptr;
+        state->output = nullptr;
+    }
+
+    static void launch(const std::shared_ptr<State> &state);
+
+    static void failed(const std::shared_ptr<State> &state) {
+        Clock::time_point now = Clock::now();
+
+        if (now - state->startedAt >= std::chrono::milliseconds(state->policy.stableMillis)) {
+            state->failures = 0;
+        }
+
+        state->exits.push_back(now);
+        while (now - state->exits.front() > std::chrono::milliseconds(state->policy.crashLoopWindowMillis)) {
+            state->exits.pop_front();
+        }
+
+        if (state->policy.crashLoopCount > 0 && static_cast<int64_t>(state->exits.size()) >= state->policy.crashLoopCount) {
+            finish(state, EVENT_CRASH_LOOP, static_cast<int64_t>(state->exits.size()));
+
+            return;
+        }
+
+        int64_t delay = state->policy.initialBackoffMillis;
+        for (int i = 0; i < state->failures && delay < state->policy.maxBackoffMillis; i++) {
+            delay *= 2;
+        }
+        delay = std::max<int64_t>(std::min(delay, state->policy.maxBackoffMillis), 0);
+
+        state->failures++;
+        state->listener(EVENT_RESTART_SCHEDULED, state->failures, delay);
+
+        post(now + std::chrono::milliseconds(delay), [state]() {
+            if (!state->finished) {
+                state->restarts++;
+
+                launch(state);
+            }
+        });
+    }
+
+    static void exited(const std::shared_ptr<State> &state, int status) {
+        process::release(state->handle);
+
+        state->handle = process::InvalidResourceHandle;
+        state->running = false;
+        state->lastStatus = status;
+
+        state->listener(EVENT_EXITED, status, 0);
+
+        if (state->stopping || status == 0) {
+            finish(state, EVENT_STOPPED, status);
+
+            return;
+        }
+
+        failed(state);
+    }
+
+    static void launch(const std::shared_ptr<State> &state) {
+        if (state->stopping) {
+            finish(state, EVENT_STOPPED, state->lastStatus);
+
+            return;
+        }
+
+        state->startedAt = Clock::now();
+
+        process::ResourceHandle handle = process::InvalidResourceHandle;
+        process::ResourceHandle fdStdout = process::InvalidResourceHandle;
+        process::ResourceHandle fdStderr = process::InvalidResourceHandle;
+
+        bool piped = static_cast<bool>(state->output);
+        if (!process::create(state->prepared, &handle, nullptr, piped ? &fdStdout : nullptr, piped ? &fdStderr : nullptr)) {
+            state->listener(EVENT_SPAWN_FAILED, lastError(), 0);
+
+            failed(state);
+
+            return;
+        }
+
+        if (piped && !state->output(fdStdout, fdStderr)) {
+            state->listener(EVENT_SPAWN_FAILED, lastError(), 0);
+
+            process::terminate(handle);
+        }
+
+        bool watched = process::watch(handle, [state](int status, const process::ResourceUsage &) {
+            post(Clock::now(), [state, status]() {
+                exited(state, status);
+            });
+        });
+        if (!watched) {
+            state->listener(EVENT_SPAWN_FAILED, lastError(), 0);
+
+            process::terminate(handle);
+            process::wait(handle);
+            process::release(handle);
+
+            failed(state);
+
+            return;
+        }
+
+        state->handle = handle;
+        state->running = true;
+
+        state->listener(EVENT_STARTED, state->restarts, 0);
+    }
+
+    Supervisor *start(
+            process::Template *prepared,
+            const Policy &policy,
+            const OutputHandler &output,
+            const Listener &listener
+    ) {
+        auto state = std::make_shared<State>();
+        state->prepared = prepared;
+        state->policy = policy;
+        state->output = output;
+        state->listener = listener;
+
+        post(Clock::now(), [state]() {
+            launch(state);
+        });
+
+        return new Supervisor{state};
+    }
+
+    void stop(Supervisor *supervisor) {
+        std::shared_ptr<State> state = supervisor->state;
+
+        post(Clock::now(), [state]() {
+            if (state->finished || state->stopping) {
+                return;
+            }
+
+            state->stopping = true;
+
+            if (state->running) {
+                process::terminate(state->handle, state->policy.stopGraceMillis);
+            } else {
+                finish(state, EVENT_STOPPED, state->lastStatus);
+            }
+        });
+    }
+
+    void release(Supervisor *supervisor) {
+        stop(supervisor);
+
+        delete supervisor;
+    }
+
+    static jlong jniSuperviseProcess(
+            JNIEnv *env,
+            jclass clazz,
+            jlong prepared,
+            jlongArray policy,
+            jstring sinkPath,
+            jlong sinkMaxBytes,
+            jint sinkMaxFiles,
+            jlong ring,
+            jobject listener
+    ) {
+        jlong values[6];
+        if (env->GetArrayLength(policy) != sizeof(values) / sizeof(*values)) {
+            env->ThrowNew(env->FindClass("java/lang/IllegalArgumentException"), "Invalid supervision policy");
+
+            return 0;
+        }
+
+        env->GetLongArrayRegion(policy, 0, sizeof(values) / sizeof(*values), values);
+
+        Policy cPolicy{
+                .initialBackoffMillis = values[0],
+                .maxBackoffMillis = values[1],
+                .stableMillis = values[2],
+                .crashLoopCount = values[3],
+                .crashLoopWindowMillis = values[4],
+                .stopGraceMillis = values[5],
+        };
+
+        OutputHandler output;
+        if (sinkPath != nullptr) {
+            std::string path = jniutils::getString(env, sinkPath);
+
+            output = [path, sinkMaxBytes, sinkMaxFiles](process::ResourceHandle fdStdout, process::ResourceHandle fdStderr) {
+                return logsink::attach(path, sinkMaxBytes, sinkMaxFiles, {fdStdout, fdStderr});
+            };
+        } else if (ring != 0) {
+            std::shared_ptr<logring::Ring> retained{
+                    logring::retain(reinterpret_cast<logring::Ring *>(ring)),
+                    logring::release,
+            };
+
+            output = [retained](process::ResourceHandle fdStdout, process::ResourceHandle fdStderr) {
+                return logring::attach(retained.get(), {fdStdout, fdStderr});
+            };
+        }
+
+        listener = env->NewGlobalRef(listener);
+
+        // Called on the supervisor thread, never again after a final event.
+        auto cListener = [listener](Event event, int64_t value, int64_t delayMillis) {
+            jniutils::AttachedEnv env{jniutils::currentJavaVM()};
+
+            env->CallVoidMethod(
+                    listener,
+                    mOnEvent,
+                    static_cast<jint>(event),
+                    static_cast<jlong>(value),
+                    static_cast<jlong>(delayMillis)
+            );
+
+            if (event == EVENT_STOPPED || event == EVENT_CRASH_LOOP) {
+                env->DeleteGlobalRef(listener);
+            }
+        };
+
+        return reinterpret_cast<jlong>(start(reinterpret_cast<process::Template *>(prepared), cPolicy, output, cListener));
+    }
+
+    static void jniStopSupervisor(JNIEnv *env, jclass clazz, jlong supervisor) {
+        stop(reinterpret_cast<Supervisor *>(supervisor));
+    }
+
+    static void jniReleaseSupervisor(JNIEnv *env, jclass clazz, jlong supervisor) {
+        release(reinterpret_cast<Supervisor *>(supervisor));
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cListener = env->FindClass("com/github/kr328/clash/compat/SupervisorCompat$NativeSupervisorListener");
+        if (cListener == nullptr) {
+            return false;
+        }
+
+        mOnEvent = env->GetMethodID(cListener, "onEvent", "(IJJ)V");
+        if (mOnEvent == nullptr) {
+            return false;
+        }
+
+        jclass cSupervisor = env->FindClass("com/github/kr328/clash/compat/SupervisorCompat");
+        if (cSupervisor == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeSuperviseProcess"),
+                        .signature = const_cast<char *>("(J[JLjava/lang/String;JIJLcom/github/kr328/clash/compat/SupervisorCompat$NativeSupervisorListener;)J"),
+                        .fnPtr = reinterpret_cast<void *>(&jniSuperviseProcess),
+                },
+                {
+                        .name = const_cast<char *>("nativeStopSupervisor"),
+                        .signature = const_cast<char *>("(J)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniStopSupervisor),
+                },
+                {
+                        .name = const_cast<char *>("nativeReleaseSupervisor"),
+                        .signature = const_cast<char *>("(J)V"),
+                        .fnPtr = reinterpret_cast<void *>(&jniReleaseSupervisor),
+                },
+        };
+
+        if (env->RegisterNatives(cSupervisor, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <jni.h>
+
+#include "process.hpp"
+
+#include <cstdint>
+#include <functional>
+
+namespace supervisor {
+    enum Event {
+        EVENT_STARTED = 0,           // value: restarts so far
+        EVENT_EXITED = 1,            // value: exit status
+        EVENT_RESTART_SCHEDULED = 2, // value: consecutive failures, delay: backoff
+        EVENT_CRASH_LOOP = 3,        // value: exits inside the window, final
+        EVENT_STOPPED = 4,           // value: last exit status, final
+        EVENT_SPAWN_FAILED = 5,      // value: errno or GetLastError()
+    };
+
+    struct Policy {
+        int64_t initialBackoffMillis;
+        int64_t maxBackoffMillis;
+        int64_t stableMillis;        // uptime after which the backoff starts over
+        int64_t crashLoopCount;      // abnormal exits inside the window that give up restarting
+        int64_t crashLoopWindowMillis;
+        int64_t stopGraceMillis;
+    };
+
+    using Listener = std::function<void(Event event, int64_t value, int64_t delayMillis)>;
+    // Takes ownership of the stdout and stderr pipes of every incarnation.
+    using OutputHandler = std::function<bool(process::ResourceHandle fdStdout, process::ResourceHandle fdStderr)>;
+
+    struct Supervisor;
+
+    bool initialize(JNIEnv *env);
+
+    // Takes ownership of the template, even on failure.
+    // Incarnations are spawned from one long-lived thread and bound to this process,
+    // and everything runs natively, so recovery never waits on the JVM.
+    Supervisor *start(
+            process::Template *prepared,
+            const Policy &policy,
+            const OutputHandler &output,
+            const Listener &listener
+    );
+    void stop(Supervisor *supervisor);
+    // Stops the supervisor if still running.
+    void release(Supervisor *supervisor);
+}
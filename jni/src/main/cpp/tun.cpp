@@ -0,0 +1,82 @@
+#include "tun.hpp"
+
+#include "jniutils.hpp"
+#include "os.hpp"
+
+namespace tun {
+    static jfieldID fFileDescriptorFd;
+    static jfieldID fFileDescriptorHandle;
+
+    static jstring jniCreateTunDevice(
+            JNIEnv *env,
+            jclass clazz,
+            jstring name,
+            jint queues,
+            jboolean offload,
+            jint mtu,
+            jobjectArray fds,
+            jintArray offloads
+    ) {
+        Device device{};
+        if (!create(name != nullptr ? jniutils::getString(env, name) : std::string(), queues, offload, mtu, &device)) {
+            std::string error = os::getLastError();
+
+            env->ThrowNew(env->FindClass("java/io/IOException"), error.data());
+
+            return nullptr;
+        }
+
+        for (size_t i = 0; i < device.queues.size(); i++) {
+            jobject fd = env->GetObjectArrayElement(fds, static_cast<jsize>(i));
+
+#if defined(__WIN32__)
+            env->SetLongField(fd, fFileDescriptorHandle, reinterpret_cast<jlong>(device.queues[i]));
+#elif defined(__linux__)
+            env->SetIntField(fd, fFileDescriptorFd, device.queues[i]);
+#endif
+
+            env->DeleteLocalRef(fd);
+        }
+
+        jint cOffloads = static_cast<jint>(device.offloads);
+        env->SetIntArrayRegion(offloads, 0, 1, &cOffloads);
+
+        return jniutils::newString(env, device.name);
+    }
+
+    bool initialize(JNIEnv *env) {
+        jclass cTun = env->FindClass("com/github/kr328/clash/compat/TunCompat");
+        if (cTun == nullptr) {
+            return false;
+        }
+
+        jclass cFileDescriptor = env->FindClass("java/io/FileDescriptor");
+        if (cFileDescriptor == nullptr) {
+            return false;
+        }
+
+        fFileDescriptorFd = env->GetFieldID(cFileDescriptor, "fd", "I");
+        if (fFileDescriptorFd == nullptr) {
+            return false;
+        }
+
+        fFileDescriptorHandle = env->GetFieldID(cFileDescriptor, "handle", "J");
+        if (fFileDescriptorHandle == nullptr) {
+            return false;
+        }
+
+        JNINativeMethod methods[] = {
+                {
+                        .name = const_cast<char *>("nativeCreateTunDevice"),
+                        .signature = const_cast<char *>("(Ljava/lang/String;IZI[Ljava/io/FileDescriptor;[I)Ljava/lang/String;"),
+                        .fnPtr = reinterpret_cast<void *>(&jniCreateTunDevice),
+                },
+        };
+
+        if (env->RegisterNatives(cTun, methods, sizeof(methods) / sizeof(*methods)) != JNI_OK) {
+            return false;
+        }
+
+        return true;
+    }
+}
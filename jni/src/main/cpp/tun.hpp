@@ -0,0 +1,33 @@
+#pragma once
+
+#include <jni.h>
+
+#include "process.hpp"
+
+#include <string>
+#include <vector>
+
+namespace tun {
+    // TUN_F_* as the kernel defines them, so that callers need no linux headers.
+    static const unsigned int OFFLOAD_CSUM = 0x01;
+    static const unsigned int OFFLOAD_TSO4 = 0x02;
+    static const unsigned int OFFLOAD_TSO6 = 0x04;
+    static const unsigned int OFFLOAD_TSO_ECN = 0x08;
+    static const unsigned int OFFLOAD_USO4 = 0x20;
+    static const unsigned int OFFLOAD_USO6 = 0x40;
+
+    struct Device {
+        std::string name;                          // as assigned by the kernel
+        std::vector<process::ResourceHandle> queues;
+        unsigned int offloads;                     // OFFLOAD_* the kernel accepted, 0 without a vnet header
+    };
+
+    bool initialize(JNIEnv *env);
+
+    // Creates a TUN interface without packet info, or attaches to a persistent one of that name, with one
+    // descriptor per queue for the core to read in parallel. With offload, every packet carries a
+    // virtio_net_hdr and the largest offload set the kernel accepts is enabled, so that the core sees
+    // GSO super-packets instead of MTU-sized ones. An empty name lets the kernel pick one; mtu 0 keeps
+    // the default. The interface disappears when the last queue is closed.
+    bool create(const std::string &name, int queues, bool offload, int mtu, Device *device);
+}
@@ -0,0 +1,120 @@
+#include "tun.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/if_tun.h>
+
+#define MAX_QUEUES 256
+
+namespace tun {
+    static_assert(OFFLOAD_CSUM == TUN_F_CSUM && OFFLOAD_TSO4 == TUN_F_TSO4, "offloads are passed to the kernel as is");
+    static_assert(OFFLOAD_TSO6 == TUN_F_TSO6 && OFFLOAD_TSO_ECN == TUN_F_TSO_ECN, "offloads are passed to the kernel as is");
+
+    // Tried in order until the kernel accepts one, USO needs 6.2 and TSO needs the vnet header.
+    static const unsigned int offloadSets[] = {
+            OFFLOAD_CSUM | OFFLOAD_TSO4 | OFFLOAD_TSO6 | OFFLOAD_TSO_ECN | OFFLOAD_USO4 | OFFLOAD_USO6,
+            OFFLOAD_CSUM | OFFLOAD_TSO4 | OFFLOAD_TSO6 | OFFLOAD_TSO_ECN,
+            OFFLOAD_CSUM | OFFLOAD_TSO4 | OFFLOAD_TSO6,
+            OFFLOAD_CSUM,
+    };
+
+    static void closeAll(std::vector<process::ResourceHandle> &queues) {
+        int err = errno;
+
+        for (process::ResourceHandle fd: queues) {
+            close(fd);
+        }
+        queues.clear();
+
+        errno = err;
+    }
+
+    static bool setMtu(const char (&name)[IFNAMSIZ], int mtu) {
+        int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return false;
+        }
+
+        // as the kernel returned it, terminated within IFNAMSIZ
+        ifreq request{};
+        memcpy(request.ifr_name, name, IFNAMSIZ);
+        request.ifr_mtu = mtu;
+
+        bool set = ioctl(fd, SIOCSIFMTU, &request) == 0;
+
+        int err = errno;
+        close(fd);
+        errno = err;
+
+        return set;
+    }
+
+    bool create(const std::string &name, int queues, bool offload, int mtu, Device *device) {
+        if (queues < 1 || queues > MAX_QUEUES || name.size() >= IFNAMSIZ) {
+            errno = EINVAL;
+
+            return false;
+        }
+
+        ifreq request{};
+        strncpy(request.ifr_name, name.data(), IFNAMSIZ - 1);
+        request.ifr_flags = IFF_TUN | IFF_NO_PI;
+        if (queues > 1) {
+            request.ifr_flags |= IFF_MULTI_QUEUE;
+        }
+        if (offload) {
+            request.ifr_flags |= IFF_VNET_HDR;
+        }
+
+        device->queues.clear();
+        device->offloads = 0;
+
+        for (int i = 0; i < queues; i++) {
+            int fd = open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+            if (fd < 0) {
+                closeAll(device->queues);
+
+                return false;
+            }
+
+            device->queues.push_back(fd);
+
+            // the first call fills in the name the kernel picked, later ones attach to it
+            if (ioctl(fd, TUNSETIFF, &request) < 0) {
+                closeAll(device->queues);
+
+                return false;
+            }
+        }
+
+        device->name = request.ifr_name;
+
+        if (offload) {
+            // offloads belong to the device, any queue sets them for all
+            for (unsigned int offloads: offloadSets) {
+                if (ioctl(device->queues[0], TUNSETOFFLOAD, static_cast<unsigned long>(offloads)) == 0) {
+                    device->offloads = offloads;
+
+                    break;
+                } else if (errno != EINVAL) {
+                    closeAll(device->queues);
+
+                    return false;
+                }
+            }
+        }
+
+        if (mtu > 0 && !setMtu(request.ifr_name, mtu)) {
+            closeAll(device->queues);
+
+            return false;
+        }
+
+        return true;
+    }
+}
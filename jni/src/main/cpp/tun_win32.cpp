@@ -0,0 +1,10 @@
+#include "tun.hpp"
+
+namespace tun {
+    bool create(const std::string &name, int queues, bool offload, int mtu, Device *device) {
+        // wintun adapters are opened through its own dll, not handed over as handles
+        SetLastError(ERROR_NOT_SUPPORTED);
+
+        return false;
+    }
+}